@@ -11,6 +11,13 @@
 namespace linuxdeploy {
     namespace core {
         namespace appdir {
+            // kinds of links duplicate files can be replaced with
+            enum DEDUPLICATION_METHOD {
+                // keeps the files' semantics, e.g., $ORIGIN in rpaths resolves to the file's own directory
+                DEDUPLICATE_USING_HARDLINKS = 0,
+                DEDUPLICATE_USING_SYMLINKS,
+            };
+
             /*
              * Base class for AppDirs.
              */
@@ -72,6 +79,14 @@ namespace linuxdeploy {
                     // deploy icon, changing its name to <target filename>.<ext>
                     bool deployIcon(const std::filesystem::path& path, const std::string& targetFilename);
 
+                    // generate PNG icons in the common hicolor sizes from a single, large master icon
+                    // the sizes are generated in parallel, sizes larger than the master icon are skipped
+                    // vector images can't be rasterized, and are deployed as scalable icon instead
+                    bool generateIcons(const std::filesystem::path& path);
+
+                    // generate icons, naming them <target filename>.png
+                    bool generateIcons(const std::filesystem::path& path, const std::string& targetFilename);
+
                     // deploy arbitrary file
                     std::filesystem::path deployFile(const std::filesystem::path& from, const std::filesystem::path& to);
 
@@ -110,10 +125,21 @@ namespace linuxdeploy {
                     // search for executables and libraries and deploy their dependencies
                     // calling this function can turn sure file trees created by make install commands into working
                     // AppDirs
+                    // files which have been processed by a previous call, and haven't changed since, are skipped
+                    // files count as processed once executeDeferredOperations has edited them successfully
                     bool deployDependenciesForExistingFiles() const;
 
                     // disable deployment of copyright files for this instance
                     void setDisableCopyrightFilesDeployment(bool disable);
+
+                    // set number of threads used to execute the deferred operations
+                    // defaults to the number of CPU cores
+                    void setJobs(size_t jobs);
+
+                    // replace byte-identical files in the AppDir with links to a single copy
+                    // should be called after the deferred operations have been executed
+                    // returns false if some duplicates could not be replaced, those are left untouched
+                    bool deduplicateFiles(DEDUPLICATION_METHOD method = DEDUPLICATE_USING_HARDLINKS);
             };
         }
     }
@@ -49,8 +49,9 @@ namespace linuxdeploy {
                     std::vector<std::filesystem::path> traceDynamicDependencies(const std::vector<std::string>& excludeLibraryPatterns={});
 
                     // fetch rpath stored in binary
-                    // it appears that according to the ELF standard, the rpath is ignored in libraries, therefore if the path
-                    // points to an executable, an empty string is returned
+                    // returns the value of DT_RUNPATH if set, otherwise the value of DT_RPATH, or an empty string if neither
+                    // is set
+                    // the value is read when the file is parsed, so calling this method is cheap
                     std::string getRPath();
 
                     // set rpath in ELF file
@@ -63,11 +64,31 @@ namespace linuxdeploy {
                     // return OS ABI
                     uint8_t getElfABI();
 
+                    // return target machine (e_machine)
+                    uint16_t getElfMachine();
+
+                    // return program interpreter (PT_INTERP), or an empty string if the file doesn't request one
+                    std::string getInterpreter();
+
+                    // return names of the libraries this file depends on (DT_NEEDED), in the order they are stored
+                    std::vector<std::string> getNeededLibraries();
+
+                    // return raw values of the DT_RPATH and DT_RUNPATH entries, or empty strings if not present
+                    std::string getDtRPath();
+                    std::string getDtRunPath();
+
+                    // return value of DT_SONAME, or an empty string if not present
+                    std::string getSoname();
+
                     // check if this file is a debug symbols file
                     bool isDebugSymbolsFile();
 
                     // check whether the file contains a dynsym section
                     bool isDynamicallyLinked();
+
+                    // check whether the file contains sections which stripping would remove, e.g., symbol tables or
+                    // debug information
+                    bool isStrippable();
             };
         }
     }
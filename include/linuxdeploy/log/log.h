@@ -51,6 +51,12 @@ namespace linuxdeploy::log {
             // does not implement the advanced behavior -- see private constructors for that
             ldLog();
 
+            // writes any text which has not been followed by std::endl yet
+            ~ldLog();
+
+            ldLog(const ldLog&) = default;
+            ldLog& operator=(const ldLog&) = delete;
+
         public:
             ldLog operator<<(const std::string& message);
             ldLog operator<<(const char* message);
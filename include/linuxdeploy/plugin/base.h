@@ -1,5 +1,6 @@
 // system includes
 #include <filesystem>
+#include <set>
 #include <string>
 
 // local includes
@@ -27,6 +28,10 @@ namespace linuxdeploy {
                     // construct Plugin from given path
                     explicit PluginBase(const std::filesystem::path& path);
 
+                    // construct Plugin from given path, using the plugin type and capabilities found by a previous probe
+                    // the plugin is not run, the caller must make sure it implements API_LEVEL
+                    PluginBase(const std::filesystem::path& path, PLUGIN_TYPE pluginType, std::set<std::string> capabilities);
+
                     ~PluginBase() override;
 
                 public:
@@ -39,8 +44,13 @@ namespace linuxdeploy {
                     PLUGIN_TYPE pluginType() const override;
                     std::string pluginTypeString() const override;
 
+                    // get capabilities the plugin declared
+                    std::set<std::string> capabilities() const override;
+
                     // run plugin
+                    using IPlugin::run;
                     int run(const std::filesystem::path& appDirPath) override;
+                    int run(const std::filesystem::path& appDirPath, const subprocess::subprocess_env_map_t& environment) override;
             };
         }
     }
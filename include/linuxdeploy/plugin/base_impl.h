@@ -3,7 +3,9 @@
 #include <filesystem>
 #include <poll.h>
 #include <set>
+#include <sstream>
 #include <string>
+#include <utility>
 #include <vector>
 
 // library headers
@@ -32,6 +34,7 @@ namespace linuxdeploy {
                     std::string name;
                     int apiLevel;
                     PLUGIN_TYPE pluginType;
+                    std::set<std::string> capabilities;
 
                 public:
                     explicit PrivateData(const std::filesystem::path& path) : pluginPath(path) {
@@ -44,12 +47,24 @@ namespace linuxdeploy {
                         apiLevel = getApiLevelFromExecutable();
                         pluginType = getPluginTypeFromExecutable();
 
-                        std::cmatch res;
-                        std::regex_match(path.filename().c_str(), res, PLUGIN_EXPR);
-                        name = res[1].str();
+                        // only input plugins are run concurrently, which saves running other plugins once more
+                        if (pluginType == INPUT_TYPE)
+                            capabilities = getCapabilitiesFromExecutable();
+
+                        name = getNameFromPath();
                     };
 
+                    PrivateData(const std::filesystem::path& path, int apiLevel, PLUGIN_TYPE pluginType, std::set<std::string> capabilities)
+                        : pluginPath(path), name(getNameFromPath()), apiLevel(apiLevel), pluginType(pluginType),
+                          capabilities(std::move(capabilities)) {}
+
                 private:
+                    std::string getNameFromPath() const {
+                        std::cmatch res;
+                        std::regex_match(pluginPath.filename().c_str(), res, PLUGIN_EXPR);
+                        return res[1].str();
+                    }
+
                     subprocess::subprocess_env_map_t getFixedEnvironment() {
                         auto rv = subprocess::get_environment();
                         rv.erase("VERBOSE");
@@ -107,6 +122,28 @@ namespace linuxdeploy {
 
                         return type;
                     }
+
+                    std::set<std::string> getCapabilitiesFromExecutable() {
+                        std::set<std::string> rv;
+
+                        // --plugin-capabilities is optional, plugins which don't implement it have no capabilities
+                        try {
+                            // during plugin detection, we must make sure $VERBOSE is not passed to the AppImage runtime
+                            // otherwise, in combination with $APPIMAGE_EXTRACT_AND_RUN, the runtime will spam the file
+                            // extraction messages, which makes parsing the output very hard
+                            const subprocess::subprocess proc({pluginPath.c_str(), "--plugin-capabilities"}, getFixedEnvironment());
+                            const auto stdoutOutput = proc.check_output();
+
+                            // like for --plugin-type, only the first line is considered
+                            std::istringstream firstLine(stdoutOutput.substr(0, stdoutOutput.find_first_of('\n')));
+
+                            for (std::string capability; firstLine >> capability;) {
+                                rv.insert(capability);
+                            }
+                        } catch (const std::logic_error&) {}
+
+                        return rv;
+                    }
             };
 
             template<int API_LEVEL>
@@ -120,6 +157,11 @@ namespace linuxdeploy {
                 }
             }
 
+            template<int API_LEVEL>
+            PluginBase<API_LEVEL>::PluginBase(const std::filesystem::path& path, PLUGIN_TYPE pluginType, std::set<std::string> capabilities) : IPlugin(path) {
+                d = new PrivateData(path, API_LEVEL, pluginType, std::move(capabilities));
+            }
+
             template<int API_LEVEL>
             PluginBase<API_LEVEL>::~PluginBase() {
                 delete d;
@@ -147,6 +189,11 @@ namespace linuxdeploy {
                 }
             }
 
+            template<int API_LEVEL>
+            std::set<std::string> PluginBase<API_LEVEL>::capabilities() const {
+                return d->capabilities;
+            }
+
             template<int API_LEVEL>
             int PluginBase<API_LEVEL>::apiLevel() const {
                 return d->apiLevel;
@@ -154,8 +201,13 @@ namespace linuxdeploy {
 
             template<int API_LEVEL>
             int PluginBase<API_LEVEL>::run(const std::filesystem::path& appDirPath) {
+                return run(appDirPath, {});
+            }
+
+            template<int API_LEVEL>
+            int PluginBase<API_LEVEL>::run(const std::filesystem::path& appDirPath, const subprocess::subprocess_env_map_t& environment) {
                 plugin_process_handler handler(d->name, path());
-                return handler.run(appDirPath);
+                return handler.run(appDirPath, environment);
             }
         }
     }
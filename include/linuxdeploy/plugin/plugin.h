@@ -2,15 +2,23 @@
 #include <filesystem>
 #include <map>
 #include <regex>
+#include <set>
 #include <string>
 
 // local includes
 #include "linuxdeploy/log/log.h"
 #include "linuxdeploy/plugin/exceptions.h"
+#include "linuxdeploy/subprocess/util.h"
 
 #pragma once
 
 namespace linuxdeploy {
+    namespace core {
+        namespace appdir {
+            class AppDir;
+        }
+    }
+
     namespace plugin {
         enum PLUGIN_TYPE {
             INPUT_TYPE = 0,
@@ -22,6 +30,13 @@ namespace linuxdeploy {
          */
         static const std::regex PLUGIN_EXPR(R"(^linuxdeploy-plugin-([^\s\.-]+)(?:-[^\.]+)?(?:\..+)?$)");
 
+        /*
+         * Capability of input plugins which only touch files no other plugin touches, and may therefore run
+         * concurrently with other plugins which have this capability.
+         * Plugins declare their capabilities as whitespace separated list in the output of --plugin-capabilities.
+         */
+        static constexpr auto PARALLEL_SAFE_CAPABILITY = "parallel-safe";
+
         /*
          * Plugin interface.
          */
@@ -38,7 +53,19 @@ namespace linuxdeploy {
                 virtual int apiLevel() const = 0;
                 virtual PLUGIN_TYPE pluginType() const = 0;
                 virtual std::string pluginTypeString() const = 0;
+                virtual std::set<std::string> capabilities() const = 0;
                 virtual int run(const std::filesystem::path& appDirPath) = 0;
+
+                // run plugin with additional environment variables, e.g., the path to the socket of the server which
+                // handles the requests of nested linuxdeploy processes
+                // plugins which don't run in a separate process ignore them, this is the default implementation
+                virtual int run(const std::filesystem::path& appDirPath, const subprocess::subprocess_env_map_t& environment);
+
+                // run plugin on the AppDir linuxdeploy is working on
+                // plugins which run in a separate process only need the path, this is the default implementation
+                virtual int run(core::appdir::AppDir& appDir);
+
+                bool hasCapability(const std::string& capability) const;
         };
 
         /// Implementations are not public, see source directory for those headers ///
@@ -53,5 +80,12 @@ namespace linuxdeploy {
          * Finds all linuxdeploy plugins in $PATH and the current executable's directory and returns IPlugin instances for them.
          */
         std::map<std::string, IPlugin*> findPlugins();
+
+        /*
+         * Like findPlugins(), but only probes plugins with the given names, which saves running all other plugins.
+         * The plugins are probed concurrently. If $LINUXDEPLOY_CACHE_DIR is set, the probe results are cached until
+         * the plugin files change.
+         */
+        std::map<std::string, IPlugin*> findPlugins(const std::set<std::string>& names);
     }
 }
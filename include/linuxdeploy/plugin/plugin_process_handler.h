@@ -2,6 +2,10 @@
 
 // system headers
 #include <filesystem>
+#include <string>
+
+// local headers
+#include "linuxdeploy/subprocess/util.h"
 
 namespace linuxdeploy {
     namespace plugin {
@@ -13,7 +17,8 @@ namespace linuxdeploy {
         public:
             plugin_process_handler(std::string name, std::filesystem::path path);
 
-            int run(const std::filesystem::path& appDir) const;
+            // the given environment variables are set in addition to the ones of this process
+            int run(const std::filesystem::path& appDir, const subprocess::subprocess_env_map_t& environment = {}) const;
         };
     }
 }
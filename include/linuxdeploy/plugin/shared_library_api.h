@@ -0,0 +1,72 @@
+/*
+ * API for plugins which are shared libraries, loaded into the linuxdeploy process with dlopen().
+ *
+ * Unlike executable plugins, which have to run linuxdeploy again in plugin mode to deploy files, these plugins operate
+ * on the AppDir linuxdeploy is working on. Their operations are queued in the same deferred operations and caches as
+ * linuxdeploy's own ones, and are executed once the plugin returns.
+ *
+ * The plugin file must be named like executable plugins, with the extension .so, e.g., linuxdeploy-plugin-foo.so, and
+ * must export the functions declared below with C linkage.
+ *
+ * This header is plain C, so that plugins don't depend on linuxdeploy's C++ ABI.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * API level of shared library plugins. Executable plugins use API level 0.
+ */
+#define LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL 1
+
+/*
+ * Operations linuxdeploy provides to the plugin.
+ *
+ * All operations return non-zero on success, and 0 on failure. Paths are passed as null-terminated strings. Relative
+ * destination paths are interpreted relative to the AppDir, an empty or null destination selects the default one.
+ *
+ * New members may only be added to the end of the struct. Plugins should check size before using members which have
+ * been added later.
+ */
+typedef struct linuxdeploy_plugin_host {
+    /* size of this struct in bytes */
+    unsigned long size;
+
+    /* opaque handle, must be passed to every operation */
+    void* appdir;
+
+    /* absolute path to the AppDir */
+    const char* appdir_path;
+
+    int (*deploy_library)(void* appdir, const char* path, const char* destination);
+    int (*force_deploy_library)(void* appdir, const char* path, const char* destination);
+    int (*deploy_executable)(void* appdir, const char* path, const char* destination);
+    int (*deploy_dependencies_only_for_elf_file)(void* appdir, const char* path);
+    int (*deploy_file)(void* appdir, const char* from, const char* to);
+    int (*deploy_icon)(void* appdir, const char* path);
+
+    /* run the queued operations right away, e.g., before inspecting the deployed files */
+    int (*execute_deferred_operations)(void* appdir);
+} linuxdeploy_plugin_host;
+
+/*
+ * Must return LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL.
+ */
+int linuxdeploy_plugin_api_level(void);
+
+/*
+ * Must return "input" or "output".
+ */
+const char* linuxdeploy_plugin_type(void);
+
+/*
+ * Run the plugin. Must return 0 on success, like the exit code of an executable plugin.
+ */
+int linuxdeploy_plugin_run(const linuxdeploy_plugin_host* host);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+// system headers
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// local headers
+#include "util.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        /**
+         * Immutable set of environment variables, stored in the form exec*() and posix_spawn() expect, i.e., as a
+         * null-terminated array of "NAME=value" strings.
+         *
+         * Copies share their data. Modifications return a new instance, leaving the original one untouched, so the
+         * current process's environment has to be serialized only once, and derived environments can be reused for
+         * any number of child processes.
+         */
+        class environment {
+        private:
+            class data;
+            std::shared_ptr<const data> data_;
+
+            explicit environment(std::shared_ptr<const data> data);
+
+        public:
+            /**
+             * Create an empty environment.
+             */
+            environment();
+
+            /**
+             * Return the environment of the current process.
+             * The result is cached, and only rebuilt if the environment has been modified since the last call.
+             */
+            static environment current();
+
+            /**
+             * Create an environment from a map of variables.
+             */
+            static environment from_map(const subprocess_env_map_t& map);
+
+            /**
+             * @return copy of this environment in which the variable is set to the given value
+             */
+            environment set(const std::string& name, const std::string& value) const;
+
+            /**
+             * @return copy of this environment without the variable
+             */
+            environment unset(const std::string& name) const;
+
+            /**
+             * @return value of the variable, or nothing if it is not set
+             */
+            std::optional<std::string_view> get(const std::string& name) const;
+
+            /**
+             * @return variables as a map
+             */
+            subprocess_env_map_t to_map() const;
+
+            /**
+             * The array is valid as long as this instance or any of its copies exist.
+             * @return null-terminated array of "NAME=value" strings, suitable for exec*()
+             */
+            char* const* envp() const;
+        };
+    }
+}
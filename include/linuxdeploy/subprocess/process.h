@@ -4,6 +4,7 @@
 #include <signal.h>
 
 // local headers
+#include "linuxdeploy/subprocess/environment.h"
 #include "linuxdeploy/subprocess/subprocess.h"
 
 namespace linuxdeploy {
@@ -54,6 +55,14 @@ namespace linuxdeploy {
              */
             process(const std::vector<std::string>& args, const subprocess_env_map_t& env);
 
+            /**
+             * Create a child process.
+             * This is the cheapest way to create a process, as the environment is serialized already.
+             * @param args parameters for process
+             * @param env environment of the child process
+             */
+            process(const std::vector<std::string>& args, const environment& env);
+
             ~process();
 
             /**
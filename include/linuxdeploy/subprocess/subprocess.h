@@ -2,21 +2,32 @@
 
 // system headers
 #include <cstdio>
+#include <functional>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
 // local headers
+#include "environment.h"
 #include "subprocess_result.h"
 #include "util.h"
 
 namespace linuxdeploy {
     namespace subprocess {
+        // receives output as soon as it has been read
+        // the data is only valid during the call, and need not end on a line boundary
+        using output_callback_t = std::function<void(std::string_view data)>;
+
+        // receives output line by line, without the trailing newline
+        // the data is only valid during the call
+        using line_callback_t = std::function<void(std::string_view line)>;
+
         class subprocess {
         private:
             std::vector<std::string> args_{};
-            std::unordered_map<std::string, std::string> env_{};
+            environment env_{};
 
         public:
             explicit subprocess(std::initializer_list<std::string> args);
@@ -27,8 +38,40 @@ namespace linuxdeploy {
 
             explicit subprocess(std::vector<std::string> args, subprocess_env_map_t env);
 
+            explicit subprocess(std::initializer_list<std::string> args, environment env);
+
+            explicit subprocess(std::vector<std::string> args, environment env);
+
+            const std::vector<std::string>& args() const;
+
+            const environment& env() const;
+
             subprocess_result run() const;
 
+            /**
+             * Run the process, and pass its output to the callbacks while it is running, instead of buffering it.
+             * The data is passed from a single reused buffer, so streaming does not allocate memory per chunk.
+             *
+             * If a callback throws, no more data is passed to the callbacks. The exception is rethrown once the
+             * process has exited.
+             *
+             * @param on_stdout called with chunks of the process's stdout, may be empty to discard the output
+             * @param on_stderr called with chunks of the process's stderr, may be empty to discard the output
+             * @return exit code
+             */
+            int run(const output_callback_t& on_stdout, const output_callback_t& on_stderr) const;
+
+            /**
+             * Like run(on_stdout, on_stderr), but the output is split into lines.
+             * Lines are passed without copying them, unless they span multiple chunks. A final line which is not
+             * terminated by a newline is passed once the process has exited.
+             *
+             * @param on_stdout_line called with every line of the process's stdout, may be empty to discard it
+             * @param on_stderr_line called with every line of the process's stderr, may be empty to discard it
+             * @return exit code
+             */
+            int run_lines(const line_callback_t& on_stdout_line, const line_callback_t& on_stderr_line) const;
+
             std::string check_output() const;
         };
     }
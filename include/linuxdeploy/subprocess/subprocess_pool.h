@@ -0,0 +1,47 @@
+#pragma once
+
+// system headers
+#include <future>
+#include <memory>
+
+// local headers
+#include "subprocess.h"
+#include "subprocess_result.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        /**
+         * Runs many subprocesses concurrently, keeping a bounded number of them running at a time.
+         *
+         * All children's pipes are read by a single event loop thread, which waits for any of them with one poll()
+         * call, so the number of concurrent children does not require as many threads.
+         *
+         * Subprocesses are started in the order they are submitted. On destruction, the pool waits for all submitted
+         * subprocesses to finish.
+         */
+        class subprocess_pool {
+        private:
+            class state;
+            std::unique_ptr<state> state_;
+
+        public:
+            /**
+             * @param max_running maximum number of children running at the same time (default: number of CPUs)
+             */
+            explicit subprocess_pool(size_t max_running = 0);
+
+            ~subprocess_pool();
+
+            subprocess_pool(const subprocess_pool&) = delete;
+            subprocess_pool& operator=(const subprocess_pool&) = delete;
+
+            /**
+             * Schedule a subprocess to be run.
+             * Errors, e.g., if the program cannot be started, are stored in the returned future.
+             * @param proc subprocess to run
+             * @return future which becomes ready once the subprocess has exited and all its output has been read
+             */
+            std::future<subprocess_result> submit(const subprocess& proc);
+        };
+    }
+}
@@ -3,6 +3,7 @@
 // system headers
 #include <cstdlib>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 
@@ -29,9 +30,19 @@ namespace linuxdeploy {
 
             std::string stdout_string() const;
 
+            /**
+             * @return view of stdout's contents without copying them, valid as long as this result exists
+             */
+            std::string_view stdout_view() const;
+
             const subprocess_result_buffer_t& stderr_contents() const;
 
             std::string stderr_string() const;
+
+            /**
+             * @return view of stderr's contents without copying them, valid as long as this result exists
+             */
+            std::string_view stderr_view() const;
         };
     }
 }
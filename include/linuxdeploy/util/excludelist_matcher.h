@@ -0,0 +1,128 @@
+// system headers
+#include <filesystem>
+#include <fnmatch.h>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace util {
+        namespace misc {
+            /**
+             * Matches file names against a list of exclude patterns, like isInExcludelist, but compiles the list once.
+             *
+             * Patterns without wildcards are looked up in a hash set. Patterns which contain a single * and no other
+             * special characters, e.g., libfoo.so* or *.so.1, are indexed by the part before the *, so only one hash
+             * lookup per distinct prefix length is needed. This covers all patterns in the generated excludelist and
+             * virtually all user supplied ones, which makes the cost of a match depend on the length of the name rather
+             * than the size of the list. Any other patterns are matched with fnmatch, like isInExcludelist does.
+             */
+            class ExcludelistMatcher {
+                private:
+                    std::unordered_set<std::string> exactNames;
+
+                    // patterns of the form <prefix>*<suffix>, the suffixes are indexed by the prefix
+                    std::unordered_map<std::string, std::vector<std::string>> suffixesByPrefix;
+
+                    // lengths of all prefixes in the map, so that only prefixes which exist are looked up
+                    std::set<size_t> prefixLengths;
+
+                    std::vector<std::string> fnmatchPatterns;
+
+                private:
+                    static bool hasSpecialCharacters(std::string_view pattern) {
+                        return pattern.find_first_of("*?[\\") != std::string_view::npos;
+                    }
+
+                public:
+                    ExcludelistMatcher() = default;
+
+                    explicit ExcludelistMatcher(const std::vector<std::string>& patterns) {
+                        add(patterns);
+                    }
+
+                    void add(const std::vector<std::string>& patterns) {
+                        for (const auto& pattern : patterns) {
+                            add(pattern);
+                        }
+                    }
+
+                    void add(const std::string& pattern) {
+                        if (!hasSpecialCharacters(pattern)) {
+                            exactNames.insert(pattern);
+                            return;
+                        }
+
+                        const auto starPosition = pattern.find('*');
+
+                        if (starPosition != std::string::npos) {
+                            const std::string_view view(pattern);
+                            const auto prefix = view.substr(0, starPosition);
+                            const auto suffix = view.substr(starPosition + 1);
+
+                            if (!hasSpecialCharacters(prefix) && !hasSpecialCharacters(suffix)) {
+                                suffixesByPrefix[std::string(prefix)].emplace_back(suffix);
+                                prefixLengths.insert(prefix.size());
+                                return;
+                            }
+                        }
+
+                        fnmatchPatterns.emplace_back(pattern);
+                    }
+
+                    bool matches(const std::string& fileName) const {
+                        if (exactNames.find(fileName) != exactNames.end())
+                            return true;
+
+                        const std::string_view name(fileName);
+
+                        for (const auto prefixLength : prefixLengths) {
+                            if (prefixLength > name.size())
+                                break;
+
+                            const auto it = suffixesByPrefix.find(std::string(name.substr(0, prefixLength)));
+
+                            if (it == suffixesByPrefix.end())
+                                continue;
+
+                            for (const auto& suffix : it->second) {
+                                if (prefixLength + suffix.size() > name.size())
+                                    continue;
+
+                                if (name.substr(name.size() - suffix.size()) != suffix)
+                                    continue;
+
+                                // like fnmatch with FNM_PATHNAME, the * must not match a slash
+                                const auto wildcardPart = name.substr(prefixLength, name.size() - prefixLength - suffix.size());
+
+                                if (wildcardPart.find('/') == std::string_view::npos)
+                                    return true;
+                            }
+                        }
+
+                        for (const auto& pattern : fnmatchPatterns) {
+                            switch (fnmatch(pattern.c_str(), fileName.c_str(), FNM_PATHNAME)) {
+                                case 0:
+                                    return true;
+                                case FNM_NOMATCH:
+                                    break;
+                                default:
+                                    return false;
+                            }
+                        }
+
+                        return false;
+                    }
+
+                    bool matches(const std::filesystem::path& fileName) const {
+                        return matches(fileName.string());
+                    }
+            };
+        }
+    }
+}
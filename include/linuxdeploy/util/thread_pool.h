@@ -0,0 +1,150 @@
+// system headers
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace util {
+        namespace thread_pool {
+            /**
+             * Simple fixed-size thread pool.
+             * Tasks are run in the order they are submitted. The worker threads are started on construction, and joined
+             * on destruction, after all pending tasks have been run.
+             */
+            class ThreadPool {
+                private:
+                    std::vector<std::thread> workers;
+                    std::deque<std::function<void()>> tasks;
+                    std::mutex mutex;
+                    std::condition_variable condition;
+                    bool stopping = false;
+
+                private:
+                    void work() {
+                        for (;;) {
+                            std::function<void()> task;
+
+                            {
+                                std::unique_lock<std::mutex> lock(mutex);
+                                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+                                if (tasks.empty())
+                                    return;
+
+                                task = std::move(tasks.front());
+                                tasks.pop_front();
+                            }
+
+                            task();
+                        }
+                    }
+
+                public:
+                    // number of threads to use if the user doesn't specify it
+                    static size_t defaultThreadsCount() {
+                        return std::max(1u, std::thread::hardware_concurrency());
+                    }
+
+                    explicit ThreadPool(size_t threadsCount = defaultThreadsCount()) {
+                        threadsCount = std::max<size_t>(threadsCount, 1);
+
+                        workers.reserve(threadsCount);
+
+                        for (size_t i = 0; i < threadsCount; ++i) {
+                            workers.emplace_back([this]() { work(); });
+                        }
+                    }
+
+                    ~ThreadPool() {
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            stopping = true;
+                        }
+
+                        condition.notify_all();
+
+                        for (auto& worker : workers) {
+                            worker.join();
+                        }
+                    }
+
+                    ThreadPool(const ThreadPool&) = delete;
+                    ThreadPool& operator=(const ThreadPool&) = delete;
+
+                    size_t threadsCount() const {
+                        return workers.size();
+                    }
+
+                    /**
+                     * Run a function on one of the worker threads.
+                     * Exceptions thrown by the function are stored in the returned future.
+                     */
+                    template<typename F>
+                    auto submit(F&& function) -> std::future<std::invoke_result_t<F>> {
+                        using result_t = std::invoke_result_t<F>;
+
+                        // std::function requires copyable callables, so the task must be stored in a shared pointer
+                        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<F>(function));
+                        auto future = task->get_future();
+
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            tasks.emplace_back([task]() { (*task)(); });
+                        }
+
+                        condition.notify_one();
+
+                        return future;
+                    }
+
+                    /**
+                     * Call a function for every element of a range in parallel, and wait for all calls to finish.
+                     * The results are returned in the order of the input range, regardless of the order in which the
+                     * calls finish. If any call throws, the exception of the first such element is rethrown once all
+                     * calls have finished.
+                     *
+                     * Must not be called from a worker thread of the same pool, as this may deadlock.
+                     */
+                    template<typename Iterator, typename F>
+                    auto map(Iterator begin, Iterator end, F function) {
+                        using result_t = std::invoke_result_t<F, decltype(*begin)>;
+
+                        std::vector<std::future<result_t>> futures;
+
+                        for (auto it = begin; it != end; ++it) {
+                            futures.emplace_back(submit([&function, it]() { return function(*it); }));
+                        }
+
+                        // wait for all tasks before potentially rethrowing, since the tasks reference data on our stack
+                        for (auto& future : futures) {
+                            future.wait();
+                        }
+
+                        if constexpr (std::is_void_v<result_t>) {
+                            for (auto& future : futures) {
+                                future.get();
+                            }
+                        } else {
+                            std::vector<result_t> results;
+                            results.reserve(futures.size());
+
+                            for (auto& future : futures) {
+                                results.emplace_back(future.get());
+                            }
+
+                            return results;
+                        }
+                    }
+            };
+        }
+    }
+}
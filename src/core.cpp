@@ -7,6 +7,7 @@
 // local headers
 #include <linuxdeploy/core/appdir.h>
 #include <linuxdeploy/log/log.h>
+#include <linuxdeploy/plugin/plugin.h>
 #include "core.h"
 
 using namespace linuxdeploy::core;
@@ -119,4 +120,52 @@ namespace linuxdeploy {
 
         return rv;
     }
+
+    bool deployDependenciesOnly(const fs::path& path, appdir::AppDir& appDir) {
+        if (fs::is_directory(path)) {
+            ldLog() << "Deploying files in directory" << path << std::endl;
+
+            for (auto it = fs::directory_iterator{path}; it != fs::directory_iterator{}; ++it) {
+                if (!fs::is_regular_file(*it)) {
+                    continue;
+                }
+
+                if (!appDir.deployDependenciesOnlyForElfFile(*it, true)) {
+                    ldLog() << LD_WARNING << "Failed to deploy dependencies for ELF file" << *it << LD_NO_SPACE << ", skipping" << std::endl;
+                    continue;
+                }
+            }
+        } else if (fs::is_regular_file(path)) {
+            if (!appDir.deployDependenciesOnlyForElfFile(path)) {
+                ldLog() << LD_ERROR << "Failed to deploy dependencies for ELF file: " << path << std::endl;
+                return false;
+            }
+        } else {
+            ldLog() << LD_ERROR << "No such file or directory: " << path << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    std::vector<std::vector<NamedPlugin>> batchPlugins(const std::vector<NamedPlugin>& plugins, size_t maxParallelPlugins) {
+        const auto isParallelSafe = [](const NamedPlugin& plugin) {
+            return plugin.second->hasCapability(plugin::PARALLEL_SAFE_CAPABILITY);
+        };
+
+        std::vector<std::vector<NamedPlugin>> batches;
+
+        // the batches are not limited in size, the thread pool limits the number of plugins which run at once
+        for (auto batchBegin = plugins.begin(); batchBegin != plugins.end();) {
+            auto batchEnd = std::next(batchBegin);
+
+            if (maxParallelPlugins > 1 && isParallelSafe(*batchBegin))
+                batchEnd = std::find_if_not(batchBegin, plugins.end(), isParallelSafe);
+
+            batches.emplace_back(batchBegin, batchEnd);
+            batchBegin = batchEnd;
+        }
+
+        return batches;
+    }
 }
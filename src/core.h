@@ -1,8 +1,12 @@
 #pragma once
 
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/plugin/plugin.h"
 
 namespace linuxdeploy {
     /**
@@ -24,4 +28,30 @@ namespace linuxdeploy {
      * @return
      */
     bool addDefaultKeys(desktopfile::DesktopFile& desktopFile, const std::string& executableFileName);
+
+    /**
+     * Deploy the dependencies of an ELF file in the AppDir, or of all ELF files in a directory in the AppDir, without
+     * copying the files themselves. Non-ELF files in a directory are skipped.
+     *
+     * @param path path to ELF file or directory
+     * @param appDir
+     * @return true on success otherwise false
+     */
+    bool deployDependenciesOnly(const std::filesystem::path& path, linuxdeploy::core::appdir::AppDir& appDir);
+
+    /**
+     * Plugin along with the name it has been requested with.
+     */
+    typedef std::pair<std::string, plugin::IPlugin*> NamedPlugin;
+
+    /**
+     * Split input plugins into batches, which are run one after another. Consecutive plugins which have the
+     * parallel-safe capability are put into the same batch, and run concurrently. All other plugins are run on their
+     * own. The order of the plugins is preserved.
+     *
+     * @param plugins plugins in the order they have been requested
+     * @param maxParallelPlugins maximum number of plugins which run at once, values less than 2 disable batching
+     * @return batches in the order they must be run
+     */
+    std::vector<std::vector<NamedPlugin>> batchPlugins(const std::vector<NamedPlugin>& plugins, size_t maxParallelPlugins);
 }
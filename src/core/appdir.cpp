@@ -1,7 +1,10 @@
 // system headers
 #include <filesystem>
+#include <future>
 #include <iomanip>
 #include <map>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <string>
 #include <vector>
@@ -15,8 +18,18 @@
 #include "linuxdeploy/core/elf_file.h"
 #include "linuxdeploy/log/log.h"
 #include "linuxdeploy/util/util.h"
+#include "linuxdeploy/util/excludelist_matcher.h"
+#include "linuxdeploy/util/thread_pool.h"
 #include "linuxdeploy/subprocess/subprocess.h"
+#include "linuxdeploy/subprocess/subprocess_pool.h"
 #include "copyright/copyright.h"
+#include "deduplication.h"
+#include "dependency_resolver.h"
+#include "elf_editor.h"
+#include "file_copy.h"
+#include "image_resample.h"
+#include "image_size.h"
+#include "metadata_cache.h"
 
 // auto-generated headers
 #include "excludelist.h"
@@ -25,6 +38,7 @@
 using namespace linuxdeploy::core;
 using namespace linuxdeploy::desktopfile;
 using namespace linuxdeploy::log;
+using namespace linuxdeploy::util::thread_pool;
 
 using namespace cimg_library;
 
@@ -90,6 +104,48 @@ namespace {
             _storedOperations.clear();
         }
     };
+
+    /**
+     * Edits to make to a deployed ELF file.
+     */
+    class ElfFileEdits {
+    public:
+        bool strip = false;
+        std::optional<std::string> rpath;
+    };
+
+    /**
+     * Edits which could not be made in-process.
+     */
+    class PendingElfFileEdits {
+    public:
+        bool strip = false;
+        bool setRPath = false;
+    };
+
+    /**
+     * Set of paths which may be accessed from several threads at once.
+     */
+    class ConcurrentPathSet {
+    private:
+        std::set<fs::path> _paths;
+        mutable std::mutex _mutex;
+
+    public:
+        /**
+         * Insert path into set.
+         * @return true if path was not in the set before, false otherwise
+         */
+        bool insert(const fs::path& path) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _paths.insert(path).second;
+        }
+
+        bool contains(const fs::path& path) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _paths.find(path) != _paths.end();
+        }
+    };
 }
 
 namespace linuxdeploy {
@@ -100,17 +156,31 @@ namespace linuxdeploy {
                     fs::path appDirPath;
                     std::vector<std::string> excludeLibraryPatterns;
 
+                    // generated excludelist and user supplied patterns, compiled for fast lookups
+                    // must be rebuilt whenever the patterns change
+                    util::misc::ExcludelistMatcher excludelistMatcher;
+
                     // store deferred operations
                     // these can be executed by calling excuteDeferredOperations
                     CopyOperationsStorage copyOperationsStorage;
                     std::set<fs::path> stripOperations;
                     std::map<fs::path, std::string> setElfRPathOperations;
 
+                    // the dependencies of a file are deployed in parallel, so the deferred operations must be protected
+                    std::mutex deferredOperationsMutex;
+
                     // stores all files that have been visited by the deploy functions, e.g., when they're blacklisted,
                     // have been added to the deferred operations already, etc.
                     // lookups in a single container are a lot faster than having to look up in several ones, therefore
                     // the little amount of additional memory is worth it, considering the improved performance
-                    std::set<fs::path> visitedFiles;
+                    ConcurrentPathSet visitedFiles;
+
+                    // existing files whose dependencies have been deployed already, along with their modification
+                    // times, so that calling deployDependenciesForExistingFiles again only processes new or changed files
+                    std::map<fs::path, fs::file_time_type> processedExistingFiles;
+
+                    // shared by all deploy functions, so that every library is parsed only once
+                    elf_file::DependencyResolver dependencyResolver;
 
                     // used to automatically rename resources to improve the UX, e.g. icons
                     std::string appName;
@@ -121,14 +191,62 @@ namespace linuxdeploy {
                     // decides whether copyright files deployment is performed
                     bool disableCopyrightFilesDeployment = false;
 
+                    // optional persistent cache for the results of the copyright files lookups
+                    std::shared_ptr<MetadataCache> metadataCache;
+
+                    // number of threads used to execute the deferred operations
+                    size_t jobs = ThreadPool::defaultThreadsCount();
+
+                    // created on first use, and whenever the number of jobs changes
+                    std::shared_ptr<ThreadPool> threadPool;
+
                 public:
-                PrivateData() : copyOperationsStorage(), stripOperations(), setElfRPathOperations(), visitedFiles(), appDirPath() {
+                PrivateData() : copyOperationsStorage(), stripOperations(), setElfRPathOperations(), appDirPath() {
                         copyrightFilesManager = copyright::ICopyrightFilesManager::getInstance();
+                        metadataCache = MetadataCache::fromEnvironment();
 
                         excludeLibraryPatterns = util::misc::splitEnv("LINUXDEPLOY_EXCLUDED_LIBRARIES", ';');
+                        compileExcludelist();
+                    }
+
+                    void compileExcludelist() {
+                        excludelistMatcher = util::misc::ExcludelistMatcher(generatedExcludelist);
+                        excludelistMatcher.add(excludeLibraryPatterns);
                     }
 
                 public:
+                    // check whether an existing file has been processed already, and hasn't changed since
+                    bool hasExistingFileBeenProcessed(const fs::path& path) {
+                        std::error_code ec;
+                        const auto lastWriteTime = fs::last_write_time(path, ec);
+
+                        if (ec)
+                            return false;
+
+                        const auto it = processedExistingFiles.find(path);
+
+                        if (it != processedExistingFiles.end() && it->second == lastWriteTime) {
+                            ldLog() << LD_DEBUG << "Existing file has been processed already:" << path << std::endl;
+                            return true;
+                        }
+
+                        return false;
+                    }
+
+                    // store the current modification time of an existing file which has been processed
+                    // must be called once the file has been edited, otherwise the file is considered changed later on
+                    void markExistingFileProcessed(const fs::path& path) {
+                        std::error_code ec;
+                        const auto lastWriteTime = fs::last_write_time(path, ec);
+
+                        if (ec) {
+                            processedExistingFiles.erase(path);
+                            return;
+                        }
+
+                        processedExistingFiles[path] = lastWriteTime;
+                    }
+
                     // calculate library directory name for given ELF file, taking system architecture into account
                     static std::string getLibraryDirName(const fs::path& path) {
                         const auto systemElfClass = elf_file::ElfFile::getSystemElfClass();
@@ -153,7 +271,10 @@ namespace linuxdeploy {
                         ldLog() << "Copying file" << from << "to" << to << std::endl;
 
                         try {
-                            if (!to.parent_path().empty() && !fs::is_directory(to.parent_path()) && !fs::create_directories(to.parent_path())) {
+                            // several files may be copied into the same directory concurrently, so the directory may
+                            // be created by another thread at any time
+                            if (!to.parent_path().empty() && !fs::is_directory(to.parent_path()) &&
+                                !fs::create_directories(to.parent_path()) && !fs::is_directory(to.parent_path())) {
                                 ldLog() << LD_ERROR << "Failed to create parent directory" << to.parent_path() << "for path" << to << std::endl;
                                 return false;
                             }
@@ -167,7 +288,7 @@ namespace linuxdeploy {
                             }
 
                             ldLog() << LD_DEBUG << "Copying file" << from << "to" << to << std::endl;
-                            fs::copy_file(from, to, fs::copy_options::overwrite_existing);
+                            copyFileContents(from, to);
 
                             {
                                 std::stringstream addedPermsStr;
@@ -226,90 +347,175 @@ namespace linuxdeploy {
                     }
 
                     bool hasBeenVisitedAlready(const fs::path& path) {
-                        return visitedFiles.find(path) != visitedFiles.end();
+                        return visitedFiles.contains(path);
+                    }
+
+                    ThreadPool& getThreadPool() {
+                        if (threadPool == nullptr || threadPool->threadsCount() != jobs)
+                            threadPool = std::make_shared<ThreadPool>(jobs);
+
+                        return *threadPool;
+                    }
+
+                    // logs the paths for which an operation failed
+                    // the paths are sorted to make the output independent of the order in which the operations finished
+                    static bool reportFailedOperations(const std::string& description, std::vector<fs::path> failedPaths) {
+                        if (failedPaths.empty())
+                            return true;
+
+                        std::sort(failedPaths.begin(), failedPaths.end());
+
+                        ldLog() << LD_ERROR << description << "failed for" << failedPaths.size() << "file(s):" << std::endl;
+
+                        for (const auto& path : failedPaths) {
+                            ldLog() << LD_ERROR << "  " << LD_NO_SPACE << path << std::endl;
+                        }
+
+                        return false;
                     }
 
                     // execute deferred copy operations registered with the deploy* functions
+                    // the operations of every phase are independent of each other, and are run in parallel
+                    // the phases are run one after another, so the operations for each file run in the same order as before
                     bool executeDeferredOperations() {
-                        bool success = true;
+                        auto& pool = getThreadPool();
+
+                        // operations copying to the same target path must be run in order, as all but the first one are
+                        // no-ops then
+                        // this makes the result independent of the order in which the operations finish
+                        std::map<fs::path, std::vector<CopyOperation>> copyOperationsByTarget;
 
-                        const auto copyOperations = copyOperationsStorage.getOperations();
-                        std::for_each(copyOperations.begin(), copyOperations.end(), [&success](const CopyOperation& operation) {
-                            if (!copyFile(operation.fromPath, operation.toPath, operation.addedPermissions)) {
-                                success = false;
+                        for (const auto& operation : copyOperationsStorage.getOperations()) {
+                            auto targetPath = operation.toPath;
+
+                            if (targetPath.string().back() == '/' || fs::is_directory(targetPath))
+                                targetPath /= operation.fromPath.filename();
+
+                            copyOperationsByTarget[targetPath.lexically_normal()].emplace_back(operation);
+                        }
+
+                        copyOperationsStorage.clear();
+
+                        const auto copyFailedPaths = pool.map(copyOperationsByTarget.begin(), copyOperationsByTarget.end(), [](const auto& entry) {
+                            bool success = true;
+
+                            for (const auto& operation : entry.second) {
+                                if (!copyFile(operation.fromPath, operation.toPath, operation.addedPermissions))
+                                    success = false;
                             }
+
+                            return success ? fs::path() : entry.first;
                         });
-                        copyOperationsStorage.clear();
 
-                        if (!success)
+                        auto collectFailedPaths = [](const std::vector<fs::path>& paths) {
+                            std::vector<fs::path> rv;
+                            std::copy_if(paths.begin(), paths.end(), std::back_inserter(rv), [](const fs::path& path) { return !path.empty(); });
+                            return rv;
+                        };
+
+                        if (!reportFailedOperations("Copying", collectFailedPaths(copyFailedPaths)))
                             return false;
 
-                        if (getenv("NO_STRIP") != nullptr) {
+                        const bool stripEnabled = getenv("NO_STRIP") == nullptr;
+
+                        if (!stripEnabled)
                             ldLog() << LD_WARNING << "$NO_STRIP environment variable detected, not stripping binaries" << std::endl;
-                            stripOperations.clear();
-                        } else {
-                            const auto stripPath = getStripPath();
 
-                            while (!stripOperations.empty()) {
-                                const auto& filePath = *(stripOperations.begin());
+                        // most files are stripped and get their rpath set, both edits are applied in a single pass, so
+                        // that every file is written at most once
+                        std::map<fs::path, ElfFileEdits> elfFileEdits;
 
-                                if (util::stringStartsWith(elf_file::ElfFile(filePath).getRPath(), "$")) {
-                                    ldLog() << LD_WARNING << "Not calling strip on binary" << filePath << LD_NO_SPACE
-                                            << ": rpath starts with $" << std::endl;
-                                } else {
-                                    ldLog() << "Calling strip on library" << filePath << std::endl;
+                        if (stripEnabled) {
+                            for (const auto& path : stripOperations)
+                                elfFileEdits[path].strip = true;
+                        }
 
-                                    auto env = subprocess::get_environment();
-                                    env["LC_ALL"] = "C";
+                        for (const auto& [path, rpath] : setElfRPathOperations)
+                            elfFileEdits[path].rpath = rpath;
 
-                                    subprocess::subprocess proc({stripPath, filePath.string()}, env);
+                        stripOperations.clear();
+                        setElfRPathOperations.clear();
 
-                                    const auto result = proc.run();
-                                    const auto& err = result.stderr_string();
+                        const std::vector<std::pair<fs::path, ElfFileEdits>> elfFileEditsList(elfFileEdits.begin(), elfFileEdits.end());
 
-                                    if (result.exit_code() != 0 &&
-                                        !util::stringContains(err, "Not enough room for program headers")) {
-                                        ldLog() << LD_ERROR << "Strip call failed:" << err << std::endl;
-                                        success = false;
-                                    }
-                                }
+                        const auto pendingEdits = pool.map(elfFileEditsList.begin(), elfFileEditsList.end(), [](const auto& entry) {
+                            return applyElfFileEdits(entry.first, entry.second);
+                        });
 
-                                stripOperations.erase(stripOperations.begin());
-                            }
+                        // the edits which could not be made in-process are made using the external tools
+                        // like before, the files are stripped before their rpath is set
+                        std::vector<fs::path> externalStripPaths;
+                        std::vector<std::pair<fs::path, std::string>> rpathOperations;
+
+                        for (size_t i = 0; i < elfFileEditsList.size(); ++i) {
+                            const auto& [filePath, edits] = elfFileEditsList[i];
+
+                            if (pendingEdits[i].strip)
+                                externalStripPaths.emplace_back(filePath);
+
+                            if (pendingEdits[i].setRPath)
+                                rpathOperations.emplace_back(filePath, *edits.rpath);
                         }
 
-                        if (!success)
+                        if (!reportFailedOperations("Stripping", stripFilesUsingStrip(externalStripPaths)))
                             return false;
 
-                        while (!setElfRPathOperations.empty()) {
-                            const auto& currentEntry = *(setElfRPathOperations.begin());
-                            const auto& filePath = currentEntry.first;
-                            const auto& rpath = currentEntry.second;
+                        const auto rpathFailedPaths = pool.map(rpathOperations.begin(), rpathOperations.end(), [](const auto& operation) {
+                            const auto& [filePath, rpath] = operation;
 
-                            elf_file::ElfFile elfFile(filePath);
+                            ldLog() << "Setting rpath in ELF file" << filePath << "to" << rpath << std::endl;
 
-                            // no need to set rpath in debug symbols files
-                            // also, patchelf crashes on such symbols
-                            if (isInDebugSymbolsLocation(filePath) || elfFile.isDebugSymbolsFile()) {
-                                ldLog() << LD_WARNING << "Not setting rpath in debug symbols file:" << filePath
-                                        << std::endl;
-                            } else if (!elfFile.isDynamicallyLinked()) {
-                                ldLog() << LD_WARNING << "Not setting rpath in statically-linked file: " << filePath
-                                        << std::endl;
-                            } else {
-                                ldLog() << "Setting rpath in ELF file" << filePath << "to" << rpath << std::endl;
-                                if (!elf_file::ElfFile(filePath).setRPath(rpath)) {
-                                    ldLog() << LD_ERROR << "Failed to set rpath in ELF file:" << filePath << std::endl;
-                                    success = false;
-                                }
+                            if (!elf_file::ElfFile(filePath).setRPath(rpath)) {
+                                ldLog() << LD_ERROR << "Failed to set rpath in ELF file:" << filePath << std::endl;
+                                return filePath;
                             }
 
-                            setElfRPathOperations.erase(setElfRPathOperations.begin());
+                            return fs::path();
+                        });
+
+                        // like before, failing to set the rpath is reported, but not considered fatal
+                        const auto rpathFailedPathsList = collectFailedPaths(rpathFailedPaths);
+                        reportFailedOperations("Setting rpath", rpathFailedPathsList);
+
+                        // the edits have changed the modification times, which must be recorded now, otherwise the
+                        // files would be considered changed by the next call to deployDependenciesForExistingFiles
+                        // the existing files are edited only once their dependencies have been deployed, like the
+                        // files deployed by the deploy functions, so all of them can be skipped from now on
+                        // files whose rpath could not be set have to be processed again, though
+                        const std::set<fs::path> unprocessedPaths(rpathFailedPathsList.begin(), rpathFailedPathsList.end());
+
+                        for (const auto& entry : elfFileEditsList) {
+                            if (unprocessedPaths.find(entry.first) != unprocessedPaths.end()) {
+                                processedExistingFiles.erase(entry.first);
+                                continue;
+                            }
+
+                            markExistingFileProcessed(entry.first);
                         }
 
+                        // the deferred operations are the last step of the deployment, therefore everything worth
+                        // caching has been looked up by now
+                        if (metadataCache != nullptr)
+                            metadataCache->save();
+
                         return true;
                     }
 
+                    // looking up the copyright files requires calling the package manager, so the results are cached
+                    std::vector<fs::path> getCopyrightFiles(const fs::path& path) {
+                        if (metadataCache != nullptr) {
+                            if (const auto cachedValue = metadataCache->get("copyright", path))
+                                return {cachedValue->begin(), cachedValue->end()};
+                        }
+
+                        auto copyrightFiles = copyrightFilesManager->getCopyrightFilesForPath(path);
+
+                        if (metadataCache != nullptr)
+                            metadataCache->put("copyright", path, {copyrightFiles.begin(), copyrightFiles.end()});
+
+                        return copyrightFiles;
+                    }
+
                     // search for copyright file for file and deploy it to AppDir
                     bool deployCopyrightFiles(const fs::path& from) {
                         if (disableCopyrightFilesDeployment)
@@ -318,7 +524,7 @@ namespace linuxdeploy {
                         if (copyrightFilesManager == nullptr)
                             return false;
 
-                        auto copyrightFiles = copyrightFilesManager->getCopyrightFilesForPath(from);
+                        auto copyrightFiles = getCopyrightFiles(from);
 
                         if (copyrightFiles.empty())
                             return false;
@@ -347,7 +553,10 @@ namespace linuxdeploy {
                         if (verbose)
                             ldLog() << "Deploying file" << from << "to" << to << std::endl;
 
-                        copyOperationsStorage.addOperation(from, to, addedPerms);
+                        {
+                            std::lock_guard<std::mutex> lock(deferredOperationsMutex);
+                            copyOperationsStorage.addOperation(from, to, addedPerms);
+                        }
 
                         // mark file as visited
                         visitedFiles.insert(from);
@@ -355,6 +564,14 @@ namespace linuxdeploy {
                         return to;
                     }
 
+                    std::vector<fs::path> traceDynamicDependencies(const fs::path& path, elf_file::ElfFile& elfFile) {
+                        // the ldd based implementation can still be used for debugging purposes
+                        if (getenv("LINUXDEPLOY_USE_LDD") != nullptr)
+                            return elfFile.traceDynamicDependencies(excludeLibraryPatterns);
+
+                        return dependencyResolver.resolveDependencies(path, elfFile, excludeLibraryPatterns, &getThreadPool());
+                    }
+
                     bool deployElfDependencies(const fs::path& path) {
                         elf_file::ElfFile elfFile(path);
 
@@ -364,16 +581,25 @@ namespace linuxdeploy {
                         }
 
                         ldLog() << "Deploying dependencies for ELF file" << path << std::endl;
+
+                        std::vector<fs::path> dependencyPaths;
+
                         try {
-                            for (const auto &dependencyPath : elfFile.traceDynamicDependencies(excludeLibraryPatterns))
-                                if (!deployLibrary(dependencyPath, false, false))
-                                    return false;
+                            dependencyPaths = traceDynamicDependencies(path, elfFile);
                         } catch (const elf_file::DependencyNotFoundError& e) {
                             ldLog() << LD_ERROR << e.what() << std::endl;
                             return false;
                         }
 
-                        return true;
+                        // the dependency list is free of duplicates, and the libraries' dependencies are part of the list
+                        // already, so the libraries can be deployed independently of each other
+                        // the deferred operations are stored in sorted containers, so their order does not depend on the
+                        // order in which the libraries are deployed
+                        const auto results = getThreadPool().map(dependencyPaths.begin(), dependencyPaths.end(), [this](const fs::path& dependencyPath) {
+                            return deployLibrary(dependencyPath, false, false);
+                        });
+
+                        return std::all_of(results.begin(), results.end(), [](bool result) { return result; });
                     }
 
                     static std::string getStripPath() {
@@ -392,6 +618,133 @@ namespace linuxdeploy {
                         return stripPath;
                     }
 
+                    // apply the edits to a file in-process, writing the file only once
+                    // returns the edits which have to be made using the external tools instead
+                    static PendingElfFileEdits applyElfFileEdits(const fs::path& filePath, const ElfFileEdits& edits) {
+                        PendingElfFileEdits pending;
+                        pending.strip = edits.strip;
+
+                        if (edits.rpath.has_value()) {
+                            elf_file::ElfFile elfFile(filePath);
+
+                            // no need to set rpath in debug symbols files
+                            // also, patchelf crashes on such symbols
+                            if (isInDebugSymbolsLocation(filePath) || elfFile.isDebugSymbolsFile()) {
+                                ldLog() << LD_WARNING << "Not setting rpath in debug symbols file:" << filePath
+                                        << std::endl;
+                            } else if (!elfFile.isDynamicallyLinked()) {
+                                ldLog() << LD_WARNING << "Not setting rpath in statically-linked file: " << filePath
+                                        << std::endl;
+                            } else {
+                                pending.setRPath = true;
+                            }
+                        }
+
+                        const bool stripInProcess = pending.strip && getenv("LINUXDEPLOY_USE_STRIP") == nullptr;
+                        const bool setRPathInProcess = pending.setRPath && getenv("LINUXDEPLOY_USE_PATCHELF") == nullptr;
+
+                        if (!stripInProcess && !setRPathInProcess)
+                            return pending;
+
+                        const auto originalPending = pending;
+
+                        try {
+                            elf_file::ElfEditor editor(filePath);
+
+                            if (stripInProcess) {
+                                // nothing is modified if the file is not supported
+                                try {
+                                    if (editor.strip())
+                                        ldLog() << "Stripping library" << filePath << std::endl;
+
+                                    pending.strip = false;
+                                } catch (const elf_file::ElfEditError& e) {
+                                    ldLog() << LD_DEBUG << "Cannot strip" << filePath << "in-process, falling back to strip:" << e.what() << std::endl;
+                                }
+                            }
+
+                            // the rpath must be set after calling strip
+                            const bool setRPathNow = setRPathInProcess && !pending.strip;
+
+                            if (setRPathNow) {
+                                ldLog() << "Setting rpath in ELF file" << filePath << "to" << *edits.rpath << std::endl;
+                                editor.setRPath(*edits.rpath);
+                            }
+
+                            editor.save();
+
+                            if (setRPathNow)
+                                pending.setRPath = false;
+                        } catch (const elf_file::ElfEditError& e) {
+                            // the external tools report errors themselves
+                            ldLog() << LD_DEBUG << "Failed to edit" << filePath << "in-process:" << e.what() << std::endl;
+                            return originalPending;
+                        }
+
+                        return pending;
+                    }
+
+                    // strip the files by calling strip
+                    // returns the files which could not be stripped
+                    std::vector<fs::path> stripFilesUsingStrip(const std::vector<fs::path>& paths) {
+                        if (paths.empty())
+                            return {};
+
+                        const auto stripPath = getStripPath();
+
+                        // checking the files requires parsing them, which is done in parallel, too
+                        const auto filesToStrip = getThreadPool().map(paths.begin(), paths.end(), [](const fs::path& filePath) {
+                            elf_file::ElfFile elfFile(filePath);
+
+                            // distributions ship stripped files, calling strip on those would be a waste of time
+                            if (!elfFile.isStrippable()) {
+                                ldLog() << LD_DEBUG << "Not calling strip on binary" << filePath << LD_NO_SPACE
+                                        << ": stripped already" << std::endl;
+                                return fs::path();
+                            }
+
+                            if (util::stringStartsWith(elfFile.getRPath(), "$")) {
+                                ldLog() << LD_WARNING << "Not calling strip on binary" << filePath << LD_NO_SPACE
+                                        << ": rpath starts with $" << std::endl;
+                                return fs::path();
+                            }
+
+                            return filePath;
+                        });
+
+                        // serialized once for all strip calls
+                        const auto stripEnv = subprocess::environment::current().set("LC_ALL", "C");
+
+                        // strip spends most of its time on I/O, the pool keeps one process per CPU running
+                        subprocess::subprocess_pool stripProcesses;
+
+                        std::vector<std::pair<fs::path, std::future<subprocess::subprocess_result>>> stripResults;
+
+                        for (const auto& filePath : filesToStrip) {
+                            if (filePath.empty())
+                                continue;
+
+                            ldLog() << "Calling strip on library" << filePath << std::endl;
+
+                            stripResults.emplace_back(filePath, stripProcesses.submit(subprocess::subprocess({stripPath, filePath.string()}, stripEnv)));
+                        }
+
+                        std::vector<fs::path> failedPaths;
+
+                        for (auto& [filePath, futureResult] : stripResults) {
+                            const auto result = futureResult.get();
+                            const auto& err = result.stderr_string();
+
+                            if (result.exit_code() != 0 &&
+                                !util::stringContains(err, "Not enough room for program headers")) {
+                                ldLog() << LD_ERROR << "Strip call failed:" << err << std::endl;
+                                failedPaths.emplace_back(filePath);
+                            }
+                        }
+
+                        return failedPaths;
+                    }
+
                     static std::string calculateRelativeRPath(const fs::path& originDir, const fs::path& dependencyLibrariesDir) {
                         auto relPath = fs::relative(fs::absolute(dependencyLibrariesDir), fs::absolute(originDir));
                         std::string rpath = "$ORIGIN/" + relPath.string() + ":$ORIGIN";
@@ -409,7 +762,7 @@ namespace linuxdeploy {
                             return false;
                         }
 
-                        if (!forceDeploy && (util::isInExcludelist(path.filename(), generatedExcludelist) || util::isInExcludelist(path.filename(), excludeLibraryPatterns))) {
+                        if (!forceDeploy && excludelistMatcher.matches(path.filename())) {
                             ldLog() << "Skipping deployment of blacklisted library" << path << std::endl;
 
                             // mark file as visited
@@ -422,10 +775,12 @@ namespace linuxdeploy {
                         // create a directory
                         fs::path libraryDir = appDirPath / "usr" / (getLibraryDirName(path) + "/");
 
-                        ldLog() << "Deploying shared library" << path;
-                        if (!destination.empty())
-                            ldLog() << " (destination:" << destination << LD_NO_SPACE << ")";
-                        ldLog() << std::endl;
+                        // the line is logged in a single statement, so that it is written at once
+                        if (destination.empty()) {
+                            ldLog() << "Deploying shared library" << path << std::endl;
+                        } else {
+                            ldLog() << "Deploying shared library" << path << "(destination:" << destination << LD_NO_SPACE << ")" << std::endl;
+                        }
 
                         auto actualDestination = destination.empty() ? libraryDir : destination;
 
@@ -459,11 +814,15 @@ namespace linuxdeploy {
 
                         // no need to set rpath in debug symbols files
                         // also, patchelf crashes on such symbols
-                        if (!isInDebugSymbolsLocation(actualDestination)) {
-                            setElfRPathOperations[actualDestination] = rpath;
-                        }
+                        {
+                            std::lock_guard<std::mutex> lock(deferredOperationsMutex);
 
-                        stripOperations.insert(actualDestination);
+                            if (!isInDebugSymbolsLocation(actualDestination)) {
+                                setElfRPathOperations[actualDestination] = rpath;
+                            }
+
+                            stripOperations.insert(actualDestination);
+                        }
 
                         if (!deployDependencies)
                             return true;
@@ -504,8 +863,11 @@ namespace linuxdeploy {
                             rpath = "$ORIGIN/" + relPath.string();
                         }
 
-                        setElfRPathOperations[destinationPath / path.filename()] = rpath;
-                        stripOperations.insert(destinationPath / path.filename());
+                        {
+                            std::lock_guard<std::mutex> lock(deferredOperationsMutex);
+                            setElfRPathOperations[destinationPath / path.filename()] = rpath;
+                            stripOperations.insert(destinationPath / path.filename());
+                        }
 
                         if (!deployElfDependencies(path))
                             return false;
@@ -544,56 +906,63 @@ namespace linuxdeploy {
                         if (util::strLower(path.filename().extension().string()) == ".svg") {
                             resolution = "scalable";
                         } else {
-                            try {
-                                CImg<unsigned char> image(path.c_str());
-
-                                auto xRes = image.width();
-                                auto yRes = image.height();
+                            // only the header is read to find out the resolution, the image is decoded only if its
+                            // format is not known
+                            auto imageSize = readImageSizeFromHeader(path);
 
-                                if (xRes != yRes) {
-                                    ldLog() << LD_WARNING << "x and y resolution of icon are not equal:" << path;
+                            if (!imageSize.has_value()) {
+                                try {
+                                    CImg<unsigned char> image(path.c_str());
+                                    imageSize = ImageSize{static_cast<uint32_t>(image.width()), static_cast<uint32_t>(image.height())};
+                                } catch (const CImgException& e) {
+                                    ldLog() << LD_ERROR << "CImg error: " << e.what() << std::endl;
+                                    return false;
                                 }
+                            }
 
-                                resolution = std::to_string(xRes) + "x" + std::to_string(yRes);
+                            const auto xRes = static_cast<int>(imageSize->width);
+                            const auto yRes = static_cast<int>(imageSize->height);
 
-                                // otherwise, test resolution against "known good" values, and reject invalid ones
-                                const auto knownResolutions = {8, 16, 20, 22, 24, 28, 32, 36, 42, 48, 64, 72, 96, 128, 160, 192, 256, 384, 480, 512};
+                            if (xRes != yRes) {
+                                ldLog() << LD_WARNING << "x and y resolution of icon are not equal:" << path << std::endl;
+                            }
 
-                                // assume invalid
-                                bool invalidXRes = true, invalidYRes = true;
+                            resolution = std::to_string(xRes) + "x" + std::to_string(yRes);
 
-                                for (const auto res : knownResolutions) {
-                                    if (xRes == res)
-                                        invalidXRes = false;
-                                    if (yRes == res)
-                                        invalidYRes = false;
-                                }
+                            // otherwise, test resolution against "known good" values, and reject invalid ones
+                            const auto knownResolutions = {8, 16, 20, 22, 24, 28, 32, 36, 42, 48, 64, 72, 96, 128, 160, 192, 256, 384, 480, 512};
 
-                                auto printIconHint = [&knownResolutions]() {
-                                    std::stringstream ss;
-                                    for (const auto res : knownResolutions) {
-                                        ss << res << "x" << res;
+                            // assume invalid
+                            bool invalidXRes = true, invalidYRes = true;
 
-                                        if (res != *(knownResolutions.end() - 1))
-                                            ss << ", ";
-                                    }
+                            for (const auto res : knownResolutions) {
+                                if (xRes == res)
+                                    invalidXRes = false;
+                                if (yRes == res)
+                                    invalidYRes = false;
+                            }
 
-                                    ldLog() << LD_ERROR << "Valid resolutions for icons are:" << ss.str() << std::endl;
-                                };
+                            auto printIconHint = [&knownResolutions]() {
+                                std::stringstream ss;
+                                for (const auto res : knownResolutions) {
+                                    ss << res << "x" << res;
 
-                                if (invalidXRes) {
-                                    ldLog() << LD_ERROR << "Icon" << path << "has invalid x resolution:" << xRes << std::endl;
-                                    printIconHint();
-                                    return false;
+                                    if (res != *(knownResolutions.end() - 1))
+                                        ss << ", ";
                                 }
 
-                                if (invalidYRes) {
-                                    ldLog() << LD_ERROR << "Icon" << path << "has invalid y resolution:" << yRes << std::endl;
-                                    printIconHint();
-                                    return false;
-                                }
-                            } catch (const CImgException& e) {
-                                ldLog() << LD_ERROR << "CImg error: " << e.what() << std::endl;
+                                ldLog() << LD_ERROR << "Valid resolutions for icons are:" << ss.str() << std::endl;
+                            };
+
+                            if (invalidXRes) {
+                                ldLog() << LD_ERROR << "Icon" << path << "has invalid x resolution:" << xRes << std::endl;
+                                printIconHint();
+                                return false;
+                            }
+
+                            if (invalidYRes) {
+                                ldLog() << LD_ERROR << "Icon" << path << "has invalid y resolution:" << yRes << std::endl;
+                                printIconHint();
                                 return false;
                             }
                         }
@@ -616,6 +985,124 @@ namespace linuxdeploy {
                         return true;
                     }
 
+                    static bool writePngIcon(const RgbaImage& icon, const fs::path& path) {
+                        // CImg stores every channel in a separate plane
+                        CImg<unsigned char> image(icon.width, icon.height, 1, 4);
+
+                        const size_t pixelsCount = static_cast<size_t>(icon.width) * icon.height;
+
+                        for (size_t c = 0; c < 4; ++c) {
+                            unsigned char* plane = image.data(0, 0, 0, c);
+
+                            for (size_t i = 0; i < pixelsCount; ++i) {
+                                plane[i] = icon.pixels[i * 4 + c];
+                            }
+                        }
+
+                        try {
+                            fs::create_directories(path.parent_path());
+                            image.save_png(path.c_str());
+                        } catch (const fs::filesystem_error& e) {
+                            ldLog() << LD_ERROR << "Failed to create directory" << path.parent_path() << LD_NO_SPACE << ":" << e.what() << std::endl;
+                            return false;
+                        } catch (const CImgException& e) {
+                            ldLog() << LD_ERROR << "CImg error: " << e.what() << std::endl;
+                            return false;
+                        }
+
+                        return true;
+                    }
+
+                    bool generateIcons(const fs::path& path, const std::string& targetFilename = "") {
+                        // vector images can't be rasterized in-process, but are fine to use for every size anyway
+                        if (util::strLower(path.filename().extension().string()) == ".svg") {
+                            ldLog() << LD_WARNING << "Cannot generate raster icons from vector image, deploying it as scalable icon:" << path << std::endl;
+                            return deployIcon(path, targetFilename);
+                        }
+
+                        ldLog() << "Generating icons from" << path << std::endl;
+
+                        CImg<unsigned char> image;
+
+                        try {
+                            image.load(path.c_str());
+                        } catch (const CImgException& e) {
+                            ldLog() << LD_ERROR << "CImg error: " << e.what() << std::endl;
+                            return false;
+                        }
+
+                        if (image.width() != image.height()) {
+                            ldLog() << LD_ERROR << "Icon" << path << "is not square:" << image.width() << LD_NO_SPACE << "x" << LD_NO_SPACE << image.height() << std::endl;
+                            return false;
+                        }
+
+                        const auto masterSize = static_cast<uint32_t>(image.width());
+
+                        // sizes listed in the icon theme specification's example hicolor theme, which includes the
+                        // ones created by createBasicStructure()
+                        // icons are never upscaled, sizes larger than the master icon are skipped
+                        std::vector<uint32_t> sizes;
+
+                        for (const uint32_t size : {16, 22, 24, 32, 48, 64, 128, 256, 512}) {
+                            if (size <= masterSize)
+                                sizes.push_back(size);
+                        }
+
+                        if (sizes.empty()) {
+                            ldLog() << LD_ERROR << "Icon" << path << "is too small to generate icons from:" << image.width() << LD_NO_SPACE << "x" << LD_NO_SPACE << image.height() << std::endl;
+                            return false;
+                        }
+
+                        // convert the image to RGBA, grayscale images are expanded, and missing alpha channels are
+                        // filled in
+                        RgbaImage master;
+                        master.width = masterSize;
+                        master.height = masterSize;
+                        master.pixels.resize(static_cast<size_t>(masterSize) * masterSize * 4);
+
+                        const auto spectrum = image.spectrum();
+
+                        for (uint32_t y = 0; y < masterSize; ++y) {
+                            for (uint32_t x = 0; x < masterSize; ++x) {
+                                uint8_t* pixel = master.pixels.data() + (static_cast<size_t>(y) * masterSize + x) * 4;
+
+                                if (spectrum >= 3) {
+                                    pixel[0] = image(x, y, 0, 0);
+                                    pixel[1] = image(x, y, 0, 1);
+                                    pixel[2] = image(x, y, 0, 2);
+                                    pixel[3] = spectrum >= 4 ? image(x, y, 0, 3) : 255;
+                                } else {
+                                    pixel[0] = pixel[1] = pixel[2] = image(x, y, 0, 0);
+                                    pixel[3] = spectrum == 2 ? image(x, y, 0, 1) : 255;
+                                }
+                            }
+                        }
+
+                        // the decoded image isn't needed any more, the master may be large
+                        image.assign();
+
+                        const auto filename = (targetFilename.empty() ? path.stem().string() : targetFilename) + ".png";
+
+                        const auto results = getThreadPool().map(sizes.begin(), sizes.end(), [this, &master, &filename](const uint32_t size) {
+                            const auto resolution = std::to_string(size) + "x" + std::to_string(size);
+                            const auto iconPath = appDirPath / "usr/share/icons/hicolor" / resolution / "apps" / filename;
+
+                            ldLog() << "Writing icon" << iconPath << std::endl;
+
+                            if (size == master.width)
+                                return writePngIcon(master, iconPath);
+
+                            return writePngIcon(downscaleImage(master, size, size), iconPath);
+                        });
+
+                        if (std::find(results.begin(), results.end(), false) != results.end())
+                            return false;
+
+                        deployCopyrightFiles(path);
+
+                        return true;
+                    }
+
                     static bool isInDebugSymbolsLocation(const fs::path& path) {
                         // TODO: check if there's more potential locations for debug symbol files
                         for (const std::string& dbgSymbolsPrefix : {".debug/"}) {
@@ -637,6 +1124,7 @@ namespace linuxdeploy {
 
             void AppDir::setExcludeLibraryPatterns(const std::vector<std::string> &excludeLibraryPatterns) {
                 d->excludeLibraryPatterns.insert(d->excludeLibraryPatterns.end(), excludeLibraryPatterns.begin(), excludeLibraryPatterns.end());
+                d->compileExcludelist();
             }
 
             bool AppDir::createBasicStructure() const {
@@ -665,7 +1153,7 @@ namespace linuxdeploy {
                     try {
                         fs::create_directories(fullDirPath);
                     } catch (const fs::filesystem_error&) {
-                        ldLog() << LD_ERROR << "Failed to create directory" << fullDirPath;
+                        ldLog() << LD_ERROR << "Failed to create directory" << fullDirPath << std::endl;
                         return false;
                     }
                 }
@@ -697,6 +1185,14 @@ namespace linuxdeploy {
                 return d->deployIcon(path, targetFilename);
             }
 
+            bool AppDir::generateIcons(const fs::path& path) {
+                return d->generateIcons(path);
+            }
+
+            bool AppDir::generateIcons(const fs::path& path, const std::string& targetFilename) {
+                return d->generateIcons(path, targetFilename);
+            }
+
             bool AppDir::executeDeferredOperations() {
                 return d->executeDeferredOperations();
             }
@@ -832,7 +1328,7 @@ namespace linuxdeploy {
 
             bool AppDir::deployDependenciesForExistingFiles() const {
                 for (const auto& executable : listExecutables()) {
-                    if (fs::is_symlink(executable))
+                    if (fs::is_symlink(executable) || d->hasExistingFileBeenProcessed(executable))
                         continue;
 
                     if (!d->deployElfDependencies(executable))
@@ -844,7 +1340,7 @@ namespace linuxdeploy {
                 }
 
                 for (const auto& sharedLibrary : listSharedLibraries()) {
-                    if (fs::is_symlink(sharedLibrary))
+                    if (fs::is_symlink(sharedLibrary) || d->hasExistingFileBeenProcessed(sharedLibrary))
                         continue;
 
                     if (!d->deployElfDependencies(sharedLibrary))
@@ -876,7 +1372,7 @@ namespace linuxdeploy {
                             ldLog() << "Deploying additional executables in directory:" << additionalBinaryDir << std::endl;
 
                             if (!fs::is_directory(additionalBinaryDir)) {
-                                ldLog() << LD_ERROR << "Could not find additional binary dir, skipping:" << additionalBinaryDir;
+                                ldLog() << LD_ERROR << "Could not find additional binary dir, skipping:" << additionalBinaryDir << std::endl;
                             }
 
                             for (fs::directory_iterator it(additionalBinaryDir); it != fs::directory_iterator(); ++it) {
@@ -975,6 +1471,27 @@ namespace linuxdeploy {
             void AppDir::setDisableCopyrightFilesDeployment(bool disable) {
                 d->disableCopyrightFilesDeployment = disable;
             }
+
+            bool AppDir::deduplicateFiles(DEDUPLICATION_METHOD method) {
+                ldLog() << "Searching for duplicate files in AppDir" << std::endl;
+
+                const auto result = appdir::deduplicateFiles(d->appDirPath, method, d->getThreadPool());
+
+                ldLog() << "Replaced" << result.replacedFilesCount << "duplicate file(s) with"
+                        << (method == DEDUPLICATE_USING_SYMLINKS ? "symlinks" : "hardlinks") << LD_NO_SPACE << ", saved"
+                        << result.savedBytes << "bytes" << std::endl;
+
+                if (result.failedFilesCount > 0) {
+                    ldLog() << LD_WARNING << "Failed to replace" << result.failedFilesCount << "duplicate file(s)" << std::endl;
+                    return false;
+                }
+
+                return true;
+            }
+
+            void AppDir::setJobs(size_t jobs) {
+                d->jobs = std::max<size_t>(jobs, 1);
+            }
         }
     }
 }
@@ -4,6 +4,7 @@
 #include "copyright.h"
 
 // specializations
+#include "copyright_dpkgdatabase.h"
 #include "copyright_dpkgquery.h"
 
 namespace linuxdeploy {
@@ -12,6 +13,11 @@ namespace linuxdeploy {
             using namespace log;
 
             std::shared_ptr<ICopyrightFilesManager> ICopyrightFilesManager::getInstance() {
+                if (DpkgDatabaseCopyrightFilesManager::isAvailable()) {
+                    ldLog() << LD_DEBUG << "Using dpkg database to search for copyright files" << std::endl;
+                    return std::make_shared<DpkgDatabaseCopyrightFilesManager>();
+                }
+
                 if (!util::which("dpkg-query").empty()) {
                     ldLog() << LD_DEBUG << "Using dpkg-query to search for copyright files" << std::endl;
                     return std::make_shared<DpkgQueryCopyrightFilesManager>();
@@ -0,0 +1,145 @@
+// system headers
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+// local includes
+#include "copyright_dpkgdatabase.h"
+#include "linuxdeploy/log/log.h"
+
+namespace linuxdeploy {
+    namespace core {
+        namespace copyright {
+            using namespace log;
+
+            class DpkgDatabaseCopyrightFilesManager::PrivateData {
+                public:
+                    const fs::path infoDirectory;
+                    const fs::path docDirectory;
+
+                    // the contents of all file lists, which the keys of the index point into
+                    // this way, the paths are stored only once, and building the index does not require an allocation
+                    // per path
+                    // a deque never moves its elements, so the views remain valid when more lists are added
+                    std::deque<std::string> fileLists;
+
+                    std::vector<std::string> packageNames;
+                    std::unordered_map<std::string_view, size_t> packageIndexByPath;
+
+                    // the index is built on the first lookup, which may happen on any thread
+                    std::once_flag indexBuilt;
+
+                public:
+                    PrivateData(fs::path infoDirectory, fs::path docDirectory) : infoDirectory(std::move(infoDirectory)),
+                                                                                 docDirectory(std::move(docDirectory)) {}
+
+                private:
+                    static std::string readFile(const fs::path& path) {
+                        std::ifstream ifs(path, std::ios::binary);
+                        std::ostringstream oss;
+                        oss << ifs.rdbuf();
+                        return oss.str();
+                    }
+
+                public:
+                    void buildIndex() {
+                        std::error_code ec;
+
+                        for (const auto& entry : fs::directory_iterator(infoDirectory, ec)) {
+                            const auto& listPath = entry.path();
+
+                            if (listPath.extension() != ".list")
+                                continue;
+
+                            // files are named <package>.list or <package>:<arch>.list, like dpkg-query, we only use the
+                            // package name
+                            auto packageName = listPath.stem().string();
+                            packageName = packageName.substr(0, packageName.find(':'));
+
+                            fileLists.emplace_back(readFile(listPath));
+                            packageNames.emplace_back(packageName);
+
+                            const std::string_view contents = fileLists.back();
+                            const auto packageIndex = packageNames.size() - 1;
+
+                            for (size_t begin = 0; begin < contents.size();) {
+                                auto end = contents.find('\n', begin);
+
+                                if (end == std::string_view::npos)
+                                    end = contents.size();
+
+                                if (end > begin)
+                                    packageIndexByPath.emplace(contents.substr(begin, end - begin), packageIndex);
+
+                                begin = end + 1;
+                            }
+                        }
+
+                        ldLog() << LD_DEBUG << "Indexed" << packageIndexByPath.size() << "paths of" << packageNames.size()
+                                << "packages in dpkg database" << infoDirectory << std::endl;
+                    }
+
+                    const std::string* findPackage(const fs::path& path) const {
+                        const auto it = packageIndexByPath.find(path.string());
+
+                        if (it == packageIndexByPath.end())
+                            return nullptr;
+
+                        return &packageNames[it->second];
+                    }
+            };
+
+            fs::path DpkgDatabaseCopyrightFilesManager::getAdminDirectory() {
+                const auto* adminDir = getenv("DPKG_ADMINDIR");
+
+                if (adminDir != nullptr && adminDir[0] != '\0')
+                    return adminDir;
+
+                return "/var/lib/dpkg";
+            }
+
+            bool DpkgDatabaseCopyrightFilesManager::isAvailable() {
+                std::error_code ec;
+                return fs::is_directory(getAdminDirectory() / "info", ec);
+            }
+
+            DpkgDatabaseCopyrightFilesManager::DpkgDatabaseCopyrightFilesManager()
+                : DpkgDatabaseCopyrightFilesManager("/usr/share/doc") {}
+
+            DpkgDatabaseCopyrightFilesManager::DpkgDatabaseCopyrightFilesManager(const fs::path& docDirectory)
+                : d(std::make_shared<PrivateData>(getAdminDirectory() / "info", docDirectory)) {}
+
+            std::vector<fs::path> DpkgDatabaseCopyrightFilesManager::getCopyrightFilesForPath(const fs::path& path) {
+                std::call_once(d->indexBuilt, [this]() { d->buildIndex(); });
+
+                // like dpkg-query, we look up the canonical path first
+                // on merged /usr systems, the database often contains the path below /lib only, though, therefore the
+                // path as passed is tried as well
+                std::error_code ec;
+                const auto realpath = fs::canonical(path, ec);
+
+                const auto* packageName = ec ? nullptr : d->findPackage(realpath);
+
+                if (packageName == nullptr)
+                    packageName = d->findPackage(path);
+
+                if (packageName == nullptr) {
+                    ldLog() << LD_WARNING << "Could not find copyright files for file" << path << "in dpkg database"
+                            << std::endl;
+                    return {};
+                }
+
+                auto copyrightFilePath = d->docDirectory / *packageName / "copyright";
+
+                if (fs::is_regular_file(copyrightFilePath, ec)) {
+                    return {copyrightFilePath};
+                }
+
+                return {};
+            }
+        }
+    }
+}
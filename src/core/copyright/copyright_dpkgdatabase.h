@@ -0,0 +1,44 @@
+// system headers
+#include <filesystem>
+#include <memory>
+
+// local headers
+#include "copyright.h"
+
+#pragma once
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace copyright {
+            /**
+             * Looks up the package owning a file in the dpkg database directly.
+             *
+             * The file lists of all installed packages, i.e., the .list files in <admindir>/info, are read once, on the
+             * first lookup, and indexed by path. This is equivalent to calling dpkg-query -S for every file, but avoids starting a
+             * process per file, each of which has to load the entire database again.
+             */
+            class DpkgDatabaseCopyrightFilesManager : public ICopyrightFilesManager {
+                private:
+                    class PrivateData;
+                    std::shared_ptr<PrivateData> d;
+
+                public:
+                    // the admin directory can be overridden with $DPKG_ADMINDIR, like for the dpkg tools
+                    static fs::path getAdminDirectory();
+
+                    // the database can be used if the package info directory exists
+                    static bool isAvailable();
+
+                public:
+                    DpkgDatabaseCopyrightFilesManager();
+
+                    // copyright files are searched for in <docDirectory>/<package>/copyright
+                    explicit DpkgDatabaseCopyrightFilesManager(const fs::path& docDirectory);
+
+                    std::vector<fs::path> getCopyrightFilesForPath(const fs::path& path) override;
+            };
+        }
+    }
+}
@@ -18,15 +18,24 @@ namespace linuxdeploy {
 
                 subprocess::subprocess proc{{"dpkg-query", "-S", realpath.c_str()}};
 
-                auto result = proc.run();
+                // only the first line is of interest, the rest of the output is discarded while it is read
+                std::string firstLine;
+                bool haveFirstLine = false;
+
+                const auto exitCode = proc.run_lines([&firstLine, &haveFirstLine](std::string_view line) {
+                    if (!haveFirstLine) {
+                        firstLine = line;
+                        haveFirstLine = true;
+                    }
+                }, {});
 
-                if (result.exit_code() != 0 || result.stdout_contents().empty()) {
+                if (exitCode != 0 || !haveFirstLine) {
                     ldLog() << LD_WARNING << "Could not find copyright files for file" << path << "using dpkg-query"
                             << std::endl;
                     return {};
                 }
 
-                auto packageName = util::split(util::splitLines(result.stdout_string())[0], ':')[0];
+                auto packageName = firstLine.substr(0, firstLine.find(':'));
 
                 if (!packageName.empty()) {
                     auto copyrightFilePath = fs::path("/usr/share/doc") / packageName / "copyright";
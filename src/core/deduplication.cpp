@@ -0,0 +1,227 @@
+// system headers
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "deduplication.h"
+
+using namespace linuxdeploy::log;
+using namespace linuxdeploy::util::thread_pool;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace appdir {
+            namespace {
+                // a file's contents, mapped into memory for hashing and comparing
+                class MappedFile {
+                    private:
+                        void* mapping = MAP_FAILED;
+                        size_t size = 0;
+
+                    public:
+                        explicit MappedFile(const fs::path& path, size_t size) : size(size) {
+                            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                            if (fd < 0)
+                                return;
+
+                            mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                            close(fd);
+                        }
+
+                        ~MappedFile() {
+                            if (mapping != MAP_FAILED)
+                                munmap(mapping, size);
+                        }
+
+                        MappedFile(const MappedFile&) = delete;
+                        MappedFile& operator=(const MappedFile&) = delete;
+
+                        bool isValid() const {
+                            return mapping != MAP_FAILED;
+                        }
+
+                        std::string_view contents() const {
+                            return {static_cast<const char*>(mapping), size};
+                        }
+                };
+
+                // all paths within the tree referring to the same inode, those are linked already
+                class Inode {
+                    public:
+                        dev_t device = 0;
+                        ino_t inode = 0;
+                        uintmax_t size = 0;
+                        mode_t mode = 0;
+
+                        // sorted
+                        std::vector<fs::path> paths;
+                };
+
+                std::vector<Inode> collectInodes(const fs::path& root) {
+                    std::map<std::pair<dev_t, ino_t>, Inode> inodes;
+
+                    std::error_code ec;
+                    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+                        struct stat statbuf{};
+
+                        // symlinks are not followed, they are not duplicates of anything
+                        if (lstat(it->path().c_str(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size == 0)
+                            continue;
+
+                        auto& inode = inodes[std::make_pair(statbuf.st_dev, statbuf.st_ino)];
+                        inode.device = statbuf.st_dev;
+                        inode.inode = statbuf.st_ino;
+                        inode.size = static_cast<uintmax_t>(statbuf.st_size);
+                        inode.mode = statbuf.st_mode & 07777;
+                        inode.paths.emplace_back(it->path());
+                    }
+
+                    if (ec)
+                        ldLog() << LD_WARNING << "Failed to list files in" << root << LD_NO_SPACE << ":" << ec.message() << std::endl;
+
+                    std::vector<Inode> rv;
+                    rv.reserve(inodes.size());
+
+                    for (auto& [key, inode] : inodes) {
+                        std::sort(inode.paths.begin(), inode.paths.end());
+                        rv.emplace_back(std::move(inode));
+                    }
+
+                    // process the inodes in a well defined order, which determines which copy is kept
+                    std::sort(rv.begin(), rv.end(), [](const Inode& a, const Inode& b) {
+                        return a.paths.front() < b.paths.front();
+                    });
+
+                    return rv;
+                }
+
+                std::optional<size_t> hashFile(const Inode& inode) {
+                    const MappedFile file(inode.paths.front(), inode.size);
+
+                    if (!file.isValid())
+                        return std::nullopt;
+
+                    return std::hash<std::string_view>{}(file.contents());
+                }
+
+                bool haveSameContents(const Inode& a, const Inode& b) {
+                    const MappedFile fileA(a.paths.front(), a.size);
+                    const MappedFile fileB(b.paths.front(), b.size);
+
+                    return fileA.isValid() && fileB.isValid() && fileA.contents() == fileB.contents();
+                }
+
+                // atomically replaces path with a link to target
+                bool replaceWithLink(const fs::path& target, const fs::path& path, DEDUPLICATION_METHOD method) {
+                    const auto tempPath = path.parent_path() / ("." + path.filename().string() + ".ld-dedup");
+
+                    int rv;
+
+                    if (method == DEDUPLICATE_USING_SYMLINKS) {
+                        const auto relativeTargetPath = fs::relative(target, path.parent_path());
+                        rv = symlink(relativeTargetPath.c_str(), tempPath.c_str());
+                    } else {
+                        rv = link(target.c_str(), tempPath.c_str());
+                    }
+
+                    if (rv != 0) {
+                        ldLog() << LD_WARNING << "Failed to link" << path << "to" << target << LD_NO_SPACE << ":" << strerror(errno) << std::endl;
+                        return false;
+                    }
+
+                    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+                        ldLog() << LD_WARNING << "Failed to replace" << path << LD_NO_SPACE << ":" << strerror(errno) << std::endl;
+                        unlink(tempPath.c_str());
+                        return false;
+                    }
+
+                    return true;
+                }
+            }
+
+            DeduplicationResult deduplicateFiles(const fs::path& root, DEDUPLICATION_METHOD method, ThreadPool& threadPool) {
+                DeduplicationResult result;
+
+                const auto inodes = collectInodes(root);
+
+                // only files whose size is shared by another file can be duplicates, the others need not be read at all
+                std::map<uintmax_t, size_t> inodesCountBySize;
+                for (const auto& inode : inodes) {
+                    ++inodesCountBySize[inode.size];
+                }
+
+                std::vector<const Inode*> candidates;
+                for (const auto& inode : inodes) {
+                    if (inodesCountBySize[inode.size] > 1)
+                        candidates.emplace_back(&inode);
+                }
+
+                ldLog() << LD_DEBUG << "Hashing" << candidates.size() << "of" << inodes.size() << "files to find duplicates" << std::endl;
+
+                const auto hashes = threadPool.map(candidates.begin(), candidates.end(), [](const Inode* inode) {
+                    return hashFile(*inode);
+                });
+
+                // candidates are in path order, therefore the groups are, too
+                std::map<std::pair<uintmax_t, size_t>, std::vector<const Inode*>> groups;
+                for (size_t i = 0; i < candidates.size(); ++i) {
+                    if (hashes[i].has_value())
+                        groups[std::make_pair(candidates[i]->size, *hashes[i])].emplace_back(candidates[i]);
+                }
+
+                for (const auto& [key, group] : groups) {
+                    // the files which are kept, usually only one
+                    std::vector<const Inode*> keptInodes;
+
+                    for (const auto* inode : group) {
+                        const auto keptInodeIt = std::find_if(keptInodes.begin(), keptInodes.end(), [inode, method](const Inode* keptInode) {
+                            // hardlinks cannot span filesystems
+                            if (method == DEDUPLICATE_USING_HARDLINKS && keptInode->device != inode->device)
+                                return false;
+
+                            return keptInode->mode == inode->mode && haveSameContents(*keptInode, *inode);
+                        });
+
+                        if (keptInodeIt == keptInodes.end()) {
+                            keptInodes.emplace_back(inode);
+                            continue;
+                        }
+
+                        const auto& target = (*keptInodeIt)->paths.front();
+
+                        size_t replacedPathsCount = 0;
+
+                        for (const auto& path : inode->paths) {
+                            ldLog() << LD_DEBUG << "Replacing duplicate" << path << "with link to" << target << std::endl;
+
+                            if (replaceWithLink(target, path, method)) {
+                                ++replacedPathsCount;
+                            } else {
+                                ++result.failedFilesCount;
+                            }
+                        }
+
+                        result.replacedFilesCount += replacedPathsCount;
+
+                        // the space is only freed once the last link to the inode has been replaced
+                        if (replacedPathsCount == inode->paths.size())
+                            result.savedBytes += inode->size;
+                    }
+                }
+
+                return result;
+            }
+        }
+    }
+}
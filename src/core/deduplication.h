@@ -0,0 +1,49 @@
+#pragma once
+
+// system headers
+#include <cstdint>
+#include <filesystem>
+
+// local headers
+#include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/util/thread_pool.h"
+
+namespace linuxdeploy {
+    namespace core {
+        namespace appdir {
+            // results of a deduplication run
+            class DeduplicationResult {
+                public:
+                    // number of files replaced with links
+                    size_t replacedFilesCount = 0;
+
+                    // sum of the sizes of the replaced files
+                    uintmax_t savedBytes = 0;
+
+                    // number of files which could not be replaced
+                    size_t failedFilesCount = 0;
+            };
+
+            /**
+             * Replace byte-identical regular files within a directory tree with links to a single copy.
+             *
+             * Files are only compared if their sizes match, and only hashed in that case. The hashes are calculated in
+             * parallel. Files with the same hash are compared byte by byte before they are replaced, so hash collisions
+             * cannot cause data loss. Files with different permissions are never merged, as links share those.
+             *
+             * Of every set of identical files, the one with the lexicographically smallest path is kept, so the result
+             * does not depend on the order in which the files are found. Replacements are atomic.
+             *
+             * @param root directory to deduplicate
+             * @param method kind of link to replace duplicates with
+             * @param threadPool pool to calculate the hashes on (must not be called from a worker thread of the pool)
+             * @return statistics
+             */
+            DeduplicationResult deduplicateFiles(
+                const std::filesystem::path& root,
+                DEDUPLICATION_METHOD method,
+                util::thread_pool::ThreadPool& threadPool
+            );
+        }
+    }
+}
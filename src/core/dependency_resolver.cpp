@@ -0,0 +1,553 @@
+// system headers
+#include <algorithm>
+#include <fstream>
+#include <glob.h>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <sys/utsname.h>
+#include <unordered_map>
+#include <utility>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "linuxdeploy/util/util.h"
+#include "dependency_resolver.h"
+#include "ld_so_cache.h"
+#include "metadata_cache.h"
+
+using namespace linuxdeploy::log;
+using namespace linuxdeploy::util::thread_pool;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            namespace {
+                // Debian style multiarch tuple of the system, used in the library directory names on such systems
+                std::string getMultiarchTuple() {
+                    #if defined(__x86_64__)
+                    return "x86_64-linux-gnu";
+                    #elif defined(__i386__)
+                    return "i386-linux-gnu";
+                    #elif defined(__aarch64__)
+                    return "aarch64-linux-gnu";
+                    #elif defined(__arm__)
+                    return "arm-linux-gnueabihf";
+                    #else
+                    return "";
+                    #endif
+                }
+
+                // parse ld.so.conf style files, following include directives
+                void readLdSoConf(const fs::path& confPath, std::vector<fs::path>& directories, int depth = 0) {
+                    // protect against include loops
+                    if (depth > 8)
+                        return;
+
+                    std::ifstream ifs(confPath);
+
+                    if (!ifs)
+                        return;
+
+                    std::string line;
+                    while (std::getline(ifs, line)) {
+                        line = line.substr(0, line.find('#'));
+                        util::trim(line);
+                        util::trim(line, '\t');
+
+                        if (line.empty())
+                            continue;
+
+                        if (util::stringStartsWith(line, "include ") || util::stringStartsWith(line, "include\t")) {
+                            auto pattern = line.substr(8);
+                            util::trim(pattern);
+
+                            // relative include patterns are relative to the including file's directory
+                            if (!pattern.empty() && pattern.front() != '/')
+                                pattern = (confPath.parent_path() / pattern).string();
+
+                            glob_t globResult{};
+                            if (glob(pattern.c_str(), 0, nullptr, &globResult) == 0) {
+                                for (size_t i = 0; i < globResult.gl_pathc; ++i) {
+                                    readLdSoConf(globResult.gl_pathv[i], directories, depth + 1);
+                                }
+                            }
+                            globfree(&globResult);
+
+                            continue;
+                        }
+
+                        // hwcap directives are not relevant for us
+                        if (util::stringStartsWith(line, "hwcap "))
+                            continue;
+
+                        // ldconfig accepts several directories per line
+                        for (auto& directory : util::split(line, ' ')) {
+                            util::trim(directory, '\t');
+
+                            if (!directory.empty())
+                                directories.emplace_back(directory);
+                        }
+                    }
+                }
+
+                // the directories the dynamic linker searches after the object specific paths
+                const std::vector<fs::path>& getSystemLibraryDirectories() {
+                    static const auto systemLibraryDirectories = []() {
+                        std::vector<fs::path> candidates;
+
+                        readLdSoConf("/etc/ld.so.conf", candidates);
+
+                        const auto multiarchTuple = getMultiarchTuple();
+                        if (!multiarchTuple.empty()) {
+                            candidates.emplace_back(fs::path("/lib") / multiarchTuple);
+                            candidates.emplace_back(fs::path("/usr/lib") / multiarchTuple);
+                        }
+
+                        // the ELF class check will skip libraries in the directories not meant for the file
+                        for (const auto* directory : {"/lib64", "/usr/lib64", "/lib", "/usr/lib", "/lib32", "/usr/lib32"}) {
+                            candidates.emplace_back(directory);
+                        }
+
+                        std::vector<fs::path> directories;
+                        std::set<fs::path> seenDirectories;
+
+                        for (const auto& candidate : candidates) {
+                            std::error_code ec;
+                            if (!fs::is_directory(candidate, ec))
+                                continue;
+
+                            if (seenDirectories.insert(candidate).second)
+                                directories.emplace_back(candidate);
+                        }
+
+                        return directories;
+                    }();
+
+                    return systemLibraryDirectories;
+                }
+
+                // the cache is loaded only once per run, as ldconfig won't be called while we're running
+                const LdSoCache& getSystemLdSoCache() {
+                    static const LdSoCache systemLdSoCache;
+                    return systemLdSoCache;
+                }
+
+                // value of the $LIB dynamic string token for a given ELF class
+                std::string getLibToken(uint8_t elfClass) {
+                    if (elfClass != ElfFile::getSystemElfClass())
+                        return elfClass == ELFCLASS32 ? "lib32" : "lib64";
+
+                    const auto multiarchTuple = getMultiarchTuple();
+
+                    std::error_code ec;
+                    if (!multiarchTuple.empty() && fs::is_directory(fs::path("/lib") / multiarchTuple, ec))
+                        return "lib/" + multiarchTuple;
+
+                    if (elfClass == ELFCLASS64 && fs::is_directory("/lib64", ec))
+                        return "lib64";
+
+                    return "lib";
+                }
+
+                // value of the $PLATFORM dynamic string token for a given ELF class
+                std::string getPlatformToken(uint8_t elfClass) {
+                    utsname unameData{};
+
+                    if (uname(&unameData) != 0)
+                        return "";
+
+                    std::string machine = unameData.machine;
+
+                    if (elfClass != ElfFile::getSystemElfClass() && machine == "x86_64")
+                        return "i686";
+
+                    return machine;
+                }
+
+                bool isDynamicLinker(const std::string& libraryName, const std::string& interpreter) {
+                    // the linker is loaded by the kernel, and must never be bundled
+                    if (!interpreter.empty() && fs::path(interpreter).filename() == libraryName)
+                        return true;
+
+                    for (const auto& prefix : {"ld-linux", "ld64.so", "ld-musl"}) {
+                        if (util::stringStartsWith(libraryName, prefix))
+                            return true;
+                    }
+
+                    return false;
+                }
+            }
+
+            class DependencyResolver::PrivateData {
+                public:
+                    // the information about a library we need to decide whether it can be loaded and to continue the search
+                    class LibraryInfo {
+                        public:
+                            uint8_t elfClass = ELFCLASSNONE;
+                            uint16_t elfMachine = EM_NONE;
+                            std::vector<std::string> neededLibraries;
+                            std::string dtRPath;
+                            std::string dtRunPath;
+                    };
+
+                    // an object the dynamic linker would load while loading the file passed to resolveDependencies
+                    class LoadedObject {
+                        public:
+                            LibraryInfo info;
+                            std::vector<fs::path> rpath;
+                            std::vector<fs::path> runpath;
+                            // index of the object which caused this one to be loaded, -1 for the root object
+                            ssize_t loaderIndex = -1;
+                    };
+
+                public:
+                    // $LD_LIBRARY_PATH is read once, the dynamic linker doesn't watch it either
+                    const std::vector<std::string> ldLibraryPath;
+
+                    // results of parsing candidate files, indexed by their path
+                    // the same files are probed over and over again, e.g., the ones in the system library directories
+                    // lookups may run concurrently, therefore the cache is protected by a mutex
+                    std::unordered_map<std::string, std::optional<LibraryInfo>> probeCache;
+                    std::mutex probeCacheMutex;
+
+                    // optional persistent cache, saves parsing the same files again in subsequent runs
+                    const std::shared_ptr<MetadataCache> metadataCache;
+
+                public:
+                    PrivateData() : ldLibraryPath(readLdLibraryPath()), metadataCache(MetadataCache::fromEnvironment()) {}
+
+                private:
+                    static std::vector<std::string> readLdLibraryPath() {
+                        std::vector<std::string> rv;
+
+                        const auto* ldLibraryPathValue = getenv("LD_LIBRARY_PATH");
+
+                        if (ldLibraryPathValue == nullptr)
+                            return rv;
+
+                        // the dynamic linker accepts both colons and semicolons as separators
+                        std::string value = ldLibraryPathValue;
+                        std::replace(value.begin(), value.end(), ';', ':');
+
+                        for (const auto& entry : util::split(value, ':')) {
+                            if (!entry.empty())
+                                rv.emplace_back(entry);
+                        }
+
+                        return rv;
+                    }
+
+                public:
+                    static LibraryInfo readLibraryInfo(ElfFile& elfFile) {
+                        LibraryInfo info;
+                        info.elfClass = elfFile.getElfClass();
+                        info.elfMachine = elfFile.getElfMachine();
+                        info.neededLibraries = elfFile.getNeededLibraries();
+                        info.dtRPath = elfFile.getDtRPath();
+                        info.dtRunPath = elfFile.getDtRunPath();
+                        return info;
+                    }
+
+                    // the metadata cache stores lists of strings
+                    // files which are not ELF files are stored as empty lists
+                    static std::vector<std::string> serializeLibraryInfo(const std::optional<LibraryInfo>& info) {
+                        if (!info.has_value())
+                            return {};
+
+                        std::vector<std::string> rv{
+                            std::to_string(info->elfClass),
+                            std::to_string(info->elfMachine),
+                            info->dtRPath,
+                            info->dtRunPath,
+                        };
+
+                        rv.insert(rv.end(), info->neededLibraries.begin(), info->neededLibraries.end());
+
+                        return rv;
+                    }
+
+                    static std::optional<LibraryInfo> deserializeLibraryInfo(const std::vector<std::string>& value) {
+                        if (value.size() < 4)
+                            return std::nullopt;
+
+                        LibraryInfo info;
+
+                        try {
+                            info.elfClass = static_cast<uint8_t>(std::stoul(value[0]));
+                            info.elfMachine = static_cast<uint16_t>(std::stoul(value[1]));
+                        } catch (const std::logic_error&) {
+                            return std::nullopt;
+                        }
+
+                        info.dtRPath = value[2];
+                        info.dtRunPath = value[3];
+                        info.neededLibraries.assign(value.begin() + 4, value.end());
+                        return info;
+                    }
+
+                    std::optional<LibraryInfo> parseLibraryInfo(const fs::path& candidate) {
+                        std::error_code ec;
+                        if (!fs::is_regular_file(candidate, ec))
+                            return std::nullopt;
+
+                        if (metadataCache != nullptr) {
+                            if (const auto cachedValue = metadataCache->get("elf", candidate)) {
+                                if (cachedValue->empty())
+                                    return std::nullopt;
+
+                                // invalid entries are replaced below
+                                if (auto info = deserializeLibraryInfo(*cachedValue))
+                                    return info;
+                            }
+                        }
+
+                        std::optional<LibraryInfo> info;
+
+                        try {
+                            ElfFile elfFile(candidate);
+                            info = readLibraryInfo(elfFile);
+                        } catch (const ElfFileParseError&) {
+                            // not a (valid) ELF file, the linker would skip it as well
+                        }
+
+                        if (metadataCache != nullptr)
+                            metadataCache->put("elf", candidate, serializeLibraryInfo(info));
+
+                        return info;
+                    }
+
+                    // expand dynamic string tokens and split a DT_RPATH or DT_RUNPATH value into its directories
+                    static std::vector<fs::path> expandSearchPath(const std::string& value, const fs::path& originDir, uint8_t elfClass) {
+                        std::vector<fs::path> rv;
+
+                        if (value.empty())
+                            return rv;
+
+                        const std::vector<std::pair<std::string, std::string>> tokens = {
+                            {"ORIGIN", originDir.string()},
+                            {"LIB", getLibToken(elfClass)},
+                            {"PLATFORM", getPlatformToken(elfClass)},
+                        };
+
+                        for (auto entry : util::split(value, ':')) {
+                            if (entry.empty())
+                                continue;
+
+                            for (const auto& [token, replacement] : tokens) {
+                                for (const auto& pattern : {"${" + token + "}", "$" + token}) {
+                                    for (auto pos = entry.find(pattern); pos != std::string::npos; pos = entry.find(pattern, pos + replacement.size())) {
+                                        entry.replace(pos, pattern.size(), replacement);
+                                    }
+                                }
+                            }
+
+                            rv.emplace_back(entry);
+                        }
+
+                        return rv;
+                    }
+
+                    std::optional<LibraryInfo> probe(const fs::path& candidate, uint8_t elfClass, uint16_t elfMachine) {
+                        std::optional<LibraryInfo> info;
+                        bool cached = false;
+
+                        {
+                            std::lock_guard<std::mutex> lock(probeCacheMutex);
+
+                            const auto cacheIt = probeCache.find(candidate.string());
+
+                            if (cacheIt != probeCache.end()) {
+                                info = cacheIt->second;
+                                cached = true;
+                            }
+                        }
+
+                        // parsing happens without holding the lock
+                        // in the rare case that two threads parse the same file, the results are the same anyway
+                        if (!cached) {
+                            info = parseLibraryInfo(candidate);
+
+                            std::lock_guard<std::mutex> lock(probeCacheMutex);
+                            probeCache.emplace(candidate.string(), info);
+                        }
+
+                        if (!info.has_value())
+                            return std::nullopt;
+
+                        // libraries built for other architectures are skipped by the dynamic linker
+                        if (info->elfClass != elfClass || info->elfMachine != elfMachine) {
+                            ldLog() << LD_DEBUG << "Skipping incompatible library" << candidate << std::endl;
+                            return std::nullopt;
+                        }
+
+                        return info;
+                    }
+
+                    std::optional<std::pair<fs::path, LibraryInfo>> searchDirectories(
+                        const std::string& libraryName, const std::vector<fs::path>& directories, uint8_t elfClass, uint16_t elfMachine
+                    ) {
+                        for (const auto& directory : directories) {
+                            const auto candidate = directory / libraryName;
+
+                            if (auto info = probe(candidate, elfClass, elfMachine))
+                                return std::make_pair(candidate, std::move(*info));
+                        }
+
+                        return std::nullopt;
+                    }
+
+                    std::optional<std::pair<fs::path, LibraryInfo>> findLibrary(
+                        const std::string& libraryName, const std::vector<LoadedObject>& objects, ssize_t loaderIndex
+                    ) {
+                        const auto& loader = objects[loaderIndex];
+                        const auto elfClass = loader.info.elfClass;
+                        const auto elfMachine = loader.info.elfMachine;
+
+                        // names containing a slash are used as paths as-is
+                        if (libraryName.find('/') != std::string::npos) {
+                            const auto candidate = fs::absolute(libraryName);
+
+                            if (auto info = probe(candidate, elfClass, elfMachine))
+                                return std::make_pair(candidate, std::move(*info));
+
+                            return std::nullopt;
+                        }
+
+                        // DT_RPATH is only used if the loader doesn't have a DT_RUNPATH
+                        // in that case, the DT_RPATH entries of all objects in the chain of loaders are searched
+                        if (loader.info.dtRunPath.empty()) {
+                            for (auto index = loaderIndex; index >= 0; index = objects[index].loaderIndex) {
+                                if (!objects[index].info.dtRunPath.empty())
+                                    continue;
+
+                                if (auto rv = searchDirectories(libraryName, objects[index].rpath, elfClass, elfMachine))
+                                    return rv;
+                            }
+                        }
+
+                        for (const auto& directory : ldLibraryPath) {
+                            const auto candidate = fs::absolute(fs::path(directory) / libraryName);
+
+                            if (auto info = probe(candidate, elfClass, elfMachine))
+                                return std::make_pair(candidate, std::move(*info));
+                        }
+
+                        if (auto rv = searchDirectories(libraryName, loader.runpath, elfClass, elfMachine))
+                            return rv;
+
+                        for (const auto& candidate : getSystemLdSoCache().lookup(libraryName, elfClass, elfMachine)) {
+                            if (auto info = probe(candidate, elfClass, elfMachine))
+                                return std::make_pair(candidate, std::move(*info));
+                        }
+
+                        return searchDirectories(libraryName, getSystemLibraryDirectories(), elfClass, elfMachine);
+                    }
+
+                    static LoadedObject makeLoadedObject(LibraryInfo info, const fs::path& originDir, ssize_t loaderIndex) {
+                        LoadedObject object;
+                        object.rpath = expandSearchPath(info.dtRPath, originDir, info.elfClass);
+                        object.runpath = expandSearchPath(info.dtRunPath, originDir, info.elfClass);
+                        object.info = std::move(info);
+                        object.loaderIndex = loaderIndex;
+                        return object;
+                    }
+            };
+
+            DependencyResolver::DependencyResolver() : d(std::make_shared<PrivateData>()) {}
+
+            std::vector<fs::path> DependencyResolver::resolveDependencies(
+                const fs::path& path,
+                ElfFile& elfFile,
+                const std::vector<std::string>& excludeLibraryPatterns,
+                ThreadPool* threadPool
+            ) {
+                std::vector<fs::path> rv;
+
+                // $ORIGIN refers to the directory containing the resolved file for the main object
+                const auto resolvedPath = fs::canonical(path);
+                const auto interpreter = elfFile.getInterpreter();
+
+                // like the dynamic linker, we load the objects breadth-first
+                // this defines which object is used first to search for a library, and therefore which search path
+                // is used
+                std::vector<PrivateData::LoadedObject> objects;
+                objects.emplace_back(PrivateData::makeLoadedObject(PrivateData::readLibraryInfo(elfFile), resolvedPath.parent_path(), -1));
+
+                // libraries are loaded only once, even if requested by several objects
+                std::set<std::string> knownLibraryNames;
+                std::set<fs::path> knownFiles{resolvedPath};
+
+                // the objects are processed level by level
+                // within a level, the libraries are looked up in parallel, as the lookups do not depend on each other
+                // the results are merged in the order the dynamic linker would process them, so the result does not
+                // depend on the order in which the lookups finish
+                for (size_t levelBegin = 0; levelBegin < objects.size();) {
+                    const auto levelEnd = objects.size();
+
+                    std::vector<std::pair<std::string, ssize_t>> requests;
+
+                    for (auto index = levelBegin; index < levelEnd; ++index) {
+                        for (const auto& libraryName : objects[index].info.neededLibraries) {
+                            if (!knownLibraryNames.insert(libraryName).second)
+                                continue;
+
+                            if (isDynamicLinker(libraryName, interpreter)) {
+                                ldLog() << LD_DEBUG << "skipping linker related object" << libraryName << std::endl;
+                                continue;
+                            }
+
+                            requests.emplace_back(libraryName, static_cast<ssize_t>(index));
+                        }
+                    }
+
+                    auto findLibrary = [this, &objects](const std::pair<std::string, ssize_t>& request) {
+                        return d->findLibrary(request.first, objects, request.second);
+                    };
+
+                    std::vector<std::optional<std::pair<fs::path, PrivateData::LibraryInfo>>> results;
+
+                    if (threadPool != nullptr && requests.size() > 1) {
+                        results = threadPool->map(requests.begin(), requests.end(), findLibrary);
+                    } else {
+                        std::transform(requests.begin(), requests.end(), std::back_inserter(results), findLibrary);
+                    }
+
+                    for (size_t i = 0; i < requests.size(); ++i) {
+                        const auto& [libraryName, loaderIndex] = requests[i];
+                        auto& result = results[i];
+
+                        if (!result.has_value()) {
+                            if (!util::isInExcludelist(libraryName, excludeLibraryPatterns)) {
+                                throw DependencyNotFoundError("Could not find dependency: " + libraryName);
+                            }
+
+                            ldLog() << LD_WARNING << resolvedPath.string() << "depends on excluded library:" << libraryName << std::endl;
+                            continue;
+                        }
+
+                        auto& [libraryPath, info] = *result;
+
+                        // the same file might be reachable through different names
+                        std::error_code ec;
+                        const auto canonicalLibraryPath = fs::canonical(libraryPath, ec);
+                        if (!knownFiles.insert(ec ? libraryPath : canonicalLibraryPath).second)
+                            continue;
+
+                        rv.emplace_back(libraryPath);
+
+                        // unlike for the main object, $ORIGIN is not resolved for libraries
+                        objects.emplace_back(PrivateData::makeLoadedObject(std::move(info), libraryPath.parent_path(), loaderIndex));
+                    }
+
+                    levelBegin = levelEnd;
+                }
+
+                return rv;
+            }
+        }
+    }
+}
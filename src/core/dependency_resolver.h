@@ -0,0 +1,65 @@
+#pragma once
+
+// system headers
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// local headers
+#include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/util/thread_pool.h"
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            /**
+             * Resolves the dependencies of ELF files in-process, following the search rules of the glibc dynamic
+             * linker (see ld.so(8)). This replaces calling ldd, which requires one process per file.
+             *
+             * The following locations are searched, in this order:
+             *
+             *     - DT_RPATH of the loading object and its loaders (unless the loading object has a DT_RUNPATH)
+             *     - $LD_LIBRARY_PATH
+             *     - DT_RUNPATH of the loading object
+             *     - the dynamic linker's cache (/etc/ld.so.cache)
+             *     - the directories configured in /etc/ld.so.conf
+             *     - the default system library directories
+             *
+             * $ORIGIN, $LIB and $PLATFORM are expanded in DT_RPATH and DT_RUNPATH entries. Candidates whose ELF class
+             * or machine does not match the file's are skipped, like the dynamic linker does.
+             *
+             * Parsed candidate files are cached, so reusing an instance for several files saves work. Instances may be
+             * used from several threads at once.
+             */
+            class DependencyResolver {
+                private:
+                    // private data class pattern
+                    class PrivateData;
+                    std::shared_ptr<PrivateData> d;
+
+                public:
+                    DependencyResolver();
+
+                    /**
+                     * Resolve the dependencies of an ELF file recursively.
+                     * The dynamic linker itself is never part of the result.
+                     *
+                     * @param path path to ELF file
+                     * @param elfFile parsed ELF file at path
+                     * @param excludeLibraryPatterns patterns of libraries which may be missing on the system
+                     * @param threadPool if set, the libraries are looked up in parallel using this pool (must not be
+                     *     called from a worker thread of the pool then)
+                     * @return absolute paths of all dependencies in the order the dynamic linker would load them
+                     * @throw DependencyNotFoundError if a dependency cannot be found and is not excluded
+                     */
+                    std::vector<std::filesystem::path> resolveDependencies(
+                        const std::filesystem::path& path,
+                        ElfFile& elfFile,
+                        const std::vector<std::string>& excludeLibraryPatterns = {},
+                        util::thread_pool::ThreadPool* threadPool = nullptr
+                    );
+            };
+        }
+    }
+}
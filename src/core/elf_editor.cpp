@@ -0,0 +1,915 @@
+// system headers
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// local headers
+#include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/log/log.h"
+#include "elf_editor.h"
+
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            namespace {
+                uint64_t alignUp(uint64_t value, uint64_t alignment) {
+                    return (value + alignment - 1) / alignment * alignment;
+                }
+
+                void readExactly(int fd, void* buffer, size_t size, uint64_t offset) {
+                    auto* p = static_cast<char*>(buffer);
+
+                    while (size > 0) {
+                        const auto bytesRead = pread(fd, p, size, static_cast<off_t>(offset));
+
+                        if (bytesRead < 0 && errno == EINTR)
+                            continue;
+
+                        if (bytesRead <= 0)
+                            throw ElfEditError("Failed to read from file: unexpected end of file");
+
+                        p += bytesRead;
+                        size -= bytesRead;
+                        offset += bytesRead;
+                    }
+                }
+
+                void writeExactly(int fd, const void* buffer, size_t size, uint64_t offset) {
+                    const auto* p = static_cast<const char*>(buffer);
+
+                    while (size > 0) {
+                        const auto bytesWritten = pwrite(fd, p, size, static_cast<off_t>(offset));
+
+                        if (bytesWritten < 0 && errno == EINTR)
+                            continue;
+
+                        if (bytesWritten <= 0)
+                            throw ElfEditError(std::string("Failed to write to file: ") + strerror(errno));
+
+                        p += bytesWritten;
+                        size -= bytesWritten;
+                        offset += bytesWritten;
+                    }
+                }
+
+                template<typename T>
+                std::vector<T> readArray(int fd, uint64_t count, uint64_t offset, uint64_t fileSize) {
+                    if (offset > fileSize || count > (fileSize - offset) / sizeof(T))
+                        throw ElfEditError("Invalid file: table exceeds file size");
+
+                    std::vector<T> rv(count);
+                    readExactly(fd, rv.data(), count * sizeof(T), offset);
+                    return rv;
+                }
+
+                // tags of dynamic entries whose values are offsets in the dynamic string table
+                bool isStringTag(int64_t tag) {
+                    switch (tag) {
+                        case DT_NEEDED:
+                        case DT_SONAME:
+                        case DT_RPATH:
+                        case DT_RUNPATH:
+                        case DT_AUXILIARY:
+                        case DT_FILTER:
+                        case DT_CONFIG:
+                        case DT_DEPAUDIT:
+                        case DT_AUDIT:
+                            return true;
+                        default:
+                            return false;
+                    }
+                }
+
+                class EditorBase {
+                    public:
+                        virtual ~EditorBase() = default;
+
+                        virtual void setRPath(const std::string& value) = 0;
+                        virtual bool strip() = 0;
+                        virtual void save() = 0;
+                };
+
+                template<typename Ehdr_T, typename Phdr_T, typename Shdr_T, typename Dyn_T, typename Sym_T>
+                class Editor : public EditorBase {
+                    private:
+                        const fs::path path;
+                        uint64_t fileSize = 0;
+
+                        Ehdr_T ehdr{};
+                        std::vector<Phdr_T> phdrs;
+                        std::vector<Shdr_T> shdrs;
+
+                        ssize_t dynamicPhdrIndex = -1;
+                        ssize_t dynamicShdrIndex = -1;
+                        ssize_t dynstrShdrIndex = -1;
+
+                        std::vector<Dyn_T> dynamic;
+                        std::vector<char> dynstr;
+                        uint64_t dynstrOffset = 0;
+
+                        // names of symbols and versions are stored in the dynamic string table, too
+                        // these are only read when needed
+                        std::vector<uint64_t> sectionStringReferences;
+                        bool sectionStringReferencesRead = false;
+
+                        // state of the modifications
+                        bool dynamicChanged = false;
+                        bool dynstrChanged = false;
+                        bool dynamicGrown = false;
+                        bool dynstrGrown = false;
+
+                        // section header table and relocated section contents to write when stripping the file
+                        bool stripPending = false;
+                        std::vector<Shdr_T> strippedShdrs;
+                        std::vector<std::pair<uint64_t, std::vector<char>>> strippedSectionsData;
+                        uint64_t strippedShoff = 0;
+                        uint16_t strippedShstrndx = 0;
+
+                    public:
+                        explicit Editor(fs::path path, int fd, uint64_t fileSize) : path(std::move(path)), fileSize(fileSize) {
+                            readExactly(fd, &ehdr, sizeof(ehdr), 0);
+
+                            if (ehdr.e_phentsize != sizeof(Phdr_T))
+                                throw ElfEditError("Unsupported program header entry size");
+
+                            if (ehdr.e_phnum == PN_XNUM)
+                                throw ElfEditError("Files with extended program header numbering are not supported");
+
+                            phdrs = readArray<Phdr_T>(fd, ehdr.e_phnum, ehdr.e_phoff, fileSize);
+
+                            if (ehdr.e_shnum > 0) {
+                                if (ehdr.e_shentsize != sizeof(Shdr_T))
+                                    throw ElfEditError("Unsupported section header entry size");
+
+                                shdrs = readArray<Shdr_T>(fd, ehdr.e_shnum, ehdr.e_shoff, fileSize);
+                            }
+
+                            for (size_t i = 0; i < phdrs.size(); ++i) {
+                                if (phdrs[i].p_type == PT_DYNAMIC) {
+                                    dynamicPhdrIndex = static_cast<ssize_t>(i);
+                                    break;
+                                }
+                            }
+
+                            if (dynamicPhdrIndex < 0)
+                                return;
+
+                            const auto& dynamicPhdr = phdrs[dynamicPhdrIndex];
+                            dynamic = readArray<Dyn_T>(fd, dynamicPhdr.p_filesz / sizeof(Dyn_T), dynamicPhdr.p_offset, fileSize);
+
+                            // make sure there is a terminating DT_NULL entry we can rely on
+                            if (std::none_of(dynamic.begin(), dynamic.end(), [](const Dyn_T& entry) { return entry.d_tag == DT_NULL; }))
+                                throw ElfEditError("Dynamic section is not terminated");
+
+                            uint64_t strtabAddress = 0;
+                            uint64_t strtabSize = 0;
+
+                            for (const auto& entry : dynamic) {
+                                if (entry.d_tag == DT_STRTAB)
+                                    strtabAddress = entry.d_un.d_ptr;
+                                else if (entry.d_tag == DT_STRSZ)
+                                    strtabSize = entry.d_un.d_val;
+                            }
+
+                            if (strtabAddress == 0)
+                                throw ElfEditError("Dynamic section does not reference a string table");
+
+                            dynstrOffset = vaddrToOffset(strtabAddress);
+                            dynstr = readArray<char>(fd, strtabSize, dynstrOffset, fileSize);
+
+                            for (size_t i = 0; i < shdrs.size(); ++i) {
+                                if (shdrs[i].sh_type == SHT_DYNAMIC && shdrs[i].sh_offset == dynamicPhdr.p_offset)
+                                    dynamicShdrIndex = static_cast<ssize_t>(i);
+                                else if (shdrs[i].sh_type == SHT_STRTAB && shdrs[i].sh_offset == dynstrOffset && shdrs[i].sh_addr == strtabAddress)
+                                    dynstrShdrIndex = static_cast<ssize_t>(i);
+                            }
+                        }
+
+                    private:
+                        uint64_t vaddrToOffset(uint64_t vaddr) const {
+                            for (const auto& phdr : phdrs) {
+                                if (phdr.p_type == PT_LOAD && vaddr >= phdr.p_vaddr && vaddr < phdr.p_vaddr + phdr.p_filesz)
+                                    return vaddr - phdr.p_vaddr + phdr.p_offset;
+                            }
+
+                            throw ElfEditError("Could not map virtual address to file offset");
+                        }
+
+                        std::string getString(uint64_t offset) const {
+                            if (offset >= dynstr.size())
+                                throw ElfEditError("Invalid offset in dynamic string table");
+
+                            return {dynstr.data() + offset, strnlen(dynstr.data() + offset, dynstr.size() - offset)};
+                        }
+
+                        // collect the string table offsets referenced by the symbol and version sections
+                        void readSectionStringReferences() {
+                            if (sectionStringReferencesRead)
+                                return;
+
+                            sectionStringReferencesRead = true;
+
+                            if (dynstrShdrIndex < 0)
+                                return;
+
+                            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                            if (fd < 0)
+                                throw ElfEditError("Could not open file: " + path.string());
+
+                            try {
+                                for (const auto& shdr : shdrs) {
+                                    if (shdr.sh_link != static_cast<uint32_t>(dynstrShdrIndex) || shdr.sh_type == SHT_NOBITS)
+                                        continue;
+
+                                    switch (shdr.sh_type) {
+                                        case SHT_DYNSYM: {
+                                            for (const auto& symbol : readArray<Sym_T>(fd, shdr.sh_size / sizeof(Sym_T), shdr.sh_offset, fileSize)) {
+                                                sectionStringReferences.emplace_back(symbol.st_name);
+                                            }
+                                            break;
+                                        }
+                                        case SHT_GNU_verneed:
+                                        case SHT_GNU_verdef: {
+                                            // the structures of these sections are the same for both ELF classes
+                                            const auto data = readArray<char>(fd, shdr.sh_size, shdr.sh_offset, fileSize);
+                                            readVersionStringReferences(data, shdr.sh_type);
+                                            break;
+                                        }
+                                    }
+                                }
+                            } catch (...) {
+                                close(fd);
+                                throw;
+                            }
+
+                            close(fd);
+                        }
+
+                        void readVersionStringReferences(const std::vector<char>& data, uint32_t type) {
+                            auto read = [&data](uint64_t offset, auto& value) {
+                                if (offset + sizeof(value) > data.size())
+                                    throw ElfEditError("Invalid version section");
+                                memcpy(&value, data.data() + offset, sizeof(value));
+                            };
+
+                            uint64_t offset = 0;
+
+                            // guard against loops in the linked lists
+                            for (size_t i = 0; i < data.size(); ++i) {
+                                uint64_t auxOffset;
+                                uint32_t next;
+                                uint16_t auxCount;
+
+                                if (type == SHT_GNU_verneed) {
+                                    Elf64_Verneed verneed{};
+                                    read(offset, verneed);
+                                    sectionStringReferences.emplace_back(verneed.vn_file);
+                                    auxOffset = offset + verneed.vn_aux;
+                                    auxCount = verneed.vn_cnt;
+                                    next = verneed.vn_next;
+                                } else {
+                                    Elf64_Verdef verdef{};
+                                    read(offset, verdef);
+                                    auxOffset = offset + verdef.vd_aux;
+                                    auxCount = verdef.vd_cnt;
+                                    next = verdef.vd_next;
+                                }
+
+                                for (uint16_t j = 0; j < auxCount; ++j) {
+                                    uint32_t auxNext;
+
+                                    if (type == SHT_GNU_verneed) {
+                                        Elf64_Vernaux vernaux{};
+                                        read(auxOffset, vernaux);
+                                        sectionStringReferences.emplace_back(vernaux.vna_name);
+                                        auxNext = vernaux.vna_next;
+                                    } else {
+                                        Elf64_Verdaux verdaux{};
+                                        read(auxOffset, verdaux);
+                                        sectionStringReferences.emplace_back(verdaux.vda_name);
+                                        auxNext = verdaux.vda_next;
+                                    }
+
+                                    if (auxNext == 0)
+                                        break;
+
+                                    auxOffset += auxNext;
+                                }
+
+                                if (next == 0)
+                                    break;
+
+                                offset += next;
+                            }
+                        }
+
+                        // check whether a string may be overwritten without affecting other users of the string table
+                        // linkers may merge strings which are suffixes of other strings
+                        bool isStringShared(uint64_t offset, uint64_t length) {
+                            // the string may be the suffix of a longer one, which starts before it, and would be
+                            // truncated by the terminating null byte of a new value
+                            if (offset > 0 && dynstr[offset - 1] != '\0')
+                                return true;
+
+                            auto overlaps = [offset, length](uint64_t reference) {
+                                return reference >= offset && reference < offset + length;
+                            };
+
+                            for (const auto& entry : dynamic) {
+                                // the search path entries are going to be replaced anyway
+                                if (entry.d_tag == DT_RPATH || entry.d_tag == DT_RUNPATH)
+                                    continue;
+
+                                if (isStringTag(entry.d_tag) && overlaps(entry.d_un.d_val))
+                                    return true;
+                            }
+
+                            // without section headers, we cannot find all references, so we must assume the worst
+                            if (dynstrShdrIndex < 0)
+                                return true;
+
+                            readSectionStringReferences();
+
+                            return std::any_of(sectionStringReferences.begin(), sectionStringReferences.end(), overlaps);
+                        }
+
+                        ssize_t findDynamicEntry(int64_t tag) const {
+                            for (size_t i = 0; i < dynamic.size() && dynamic[i].d_tag != DT_NULL; ++i) {
+                                if (dynamic[i].d_tag == tag)
+                                    return static_cast<ssize_t>(i);
+                            }
+
+                            return -1;
+                        }
+
+                        size_t findDynamicNull() const {
+                            for (size_t i = 0; i < dynamic.size(); ++i) {
+                                if (dynamic[i].d_tag == DT_NULL)
+                                    return i;
+                            }
+
+                            // checked in the constructor
+                            throw ElfEditError("Dynamic section is not terminated");
+                        }
+
+                        // find or create a string in the dynamic string table
+                        uint64_t addString(const std::string& value) {
+                            // the string might be available already, e.g., as a suffix of another string
+                            const std::string needle(value.c_str(), value.size() + 1);
+
+                            const auto it = std::search(dynstr.begin(), dynstr.end(), needle.begin(), needle.end());
+
+                            if (it != dynstr.end())
+                                return static_cast<uint64_t>(it - dynstr.begin());
+
+                            const auto offset = dynstr.size();
+                            dynstr.insert(dynstr.end(), needle.begin(), needle.end());
+
+                            dynstrChanged = true;
+                            dynstrGrown = true;
+
+                            return offset;
+                        }
+
+                    public:
+                        void setRPath(const std::string& value) override {
+                            if (dynamicPhdrIndex < 0)
+                                throw ElfEditError("File does not have a dynamic section: " + path.string());
+
+                            const auto rpathIndex = findDynamicEntry(DT_RPATH);
+                            const auto runpathIndex = findDynamicEntry(DT_RUNPATH);
+
+                            // nothing to do if the file has the desired value already
+                            if (runpathIndex >= 0 && rpathIndex < 0 && getString(dynamic[runpathIndex].d_un.d_val) == value)
+                                return;
+
+                            // like patchelf, we store the value as DT_RUNPATH
+                            // we reuse the existing entry's string if the new value fits
+                            const auto existingIndex = runpathIndex >= 0 ? runpathIndex : rpathIndex;
+
+                            uint64_t stringOffset;
+                            bool stringFound = false;
+
+                            if (existingIndex >= 0) {
+                                stringOffset = dynamic[existingIndex].d_un.d_val;
+                                const auto oldLength = getString(stringOffset).size();
+
+                                if (value.size() <= oldLength && !isStringShared(stringOffset, oldLength)) {
+                                    std::fill(dynstr.begin() + stringOffset, dynstr.begin() + stringOffset + oldLength, '\0');
+                                    std::copy(value.begin(), value.end(), dynstr.begin() + stringOffset);
+                                    dynstrChanged = true;
+                                    stringFound = true;
+                                }
+                            }
+
+                            if (!stringFound)
+                                stringOffset = addString(value);
+
+                            if (runpathIndex >= 0) {
+                                dynamic[runpathIndex].d_un.d_val = stringOffset;
+
+                                // DT_RPATH is ignored if DT_RUNPATH is set, so we can remove it
+                                if (rpathIndex >= 0) {
+                                    dynamic.erase(dynamic.begin() + rpathIndex);
+                                    dynamic.emplace_back(Dyn_T{});
+                                }
+                            } else if (rpathIndex >= 0) {
+                                dynamic[rpathIndex].d_tag = DT_RUNPATH;
+                                dynamic[rpathIndex].d_un.d_val = stringOffset;
+                            } else {
+                                const auto nullIndex = findDynamicNull();
+
+                                Dyn_T entry{};
+                                entry.d_tag = DT_RUNPATH;
+                                entry.d_un.d_val = stringOffset;
+
+                                // linkers may reserve some spare entries at the end of the section, which we can use
+                                // otherwise, the dynamic section needs to be moved
+                                if (dynamic.size() - nullIndex >= 2) {
+                                    dynamic[nullIndex] = entry;
+                                } else {
+                                    dynamic.insert(dynamic.begin() + nullIndex, entry);
+                                    dynamicGrown = true;
+                                }
+                            }
+
+                            if (dynstrGrown) {
+                                for (auto& entry : dynamic) {
+                                    if (entry.d_tag == DT_STRSZ)
+                                        entry.d_un.d_val = dynstr.size();
+                                }
+                            }
+
+                            dynamicChanged = true;
+                        }
+
+                        bool strip() override {
+                            // relocatable files need their symbol tables
+                            if (ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
+                                throw ElfEditError("Only executables and shared libraries can be stripped: " + path.string());
+
+                            if (shdrs.empty())
+                                return false;
+
+                            if (ehdr.e_shstrndx == SHN_UNDEF || ehdr.e_shstrndx >= shdrs.size())
+                                throw ElfEditError("Invalid section name string table index in file: " + path.string());
+
+                            const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                            if (fd < 0)
+                                throw ElfEditError("Could not open file: " + path.string());
+
+                            try {
+                                planStrip(fd);
+                            } catch (...) {
+                                close(fd);
+                                throw;
+                            }
+
+                            close(fd);
+
+                            return stripPending;
+                        }
+
+                        void save() override {
+                            if (!dynamicChanged && !dynstrChanged && !stripPending)
+                                return;
+
+                            int fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+
+                            // files are often installed read-only, in which case we temporarily make them writable
+                            struct stat originalStat{};
+                            bool restorePermissions = false;
+
+                            if (fd < 0 && errno == EACCES && stat(path.c_str(), &originalStat) == 0) {
+                                if (chmod(path.c_str(), originalStat.st_mode | S_IWUSR) == 0) {
+                                    restorePermissions = true;
+                                    fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+                                }
+                            }
+
+                            if (fd < 0) {
+                                const auto error = errno;
+
+                                if (restorePermissions)
+                                    chmod(path.c_str(), originalStat.st_mode);
+
+                                throw ElfEditError("Could not open file for writing: " + path.string() + ": " + strerror(error));
+                            }
+
+                            try {
+                                write(fd);
+                            } catch (...) {
+                                close(fd);
+
+                                if (restorePermissions)
+                                    chmod(path.c_str(), originalStat.st_mode);
+
+                                throw;
+                            }
+
+                            close(fd);
+
+                            if (restorePermissions)
+                                chmod(path.c_str(), originalStat.st_mode);
+
+                            dynamicChanged = dynstrChanged = dynamicGrown = dynstrGrown = false;
+                        }
+
+                    private:
+                        bool isNeededSection(size_t index, const std::string& name) const {
+                            const auto& shdr = shdrs[index];
+
+                            return index == 0 || index == ehdr.e_shstrndx || !isSectionRemovedByStrip(name, shdr.sh_flags, shdr.sh_type);
+                        }
+
+                        void planStrip(int fd) {
+                            const auto& shstrtabShdr = shdrs[ehdr.e_shstrndx];
+                            const auto shstrtab = readArray<char>(fd, shstrtabShdr.sh_size, shstrtabShdr.sh_offset, fileSize);
+
+                            auto getSectionName = [&shstrtab](const Shdr_T& shdr) -> std::string {
+                                if (shdr.sh_name >= shstrtab.size())
+                                    return {};
+
+                                return {shstrtab.data() + shdr.sh_name, strnlen(shstrtab.data() + shdr.sh_name, shstrtab.size() - shdr.sh_name)};
+                            };
+
+                            std::vector<std::string> names;
+                            std::vector<ssize_t> newIndices(shdrs.size(), -1);
+                            size_t keptCount = 0;
+                            size_t lastAllocIndex = 0;
+                            size_t firstRemovedIndex = shdrs.size();
+
+                            for (size_t i = 0; i < shdrs.size(); ++i) {
+                                names.emplace_back(getSectionName(shdrs[i]));
+
+                                if (isNeededSection(i, names.back())) {
+                                    newIndices[i] = static_cast<ssize_t>(keptCount++);
+
+                                    if ((shdrs[i].sh_flags & SHF_ALLOC) != 0)
+                                        lastAllocIndex = i;
+                                } else {
+                                    firstRemovedIndex = std::min(firstRemovedIndex, i);
+                                }
+                            }
+
+                            if (firstRemovedIndex == shdrs.size())
+                                return;
+
+                            // the dynamic symbols reference loaded sections by their indices, which therefore must not
+                            // change
+                            // linkers put the sections which are not loaded last, so this is hardly ever a problem
+                            if (lastAllocIndex > firstRemovedIndex)
+                                throw ElfEditError("Sections to remove precede loaded sections in file: " + path.string());
+
+                            auto remapIndex = [&newIndices, this](uint32_t index) -> uint32_t {
+                                if (index == SHN_UNDEF)
+                                    return index;
+
+                                if (index >= newIndices.size() || newIndices[index] < 0)
+                                    throw ElfEditError("Needed section references a section to remove in file: " + path.string());
+
+                                return static_cast<uint32_t>(newIndices[index]);
+                            };
+
+                            // the loaded data is left in place, everything after it is rewritten
+                            uint64_t loadedDataEnd = ehdr.e_phoff + phdrs.size() * sizeof(Phdr_T);
+
+                            for (const auto& phdr : phdrs)
+                                loadedDataEnd = std::max<uint64_t>(loadedDataEnd, phdr.p_offset + phdr.p_filesz);
+
+                            // the section names are compacted, too
+                            std::vector<char> newShstrtab(1, '\0');
+
+                            strippedShdrs.clear();
+
+                            for (size_t i = 0; i < shdrs.size(); ++i) {
+                                if (newIndices[i] < 0)
+                                    continue;
+
+                                auto shdr = shdrs[i];
+
+                                if ((shdr.sh_flags & SHF_ALLOC) != 0 && shdr.sh_type != SHT_NOBITS)
+                                    loadedDataEnd = std::max<uint64_t>(loadedDataEnd, shdr.sh_offset + shdr.sh_size);
+
+                                shdr.sh_link = remapIndex(shdr.sh_link);
+
+                                if ((shdr.sh_flags & SHF_INFO_LINK) != 0 || shdr.sh_type == SHT_REL || shdr.sh_type == SHT_RELA)
+                                    shdr.sh_info = remapIndex(shdr.sh_info);
+
+                                if (i > 0) {
+                                    shdr.sh_name = static_cast<uint32_t>(newShstrtab.size());
+                                    newShstrtab.insert(newShstrtab.end(), names[i].begin(), names[i].end());
+                                    newShstrtab.emplace_back('\0');
+                                }
+
+                                strippedShdrs.emplace_back(shdr);
+                            }
+
+                            // the sections which are not loaded are placed after the loaded data, followed by the section
+                            // header table
+                            strippedSectionsData.clear();
+                            strippedShstrndx = static_cast<uint16_t>(newIndices[ehdr.e_shstrndx]);
+
+                            uint64_t offset = loadedDataEnd;
+
+                            for (size_t i = 0, newIndex = 0; i < shdrs.size(); ++i) {
+                                if (newIndices[i] < 0)
+                                    continue;
+
+                                auto& shdr = strippedShdrs[newIndex++];
+
+                                if (i == 0 || (shdr.sh_flags & SHF_ALLOC) != 0)
+                                    continue;
+
+                                std::vector<char> data;
+
+                                if (i == ehdr.e_shstrndx) {
+                                    data = newShstrtab;
+                                } else if (shdr.sh_type != SHT_NOBITS) {
+                                    data = readArray<char>(fd, shdr.sh_size, shdr.sh_offset, fileSize);
+                                }
+
+                                offset = alignUp(offset, std::max<uint64_t>(shdr.sh_addralign, 1));
+                                shdr.sh_offset = offset;
+                                shdr.sh_size = data.size();
+                                offset += data.size();
+
+                                strippedSectionsData.emplace_back(shdr.sh_offset, std::move(data));
+                            }
+
+                            strippedShoff = alignUp(offset, alignof(Shdr_T));
+                            stripPending = true;
+                        }
+
+                        void writeStripped(int fd) {
+                            for (const auto& [offset, data] : strippedSectionsData)
+                                writeExactly(fd, data.data(), data.size(), offset);
+
+                            writeExactly(fd, strippedShdrs.data(), strippedShdrs.size() * sizeof(Shdr_T), strippedShoff);
+
+                            ehdr.e_shoff = strippedShoff;
+                            ehdr.e_shnum = static_cast<decltype(ehdr.e_shnum)>(strippedShdrs.size());
+                            ehdr.e_shstrndx = strippedShstrndx;
+                            writeExactly(fd, &ehdr, sizeof(ehdr), 0);
+
+                            const auto newFileSize = strippedShoff + strippedShdrs.size() * sizeof(Shdr_T);
+
+                            if (ftruncate(fd, static_cast<off_t>(newFileSize)) != 0)
+                                throw ElfEditError(std::string("Failed to truncate file: ") + strerror(errno));
+
+                            // the indices of the loaded sections have not changed, so the dynamic section's and string
+                            // table's indices remain valid
+                            shdrs = std::move(strippedShdrs);
+                            fileSize = newFileSize;
+
+                            strippedShdrs.clear();
+                            strippedSectionsData.clear();
+                            stripPending = false;
+                        }
+
+                        void write(int fd) {
+                            // stripping must come first, as a new segment is appended to the stripped file
+                            if (stripPending)
+                                writeStripped(fd);
+
+                            if (!dynamicChanged && !dynstrChanged)
+                                return;
+
+                            if (dynamicGrown || dynstrGrown) {
+                                appendSegment(fd);
+                                return;
+                            }
+
+                            // everything fits into the existing structures, so we just overwrite them
+                            if (dynstrChanged)
+                                writeExactly(fd, dynstr.data(), dynstr.size(), dynstrOffset);
+
+                            writeExactly(fd, dynamic.data(), dynamic.size() * sizeof(Dyn_T), phdrs[dynamicPhdrIndex].p_offset);
+                        }
+
+                        // move the grown structures to a new loadable segment at the end of the file
+                        // the program header table must be moved as well to make room for the new segment's header
+                        void appendSegment(int fd) {
+                            const Phdr_T* firstLoad = nullptr;
+                            size_t lastLoadIndex = 0;
+                            uint64_t maxVaddrEnd = 0;
+                            uint64_t alignment = 4096;
+
+                            for (size_t i = 0; i < phdrs.size(); ++i) {
+                                const auto& phdr = phdrs[i];
+
+                                if (phdr.p_type != PT_LOAD)
+                                    continue;
+
+                                if (firstLoad == nullptr)
+                                    firstLoad = &phdr;
+
+                                lastLoadIndex = i;
+                                maxVaddrEnd = std::max<uint64_t>(maxVaddrEnd, phdr.p_vaddr + phdr.p_memsz);
+                                alignment = std::max<uint64_t>(alignment, phdr.p_align);
+                            }
+
+                            if (firstLoad == nullptr)
+                                throw ElfEditError("File does not have loadable segments");
+
+                            // older kernels calculate the address of the program header table from the first segment's
+                            // address and e_phoff, so the new segment must use the same offset-to-address mapping
+                            // the segment must not overlap existing ones in memory either
+                            const uint64_t bias = firstLoad->p_vaddr - firstLoad->p_offset;
+                            const auto minimumOffset = std::max<uint64_t>(fileSize, alignUp(maxVaddrEnd, alignment) - bias);
+                            const auto segmentOffset = alignUp(minimumOffset, alignment);
+                            const auto segmentAddress = segmentOffset + bias;
+
+                            Phdr_T segment{};
+                            segment.p_type = PT_LOAD;
+                            segment.p_flags = PF_R | PF_W;
+                            segment.p_offset = segmentOffset;
+                            segment.p_vaddr = segmentAddress;
+                            segment.p_paddr = segmentAddress;
+                            segment.p_align = firstLoad->p_align > 0 ? firstLoad->p_align : alignment;
+
+                            // segments must be sorted by their addresses, so the new one must follow the last one
+                            phdrs.insert(phdrs.begin() + lastLoadIndex + 1, segment);
+
+                            if (static_cast<size_t>(dynamicPhdrIndex) > lastLoadIndex)
+                                ++dynamicPhdrIndex;
+
+                            // layout of the new segment: program headers, dynamic section, dynamic string table
+                            const uint64_t phdrsSize = phdrs.size() * sizeof(Phdr_T);
+                            uint64_t segmentSize = phdrsSize;
+
+                            uint64_t dynamicPosition = 0;
+                            if (dynamicGrown) {
+                                dynamicPosition = alignUp(segmentSize, sizeof(Dyn_T));
+                                segmentSize = dynamicPosition + dynamic.size() * sizeof(Dyn_T);
+                            }
+
+                            uint64_t dynstrPosition = 0;
+                            if (dynstrGrown) {
+                                dynstrPosition = segmentSize;
+                                segmentSize = dynstrPosition + dynstr.size();
+                            }
+
+                            auto& newSegment = phdrs[lastLoadIndex + 1];
+                            newSegment.p_filesz = segmentSize;
+                            newSegment.p_memsz = segmentSize;
+
+                            for (auto& phdr : phdrs) {
+                                if (phdr.p_type == PT_PHDR) {
+                                    phdr.p_offset = segmentOffset;
+                                    phdr.p_vaddr = segmentAddress;
+                                    phdr.p_paddr = segmentAddress;
+                                    phdr.p_filesz = phdrsSize;
+                                    phdr.p_memsz = phdrsSize;
+                                }
+                            }
+
+                            if (dynamicGrown) {
+                                auto& dynamicPhdr = phdrs[dynamicPhdrIndex];
+                                dynamicPhdr.p_offset = segmentOffset + dynamicPosition;
+                                dynamicPhdr.p_vaddr = segmentAddress + dynamicPosition;
+                                dynamicPhdr.p_paddr = segmentAddress + dynamicPosition;
+                                dynamicPhdr.p_filesz = dynamic.size() * sizeof(Dyn_T);
+                                dynamicPhdr.p_memsz = dynamic.size() * sizeof(Dyn_T);
+
+                                if (dynamicShdrIndex >= 0) {
+                                    auto& shdr = shdrs[dynamicShdrIndex];
+                                    shdr.sh_offset = dynamicPhdr.p_offset;
+                                    shdr.sh_addr = dynamicPhdr.p_vaddr;
+                                    shdr.sh_size = dynamicPhdr.p_filesz;
+                                }
+                            }
+
+                            if (dynstrGrown) {
+                                for (auto& entry : dynamic) {
+                                    if (entry.d_tag == DT_STRTAB)
+                                        entry.d_un.d_ptr = segmentAddress + dynstrPosition;
+                                }
+
+                                if (dynstrShdrIndex >= 0) {
+                                    auto& shdr = shdrs[dynstrShdrIndex];
+                                    shdr.sh_offset = segmentOffset + dynstrPosition;
+                                    shdr.sh_addr = segmentAddress + dynstrPosition;
+                                    shdr.sh_size = dynstr.size();
+                                }
+
+                                dynstrOffset = segmentOffset + dynstrPosition;
+                            }
+
+                            std::vector<char> segmentData(segmentSize, '\0');
+                            memcpy(segmentData.data(), phdrs.data(), phdrsSize);
+
+                            if (dynamicGrown)
+                                memcpy(segmentData.data() + dynamicPosition, dynamic.data(), dynamic.size() * sizeof(Dyn_T));
+
+                            if (dynstrGrown)
+                                memcpy(segmentData.data() + dynstrPosition, dynstr.data(), dynstr.size());
+
+                            ldLog() << LD_DEBUG << "Appending new segment at offset" << segmentOffset << "to file" << path << std::endl;
+
+                            // write the new data first, and the headers referencing it last
+                            // this way, the file remains valid as long as possible if something goes wrong
+                            writeExactly(fd, segmentData.data(), segmentData.size(), segmentOffset);
+
+                            if (!dynamicGrown)
+                                writeExactly(fd, dynamic.data(), dynamic.size() * sizeof(Dyn_T), phdrs[dynamicPhdrIndex].p_offset);
+
+                            if (!dynstrGrown && dynstrChanged)
+                                writeExactly(fd, dynstr.data(), dynstr.size(), dynstrOffset);
+
+                            if (!shdrs.empty())
+                                writeExactly(fd, shdrs.data(), shdrs.size() * sizeof(Shdr_T), ehdr.e_shoff);
+
+                            ehdr.e_phoff = segmentOffset;
+                            ehdr.e_phnum = static_cast<decltype(ehdr.e_phnum)>(phdrs.size());
+                            writeExactly(fd, &ehdr, sizeof(ehdr), 0);
+
+                            fileSize = segmentOffset + segmentSize;
+                        }
+                };
+            }
+
+            bool isSectionRemovedByStrip(const std::string& name, uint64_t flags, uint32_t type) {
+                // like strip --strip-all, we remove all sections which are not loaded at runtime, except for a few ones
+                // which tools rely on
+                if ((flags & SHF_ALLOC) != 0)
+                    return false;
+
+                if (name == ".gnu_debuglink" || name == ".gnu_debugaltlink")
+                    return false;
+
+                return type < SHT_LOPROC || type > SHT_HIPROC;
+            }
+
+            class ElfEditor::PrivateData {
+                public:
+                    std::unique_ptr<EditorBase> editor;
+            };
+
+            ElfEditor::ElfEditor(const fs::path& path) : d(std::make_shared<PrivateData>()) {
+                const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                if (fd < 0)
+                    throw ElfEditError("Could not open file: " + path.string() + ": " + strerror(errno));
+
+                try {
+                    struct stat statbuf{};
+                    if (fstat(fd, &statbuf) != 0)
+                        throw ElfEditError("Could not stat file: " + path.string());
+
+                    unsigned char ident[EI_NIDENT];
+                    if (static_cast<uint64_t>(statbuf.st_size) < sizeof(ident))
+                        throw ElfEditError("Not an ELF file: " + path.string());
+
+                    readExactly(fd, ident, sizeof(ident), 0);
+
+                    if (memcmp(ident, ELFMAG, SELFMAG) != 0)
+                        throw ElfEditError("Not an ELF file: " + path.string());
+
+                    if (ident[EI_DATA] != ElfFile::getSystemElfEndianness())
+                        throw ElfEditError("Files in non-native byte order are not supported: " + path.string());
+
+                    const auto fileSize = static_cast<uint64_t>(statbuf.st_size);
+
+                    switch (ident[EI_CLASS]) {
+                        case ELFCLASS32:
+                            d->editor = std::make_unique<Editor<Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Dyn, Elf32_Sym>>(path, fd, fileSize);
+                            break;
+                        case ELFCLASS64:
+                            d->editor = std::make_unique<Editor<Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Dyn, Elf64_Sym>>(path, fd, fileSize);
+                            break;
+                        default:
+                            throw ElfEditError("Unknown ELF class in file: " + path.string());
+                    }
+                } catch (...) {
+                    close(fd);
+                    throw;
+                }
+
+                close(fd);
+            }
+
+            void ElfEditor::setRPath(const std::string& value) {
+                d->editor->setRPath(value);
+            }
+
+            bool ElfEditor::strip() {
+                return d->editor->strip();
+            }
+
+            void ElfEditor::save() {
+                d->editor->save();
+            }
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// system headers
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            // thrown by ElfEditor if a file cannot be edited
+            class ElfEditError : public std::runtime_error {
+                public:
+                    explicit ElfEditError(const std::string& msg) : std::runtime_error(msg) {}
+            };
+
+            /**
+             * Check whether stripping removes a section, like strip --strip-all does.
+             * The null section and the section name string table are always kept, regardless of the result.
+             *
+             * @param name section name
+             * @param flags section flags (sh_flags)
+             * @param type section type (sh_type)
+             * @return true if the section is not needed at runtime, false otherwise
+             */
+            bool isSectionRemovedByStrip(const std::string& name, uint64_t flags, uint32_t type);
+
+            /**
+             * Edits the dynamic section of 32-bit and 64-bit ELF files in-process, and strips them.
+             *
+             * Changes are collected in memory and written with save(). Whenever possible, the file is modified in
+             * place, i.e., only the changed bytes are rewritten and the file size does not change. If new data does not
+             * fit into the existing structures, the program header table, the dynamic section and/or the dynamic string
+             * table are copied to a new loadable segment which is appended to the file. The original data is left
+             * untouched, so offsets referenced elsewhere in the file remain valid.
+             *
+             * Only files in the machine's native byte order are supported.
+             */
+            class ElfEditor {
+                private:
+                    // private data class pattern
+                    class PrivateData;
+                    std::shared_ptr<PrivateData> d;
+
+                public:
+                    /**
+                     * Read the ELF file at the given path.
+                     *
+                     * @param path path to ELF file
+                     * @throw ElfEditError if the file cannot be read or is not supported
+                     */
+                    explicit ElfEditor(const std::filesystem::path& path);
+
+                    /**
+                     * Set the library search path of the file.
+                     * Like patchelf --set-rpath, the value is stored as DT_RUNPATH, and an existing DT_RPATH is
+                     * converted or removed.
+                     *
+                     * @param value new search path
+                     * @throw ElfEditError if the file has no dynamic section
+                     */
+                    void setRPath(const std::string& value);
+
+                    /**
+                     * Remove the symbol table, debug information and all other sections which are not needed at
+                     * runtime, like strip --strip-all does. The loaded data is not modified. The contents of the
+                     * remaining sections which are not loaded are moved behind it, followed by a new section header
+                     * table, and the file is truncated.
+                     *
+                     * @return true if there are sections to remove, false if the file is stripped already
+                     * @throw ElfEditError if the file is not an executable or shared library, or its layout is not
+                     * supported
+                     */
+                    bool strip();
+
+                    /**
+                     * Write the changes to the file. Does nothing if there are no changes.
+                     *
+                     * @throw ElfEditError on write errors
+                     */
+                    void save();
+            };
+        }
+    }
+}
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <memory>
 #include <regex>
+#include <string_view>
 #include <sys/mman.h>
 #include <utility>
 
@@ -12,6 +13,8 @@
 #include "linuxdeploy/log/log.h"
 #include "linuxdeploy/util/util.h"
 #include "linuxdeploy/subprocess/subprocess.h"
+#include "dependency_resolver.h"
+#include "elf_editor.h"
 
 using namespace linuxdeploy::log;
 
@@ -25,8 +28,17 @@ namespace linuxdeploy {
                     const fs::path path;
                     uint8_t elfClass = ELFCLASSNONE;
                     uint8_t elfABI = 0;
+                    uint16_t elfMachine = EM_NONE;
                     bool isDebugSymbolsFile = false;
                     bool isDynamicallyLinked = false;
+                    bool isStrippable = false;
+
+                    // data from the program headers and the dynamic section
+                    std::string interpreter;
+                    std::vector<std::string> neededLibraries;
+                    std::string dtRPath;
+                    std::string dtRunPath;
+                    std::string soname;
 
                 public:
                     explicit PrivateData(fs::path path) : path(std::move(path)) {}
@@ -73,9 +85,137 @@ namespace linuxdeploy {
                         return patchelfPath;
                     }
 
+                public:
+                    std::string getRPathUsingPatchelf() {
+                        // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
+                        const auto patchelfPath = getPatchelfPath();
+
+                        try {
+                            subprocess::subprocess patchelfProc({patchelfPath, "--print-rpath", path.string()});
+
+                            const auto result = patchelfProc.run();
+
+                            if (result.exit_code() != 0) {
+                                // if file is not an ELF executable, there is no need for a detailed error message
+                                if (result.exit_code() == 1 && result.stderr_string().find("not an ELF executable") != std::string::npos) {
+                                    return "";
+                                } else {
+                                    ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string();
+                                    return "";
+                                }
+                            }
+
+                            auto stdoutContents = result.stdout_string();
+
+                            util::trim(stdoutContents, '\n');
+                            util::trim(stdoutContents);
+
+                            return stdoutContents;
+                        } catch (const std::exception&) {
+                            return "";
+                        }
+                    }
+
+                    bool setRPathUsingPatchelf(const std::string& value) {
+                        // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
+                        const auto patchelfPath = getPatchelfPath();
+
+                        // calling (older versions of) patchelf on symlinks can lead to weird behavior, e.g., patchelf copying the
+                        // original file and patching the copy instead of patching the symlink target
+                        const auto canonicalPath = fs::canonical(path);
+
+                        ldLog() << LD_DEBUG << "Calling patchelf on canonical path" << canonicalPath << "instead of original path" << path << std::endl;
+
+                        try {
+                            subprocess::subprocess patchelfProc({patchelfPath.c_str(), "--set-rpath", value.c_str(), canonicalPath.c_str()});
+
+                            const auto result = patchelfProc.run();
+
+                            if (result.exit_code() != 0) {
+                                ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string() << std::endl;
+                                return false;
+                            }
+                        } catch (const std::exception&) {
+                            return false;
+                        }
+
+                        dtRunPath = value;
+                        dtRPath.clear();
+
+                        return true;
+                    }
+
                 private:
-                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T>
-                    void parseElfHeader(std::shared_ptr<uint8_t> data) {
+                    template<typename Phdr_T, typename Dyn_T>
+                    void parseDynamicSection(const uint8_t* data, size_t size, const Phdr_T& dynamicSegment, const std::vector<Phdr_T>& loadSegments) {
+                        if (dynamicSegment.p_offset + dynamicSegment.p_filesz > size)
+                            throw ElfFileParseError("Dynamic section exceeds file size: " + path.string());
+
+                        // the string table is referenced by its virtual address, so we need to map that back to a file
+                        // offset using the loadable segments
+                        auto vaddrToOffset = [&loadSegments](uint64_t vaddr) -> uint64_t {
+                            for (const auto& segment : loadSegments) {
+                                if (vaddr >= segment.p_vaddr && vaddr < segment.p_vaddr + segment.p_filesz)
+                                    return vaddr - segment.p_vaddr + segment.p_offset;
+                            }
+
+                            throw ElfFileParseError("Could not map virtual address to file offset");
+                        };
+
+                        const auto* entries = reinterpret_cast<const Dyn_T*>(data + dynamicSegment.p_offset);
+                        const auto entriesCount = dynamicSegment.p_filesz / sizeof(Dyn_T);
+
+                        uint64_t strtabAddress = 0;
+                        uint64_t strtabSize = 0;
+
+                        for (uint64_t i = 0; i < entriesCount && entries[i].d_tag != DT_NULL; ++i) {
+                            switch (entries[i].d_tag) {
+                                case DT_STRTAB:
+                                    strtabAddress = entries[i].d_un.d_ptr;
+                                    break;
+                                case DT_STRSZ:
+                                    strtabSize = entries[i].d_un.d_val;
+                                    break;
+                            }
+                        }
+
+                        // a dynamic section without a string table cannot reference any libraries
+                        if (strtabAddress == 0)
+                            return;
+
+                        const auto strtabOffset = vaddrToOffset(strtabAddress);
+
+                        if (strtabOffset + strtabSize > size)
+                            throw ElfFileParseError("Dynamic string table exceeds file size: " + path.string());
+
+                        auto getString = [data, strtabOffset, strtabSize](uint64_t offset) {
+                            if (offset >= strtabSize)
+                                throw ElfFileParseError("Invalid offset in dynamic string table");
+
+                            const auto* begin = reinterpret_cast<const char*>(data + strtabOffset + offset);
+                            return std::string{begin, strnlen(begin, strtabSize - offset)};
+                        };
+
+                        for (uint64_t i = 0; i < entriesCount && entries[i].d_tag != DT_NULL; ++i) {
+                            switch (entries[i].d_tag) {
+                                case DT_NEEDED:
+                                    neededLibraries.emplace_back(getString(entries[i].d_un.d_val));
+                                    break;
+                                case DT_RPATH:
+                                    dtRPath = getString(entries[i].d_un.d_val);
+                                    break;
+                                case DT_RUNPATH:
+                                    dtRunPath = getString(entries[i].d_un.d_val);
+                                    break;
+                                case DT_SONAME:
+                                    soname = getString(entries[i].d_un.d_val);
+                                    break;
+                            }
+                        }
+                    }
+
+                    template<typename Ehdr_T, typename Shdr_T, typename Phdr_T, typename Dyn_T>
+                    void parseElfHeader(std::shared_ptr<uint8_t> data, size_t size) {
                         // TODO: the following code will _only_ work if the native byte order equals the program's
                         // this should not be a big problem as we don't offer ARM builds yet, and require the user to
                         // use a matching binary for the target binaries
@@ -83,6 +223,7 @@ namespace linuxdeploy {
                         auto* ehdr = reinterpret_cast<Ehdr_T*>(data.get());
 
                         elfABI = ehdr->e_ident[EI_OSABI];
+                        elfMachine = ehdr->e_machine;
 
                         std::vector<Shdr_T> sections;
 
@@ -106,21 +247,44 @@ namespace linuxdeploy {
                             sectionsMap.insert(std::make_pair(headerName, shdr));
                         });
 
+                        for (uint64_t i = 1; i < sections.size() && !isStrippable; ++i) {
+                            if (i != ehdr->e_shstrndx)
+                                isStrippable = isSectionRemovedByStrip(getString(sections[i].sh_name), sections[i].sh_flags, sections[i].sh_type);
+                        }
+
                         // this function is based on observations of the behavior of:
                         // - strip --only-keep-debug
                         // - objcopy --only-keep-debug
                         isDebugSymbolsFile = (sectionsMap[".text"].sh_type == SHT_NOBITS);
 
+                        std::vector<Phdr_T> loadSegments;
+                        const Phdr_T* dynamicSegment = nullptr;
+
                         // https://stackoverflow.com/a/7298931
-                        for (uint64_t i = 0; i < ehdr->e_phnum && !isDynamicallyLinked; ++i) {
+                        for (uint64_t i = 0; i < ehdr->e_phnum; ++i) {
                             auto* nextPhdr = reinterpret_cast<Phdr_T*>(data.get() + ehdr->e_phoff + i * sizeof(Phdr_T));
                             switch (nextPhdr->p_type) {
+                                case PT_LOAD:
+                                    loadSegments.emplace_back(*nextPhdr);
+                                    break;
                                 case PT_DYNAMIC:
+                                    isDynamicallyLinked = true;
+                                    dynamicSegment = nextPhdr;
+                                    break;
                                 case PT_INTERP:
                                     isDynamicallyLinked = true;
+                                    if (nextPhdr->p_offset + nextPhdr->p_filesz <= size) {
+                                        const auto* begin = reinterpret_cast<const char*>(data.get() + nextPhdr->p_offset);
+                                        interpreter = std::string{begin, strnlen(begin, nextPhdr->p_filesz)};
+                                    }
                                     break;
                             }
                         }
+
+                        // debug symbols files contain a dynamic segment whose contents have been removed
+                        if (dynamicSegment != nullptr && !isDebugSymbolsFile) {
+                            parseDynamicSection<Phdr_T, Dyn_T>(data.get(), size, *dynamicSegment, loadSegments);
+                        }
                     }
 
                 public:
@@ -148,10 +312,10 @@ namespace linuxdeploy {
 
                         switch (elfClass) {
                             case ELFCLASS32:
-                                parseElfHeader<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr>(data);
+                                parseElfHeader<Elf32_Ehdr, Elf32_Shdr, Elf32_Phdr, Elf32_Dyn>(data, map_size);
                                 break;
                             case ELFCLASS64:
-                                parseElfHeader<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr>(data);
+                                parseElfHeader<Elf64_Ehdr, Elf64_Shdr, Elf64_Phdr, Elf64_Dyn>(data, map_size);
                                 break;
                             default:
                                 throw ElfFileParseError("Unknown ELF class: " + std::to_string(elfClass));
@@ -187,15 +351,22 @@ namespace linuxdeploy {
                 // this method's purpose is to abstract this process
                 // the caller doesn't care _how_ it's done, after all
 
-                // for now, we use the same ldd based method linuxdeployqt uses
-
                 // of course, it makes no sense to call this method on statically linked binaries
                 assert(isDynamicallyLinked());
 
+                // by default, we resolve the dependencies ourselves, following the rules of the dynamic linker
+                // the ldd based method linuxdeployqt uses is still available as a fallback, but requires one
+                // process per call
+                if (getenv("LINUXDEPLOY_USE_LDD") == nullptr) {
+                    DependencyResolver resolver;
+                    return resolver.resolveDependencies(d->path, *this, excludeLibraryPatterns);
+                }
+
+                ldLog() << LD_DEBUG << "$LINUXDEPLOY_USE_LDD set, using ldd to trace dependencies of" << d->path << std::endl;
+
                 std::vector<fs::path> paths;
 
-                auto env = subprocess::get_environment();
-                env["LC_ALL"] = "C";
+                const auto env = subprocess::environment::current().set("LC_ALL", "C");
 
                 // workaround for https://sourceware.org/bugzilla/show_bug.cgi?id=25263
                 // when you pass an absolute path to ldd, it can find libraries referenced in the rpath properly
@@ -205,114 +376,96 @@ namespace linuxdeploy {
 
                 subprocess::subprocess lddProc({"ldd", resolvedPath.string()}, env);
 
-                const auto result = lddProc.run();
-
-                if (result.exit_code() != 0) {
-                    if (result.stdout_string().find("not a dynamic executable") != std::string::npos || result.stderr_string().find("not a dynamic executable") != std::string::npos) {
-                        ldLog() << LD_WARNING << this->d->path << "is not linked dynamically" << std::endl;
-                        return {};
-                    }
+                const std::regex expr(R"(\s*(.+)\s+\=>\s+(.+)\s+\((.+)\)\s*)");
+                std::cmatch what;
 
-                    throw std::runtime_error{"Failed to run ldd: exited with code " + std::to_string(result.exit_code())};
-                }
+                bool notDynamicExecutable = false;
 
-                const std::regex expr(R"(\s*(.+)\s+\=>\s+(.+)\s+\((.+)\)\s*)");
-                std::smatch what;
+                // only evaluated once ldd has succeeded
+                std::vector<std::string> notFoundLines;
 
-                auto lddLines = util::splitLines(result.stdout_string());
+                auto checkNotDynamicExecutable = [&notDynamicExecutable](std::string_view line) {
+                    if (line.find("not a dynamic executable") != std::string_view::npos)
+                        notDynamicExecutable = true;
+                };
 
-                // filter known-problematic, known-unneeded lines
-                // see https://github.com/linuxdeploy/linuxdeploy/issues/210
-                lddLines.erase(
-                    std::remove_if(lddLines.begin(), lddLines.end(), [&lddLines](auto line) {
-                        if (util::stringContains(line, "linux-vdso.so") || util::stringContains(line, "ld-linux-")) {
-                            ldLog() << LD_DEBUG << "skipping linker related object" << line << std::endl;
-                            return true;
-                        }
+                // the output is parsed line by line while ldd is running, so it is never buffered as a whole
+                const auto exitCode = lddProc.run_lines([&](std::string_view line) {
+                    checkNotDynamicExecutable(line);
 
-                        return false;
-                    }),
-                    lddLines.end()
-                );
+                    // filter known-problematic, known-unneeded lines
+                    // see https://github.com/linuxdeploy/linuxdeploy/issues/210
+                    if (line.find("linux-vdso.so") != std::string_view::npos || line.find("ld-linux-") != std::string_view::npos) {
+                        ldLog() << LD_DEBUG << "skipping linker related object" << std::string(line) << std::endl;
+                        return;
+                    }
 
-                for (const auto& line : lddLines) {
-                    if (std::regex_search(line, what, expr)) {
+                    if (std::regex_search(line.data(), line.data() + line.size(), what, expr)) {
                         auto libraryPath = what[2].str();
                         util::trim(libraryPath);
                         paths.push_back(fs::absolute(libraryPath));
+                    } else if (line.find("=> not found") != std::string_view::npos) {
+                        notFoundLines.emplace_back(line);
                     } else {
-                        if (util::stringContains(line, "=> not found")) {
-                            auto missingLib = line;
-                            static const std::string pattern = "=> not found";
-                            missingLib.erase(missingLib.find(pattern), pattern.size());
-                            util::trim(missingLib);
-                            util::trim(missingLib, '\t');
-                            if (!util::isInExcludelist(missingLib, excludeLibraryPatterns)) {
-                                throw DependencyNotFoundError("Could not find dependency: " + missingLib);
-                            }
-                            ldLog() << LD_WARNING << resolvedPath.string() << "depends on excluded library:" << missingLib << std::endl;
-                        } else {
-                            ldLog() << LD_DEBUG << "Invalid ldd output: " << line << std::endl;
-                        }
+                        ldLog() << LD_DEBUG << "Invalid ldd output: " << std::string(line) << std::endl;
+                    }
+                }, checkNotDynamicExecutable);
+
+                if (exitCode != 0) {
+                    if (notDynamicExecutable) {
+                        ldLog() << LD_WARNING << this->d->path << "is not linked dynamically" << std::endl;
+                        return {};
                     }
+
+                    throw std::runtime_error{"Failed to run ldd: exited with code " + std::to_string(exitCode)};
+                }
+
+                for (auto missingLib : notFoundLines) {
+                    static const std::string pattern = "=> not found";
+                    missingLib.erase(missingLib.find(pattern), pattern.size());
+                    util::trim(missingLib);
+                    util::trim(missingLib, '\t');
+                    if (!util::isInExcludelist(missingLib, excludeLibraryPatterns)) {
+                        throw DependencyNotFoundError("Could not find dependency: " + missingLib);
+                    }
+                    ldLog() << LD_WARNING << resolvedPath.string() << "depends on excluded library:" << missingLib << std::endl;
                 }
 
                 return paths;
             }
 
             std::string ElfFile::getRPath() {
-                // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
-                const auto patchelfPath = PrivateData::getPatchelfPath();
+                if (getenv("LINUXDEPLOY_USE_PATCHELF") != nullptr)
+                    return d->getRPathUsingPatchelf();
 
-                try {
-                    subprocess::subprocess patchelfProc({patchelfPath, "--print-rpath", d->path.string()});
-
-                    const auto result = patchelfProc.run();
+                // like patchelf --print-rpath, we prefer DT_RUNPATH, which makes the dynamic linker ignore DT_RPATH
+                if (!d->dtRunPath.empty())
+                    return d->dtRunPath;
 
-                    if (result.exit_code() != 0) {
-                        // if file is not an ELF executable, there is no need for a detailed error message
-                        if (result.exit_code() == 1 && result.stderr_string().find("not an ELF executable") != std::string::npos) {
-                            return "";
-                        } else {
-                            ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string();
-                            return "";
-                        }
-                    }
-
-                    auto stdoutContents = result.stdout_string();
-
-                    util::trim(stdoutContents, '\n');
-                    util::trim(stdoutContents);
-
-                    return stdoutContents;
-                } catch (const std::exception&) {
-                    return "";
-                }
+                return d->dtRPath;
             }
 
             bool ElfFile::setRPath(const std::string& value) {
-                // don't try to fetch patchelf path in a catchall to make sure the process exists when the tool cannot be found
-                const auto patchelfPath = PrivateData::getPatchelfPath();
+                // the files are edited in-process by default, patchelf can still be used if needed
+                if (getenv("LINUXDEPLOY_USE_PATCHELF") != nullptr)
+                    return d->setRPathUsingPatchelf(value);
 
-                // calling (older versions of) patchelf on symlinks can lead to weird behavior, e.g., patchelf copying the
-                // original file and patching the copy instead of patching the symlink target
+                // when editing a symlink, we want to edit its target, which the editor does not do on its own
                 const auto canonicalPath = fs::canonical(d->path);
 
-                ldLog() << LD_DEBUG << "Calling patchelf on canonical path" << canonicalPath << "instead of original path" << d->path << std::endl;
-
                 try {
-                    subprocess::subprocess patchelfProc({patchelfPath.c_str(), "--set-rpath", value.c_str(), canonicalPath.c_str()});
-
-                    const auto result = patchelfProc.run();
-
-                    if (result.exit_code() != 0) {
-                        ldLog() << LD_ERROR << "Call to patchelf failed:" << std::endl << result.stderr_string() << std::endl;
-                        return false;
-                    }
-                } catch (const std::exception&) {
+                    ElfEditor editor(canonicalPath);
+                    editor.setRPath(value);
+                    editor.save();
+                } catch (const ElfEditError& e) {
+                    ldLog() << LD_ERROR << "Failed to set rpath:" << e.what() << std::endl;
+                    ldLog() << LD_ERROR << "Set $LINUXDEPLOY_USE_PATCHELF to use patchelf instead" << std::endl;
                     return false;
                 }
 
+                d->dtRunPath = value;
+                d->dtRPath.clear();
+
                 return true;
             }
 
@@ -368,6 +521,30 @@ namespace linuxdeploy {
                 return d->elfABI;
             }
 
+            uint16_t ElfFile::getElfMachine() {
+                return d->elfMachine;
+            }
+
+            std::string ElfFile::getInterpreter() {
+                return d->interpreter;
+            }
+
+            std::vector<std::string> ElfFile::getNeededLibraries() {
+                return d->neededLibraries;
+            }
+
+            std::string ElfFile::getDtRPath() {
+                return d->dtRPath;
+            }
+
+            std::string ElfFile::getDtRunPath() {
+                return d->dtRunPath;
+            }
+
+            std::string ElfFile::getSoname() {
+                return d->soname;
+            }
+
             bool ElfFile::isDebugSymbolsFile() {
                 return d->isDebugSymbolsFile;
             }
@@ -375,6 +552,10 @@ namespace linuxdeploy {
             bool ElfFile::isDynamicallyLinked() {
                 return d->isDynamicallyLinked;
             }
+
+            bool ElfFile::isStrippable() {
+                return d->isStrippable;
+            }
         }
     }
 }
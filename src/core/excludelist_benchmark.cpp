@@ -0,0 +1,85 @@
+// compares matching library names against the generated excludelist using fnmatch on every pattern with using the
+// compiled matcher
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "linuxdeploy/util/util.h"
+#include "linuxdeploy/util/excludelist_matcher.h"
+#include "excludelist.h"
+
+using namespace linuxdeploy::util::misc;
+
+namespace {
+    template<typename F>
+    void benchmark(const std::string& name, size_t iterations, size_t lookupsPerIteration, F&& function) {
+        const auto begin = std::chrono::steady_clock::now();
+
+        size_t found = 0;
+        for (size_t i = 0; i < iterations; ++i) {
+            found += function();
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const auto totalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+
+        std::cout << name << ": " << (totalNs / static_cast<double>(iterations * lookupsPerIteration)) << " ns per lookup "
+                  << "(" << found / iterations << "/" << lookupsPerIteration << " matched)" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc >= 2 ? std::stoul(argv[1]) : 1000;
+
+    // every excluded library, and as many libraries which are typically deployed
+    std::vector<std::string> libraryNames = generatedExcludelist;
+
+    for (const char* name : {
+        "libQt5Core.so.5", "libQt5Gui.so.5", "libQt5Widgets.so.5", "libQt5Network.so.5", "libQt5DBus.so.5",
+        "libgtk-3.so.0", "libgdk-3.so.0", "libpango-1.0.so.0", "libcairo.so.2", "libglib-2.0.so.0",
+        "libgobject-2.0.so.0", "libpng16.so.16", "libjpeg.so.8", "libssl.so.3", "libcrypto.so.3", "libcurl.so.4",
+        "libicuuc.so.70", "libicudata.so.70", "libicui18n.so.70", "libpcre2-8.so.0", "libzstd.so.1", "liblzma.so.5",
+        "libbz2.so.1.0", "libffi.so.8", "libxml2.so.2", "libsqlite3.so.0", "libtiff.so.5", "libwebp.so.7",
+    }) {
+        libraryNames.emplace_back(name);
+    }
+
+    // typical user supplied patterns, which are checked in addition to the generated excludelist
+    const std::vector<std::string> userPatterns = {"libQt5WebEngine*", "libnvidia-*", "*.so.1.2.3", "libfoo?.so"};
+
+    std::vector<std::string> allPatterns = generatedExcludelist;
+    allPatterns.insert(allPatterns.end(), userPatterns.begin(), userPatterns.end());
+
+    std::cout << "Matching " << libraryNames.size() << " names against " << generatedExcludelist.size()
+              << " generated and " << userPatterns.size() << " user patterns, " << iterations << " iterations"
+              << std::endl;
+
+    benchmark("fnmatch", iterations, libraryNames.size(), [&]() {
+        size_t found = 0;
+        for (const auto& libraryName : libraryNames) {
+            found += isInExcludelist(libraryName, generatedExcludelist) || isInExcludelist(libraryName, userPatterns);
+        }
+        return found;
+    });
+
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        const ExcludelistMatcher matcher(allPatterns);
+        const auto end = std::chrono::steady_clock::now();
+
+        std::cout << "compiling matcher: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()
+                  << " us" << std::endl;
+
+        benchmark("compiled matcher", iterations, libraryNames.size(), [&]() {
+            size_t found = 0;
+            for (const auto& libraryName : libraryNames) {
+                found += matcher.matches(libraryName);
+            }
+            return found;
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,299 @@
+// system headers
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <map>
+#include <mutex>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "file_copy.h"
+
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace {
+            // ordered by preference
+            enum class CopyMethod {
+                Clone,
+                CopyFileRange,
+                Sendfile,
+                ReadWrite,
+            };
+
+            const char* getCopyMethodName(CopyMethod method) {
+                switch (method) {
+                    case CopyMethod::Clone:
+                        return "FICLONE";
+                    case CopyMethod::CopyFileRange:
+                        return "copy_file_range";
+                    case CopyMethod::Sendfile:
+                        return "sendfile";
+                    case CopyMethod::ReadWrite:
+                        return "read/write";
+                }
+
+                return "unknown";
+            }
+
+            // the method that worked for a pair of filesystems, indexed by the source's and the destination's device
+            std::map<std::pair<dev_t, dev_t>, CopyMethod> knownCopyMethods;
+            std::mutex knownCopyMethodsMutex;
+
+            class FileDescriptor {
+                private:
+                    int fd;
+
+                public:
+                    explicit FileDescriptor(int fd) : fd(fd) {}
+
+                    ~FileDescriptor() {
+                        if (fd >= 0)
+                            ::close(fd);
+                    }
+
+                    FileDescriptor(const FileDescriptor&) = delete;
+                    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+                    int get() const {
+                        return fd;
+                    }
+            };
+
+            // errors which indicate that a primitive is not supported for the files involved, rather than actual I/O
+            // errors
+            bool isUnsupportedError(int error) {
+                switch (error) {
+                    case EXDEV:
+                    case ENOSYS:
+                    case EOPNOTSUPP:
+                    case EINVAL:
+                    case ENOTTY:
+                    case EBADF:
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            class FileCopier {
+                private:
+                    const fs::path& from;
+                    const fs::path& to;
+                    const int sourceFd;
+                    const int destinationFd;
+
+                    // all methods continue at this offset, so a method can take over if another one fails midway
+                    off_t offset = 0;
+
+                public:
+                    FileCopier(const fs::path& from, const fs::path& to, int sourceFd, int destinationFd)
+                        : from(from), to(to), sourceFd(sourceFd), destinationFd(destinationFd) {}
+
+                    [[noreturn]] void throwError(const std::string& message, int error) const {
+                        throw fs::filesystem_error(message, from, to, std::error_code(error, std::generic_category()));
+                    }
+
+                    // returns false if the method is not supported, and throws on other errors
+                    bool copy(CopyMethod method) {
+                        switch (method) {
+                            case CopyMethod::Clone:
+                                return copyUsingClone();
+                            case CopyMethod::CopyFileRange:
+                                return copyUsingCopyFileRange();
+                            case CopyMethod::Sendfile:
+                                return copyUsingSendfile();
+                            case CopyMethod::ReadWrite:
+                                return copyUsingReadWrite();
+                        }
+
+                        return false;
+                    }
+
+                private:
+                    bool copyUsingClone() {
+                        // clones always cover the entire file
+                        if (offset != 0)
+                            return false;
+
+                        if (ioctl(destinationFd, FICLONE, sourceFd) != 0) {
+                            if (isUnsupportedError(errno))
+                                return false;
+
+                            throwError("FICLONE failed", errno);
+                        }
+
+                        return true;
+                    }
+
+                    bool copyUsingCopyFileRange() {
+                        bool copiedAnything = false;
+
+                        for (;;) {
+                            loff_t sourceOffset = offset;
+                            loff_t destinationOffset = offset;
+
+                            const auto rv = copy_file_range(sourceFd, &sourceOffset, destinationFd, &destinationOffset, 1 << 30, 0);
+
+                            if (rv < 0) {
+                                if (errno == EINTR)
+                                    continue;
+
+                                if (!copiedAnything && isUnsupportedError(errno))
+                                    return false;
+
+                                throwError("copy_file_range failed", errno);
+                            }
+
+                            // some pseudo filesystems report 0 before the end of the file instead of failing, the
+                            // other methods detect the end of the file reliably in that case
+                            if (rv == 0)
+                                return copiedAnything || isAtEnd();
+
+                            offset += rv;
+                            copiedAnything = true;
+                        }
+                    }
+
+                    bool copyUsingSendfile() {
+                        if (lseek(destinationFd, offset, SEEK_SET) < 0)
+                            throwError("lseek failed", errno);
+
+                        bool copiedAnything = false;
+
+                        for (;;) {
+                            const auto rv = sendfile(destinationFd, sourceFd, &offset, 1 << 30);
+
+                            if (rv < 0) {
+                                if (errno == EINTR)
+                                    continue;
+
+                                if (!copiedAnything && isUnsupportedError(errno))
+                                    return false;
+
+                                throwError("sendfile failed", errno);
+                            }
+
+                            if (rv == 0)
+                                return true;
+
+                            copiedAnything = true;
+                        }
+                    }
+
+                    bool copyUsingReadWrite() {
+                        char buffer[128 * 1024];
+
+                        for (;;) {
+                            const auto bytesRead = pread(sourceFd, buffer, sizeof(buffer), offset);
+
+                            if (bytesRead < 0) {
+                                if (errno == EINTR)
+                                    continue;
+
+                                throwError("read failed", errno);
+                            }
+
+                            if (bytesRead == 0)
+                                return true;
+
+                            for (ssize_t written = 0; written < bytesRead;) {
+                                const auto rv = pwrite(destinationFd, buffer + written, bytesRead - written, offset + written);
+
+                                if (rv < 0) {
+                                    if (errno == EINTR)
+                                        continue;
+
+                                    throwError("write failed", errno);
+                                }
+
+                                written += rv;
+                            }
+
+                            offset += bytesRead;
+                        }
+                    }
+
+                    bool isAtEnd() const {
+                        struct stat statbuf{};
+                        return fstat(sourceFd, &statbuf) == 0 && statbuf.st_size <= offset;
+                    }
+            };
+        }
+
+        void copyFileContents(const fs::path& from, const fs::path& to) {
+            const FileDescriptor sourceFd(open(from.c_str(), O_RDONLY | O_CLOEXEC));
+
+            if (sourceFd.get() < 0)
+                throw fs::filesystem_error("cannot open source file", from, to, std::error_code(errno, std::generic_category()));
+
+            struct stat sourceStat{};
+            if (fstat(sourceFd.get(), &sourceStat) != 0)
+                throw fs::filesystem_error("cannot stat source file", from, to, std::error_code(errno, std::generic_category()));
+
+            if (!S_ISREG(sourceStat.st_mode))
+                throw fs::filesystem_error("not a regular file", from, to, std::make_error_code(std::errc::not_supported));
+
+            const auto mode = sourceStat.st_mode & 07777;
+
+            // opening the destination truncates it, which must not happen if it is the source file
+            struct stat existingDestinationStat{};
+            if (stat(to.c_str(), &existingDestinationStat) == 0 &&
+                existingDestinationStat.st_dev == sourceStat.st_dev && existingDestinationStat.st_ino == sourceStat.st_ino) {
+                throw fs::filesystem_error("source and destination are the same file", from, to, std::make_error_code(std::errc::file_exists));
+            }
+
+            const FileDescriptor destinationFd(open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode));
+
+            if (destinationFd.get() < 0)
+                throw fs::filesystem_error("cannot open destination file", from, to, std::error_code(errno, std::generic_category()));
+
+            struct stat destinationStat{};
+            if (fstat(destinationFd.get(), &destinationStat) != 0)
+                throw fs::filesystem_error("cannot stat destination file", from, to, std::error_code(errno, std::generic_category()));
+
+            const auto devices = std::make_pair(sourceStat.st_dev, destinationStat.st_dev);
+
+            auto method = CopyMethod::Clone;
+            bool methodKnown = false;
+
+            {
+                std::lock_guard<std::mutex> lock(knownCopyMethodsMutex);
+
+                const auto it = knownCopyMethods.find(devices);
+
+                if (it != knownCopyMethods.end()) {
+                    method = it->second;
+                    methodKnown = true;
+                }
+            }
+
+            FileCopier copier(from, to, sourceFd.get(), destinationFd.get());
+
+            // read/write always works, so the loop ends eventually
+            while (!copier.copy(method)) {
+                method = static_cast<CopyMethod>(static_cast<int>(method) + 1);
+            }
+
+            if (!methodKnown) {
+                std::lock_guard<std::mutex> lock(knownCopyMethodsMutex);
+
+                if (knownCopyMethods.emplace(devices, method).second) {
+                    ldLog() << LD_DEBUG << "Using" << getCopyMethodName(method) << "to copy files from device"
+                            << sourceStat.st_dev << "to device" << destinationStat.st_dev << std::endl;
+                }
+            }
+
+            // the mode passed to open() is only used if the file is created, and is subject to the umask
+            if (fchmod(destinationFd.get(), mode) != 0)
+                throw fs::filesystem_error("cannot set permissions", from, to, std::error_code(errno, std::generic_category()));
+        }
+    }
+}
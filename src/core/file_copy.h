@@ -0,0 +1,31 @@
+#pragma once
+
+// system headers
+#include <filesystem>
+
+namespace linuxdeploy {
+    namespace core {
+        /**
+         * Copy a regular file, replacing the destination if it exists. The destination gets the permissions of the
+         * source file, like with std::filesystem::copy_file.
+         *
+         * The contents are copied in the kernel whenever possible, avoiding the round trip through userspace
+         * buffers. The following primitives are tried, in this order:
+         *
+         *     - FICLONE, which shares the data blocks between both files (reflink, e.g., on btrfs and XFS)
+         *     - copy_file_range(2), which may use server side copies or clones as well
+         *     - sendfile(2)
+         *     - read(2) and write(2)
+         *
+         * The first primitive that works is remembered for the pair of filesystems involved, so that the others
+         * are not tried again for every file.
+         *
+         * This function may be called from several threads at once.
+         *
+         * @param from path to source file
+         * @param to path to destination file
+         * @throw std::filesystem::filesystem_error on errors
+         */
+        void copyFileContents(const std::filesystem::path& from, const std::filesystem::path& to);
+    }
+}
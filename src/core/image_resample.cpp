@@ -0,0 +1,138 @@
+// system headers
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// local headers
+#include "image_resample.h"
+
+namespace linuxdeploy {
+    namespace core {
+        namespace {
+            constexpr size_t CHANNELS = 4;
+
+            // source pixels covered by a target pixel along one axis, and the share of the area each of them covers
+            class Coverage {
+                public:
+                    size_t first = 0;
+                    std::vector<float> weights;
+            };
+
+            std::vector<Coverage> computeCoverages(uint32_t sourceSize, uint32_t targetSize) {
+                const double scale = static_cast<double>(sourceSize) / targetSize;
+
+                std::vector<Coverage> coverages(targetSize);
+
+                for (uint32_t i = 0; i < targetSize; ++i) {
+                    const double begin = i * scale;
+                    const double end = std::min((i + 1) * scale, static_cast<double>(sourceSize));
+
+                    auto& coverage = coverages[i];
+                    coverage.first = static_cast<size_t>(begin);
+
+                    const auto last = std::min(static_cast<size_t>(std::ceil(end)), static_cast<size_t>(sourceSize));
+
+                    for (size_t j = coverage.first; j < last; ++j) {
+                        const double covered = std::min(end, static_cast<double>(j + 1)) - std::max(begin, static_cast<double>(j));
+                        coverage.weights.push_back(static_cast<float>(covered / scale));
+                    }
+                }
+
+                return coverages;
+            }
+        }
+
+        RgbaImage downscaleImage(const RgbaImage& source, uint32_t width, uint32_t height) {
+            if (width == 0 || height == 0 || width > source.width || height > source.height)
+                throw std::invalid_argument("invalid target size");
+
+            if (source.pixels.size() != static_cast<size_t>(source.width) * source.height * CHANNELS)
+                throw std::invalid_argument("pixel data does not match image size");
+
+            const auto columnCoverages = computeCoverages(source.width, width);
+            const auto rowCoverages = computeCoverages(source.height, height);
+
+            const size_t sourceRowSize = static_cast<size_t>(source.width) * CHANNELS;
+            const size_t targetRowSize = static_cast<size_t>(width) * CHANNELS;
+
+            // first pass: scale every source row horizontally, using premultiplied colors
+            std::vector<float> scaledRows(static_cast<size_t>(source.height) * targetRowSize);
+            std::vector<float> premultipliedRow(sourceRowSize);
+
+            for (size_t y = 0; y < source.height; ++y) {
+                const uint8_t* in = source.pixels.data() + y * sourceRowSize;
+
+                for (size_t x = 0; x < sourceRowSize; x += CHANNELS) {
+                    const float alpha = in[x + 3];
+
+                    premultipliedRow[x + 0] = in[x + 0] * alpha;
+                    premultipliedRow[x + 1] = in[x + 1] * alpha;
+                    premultipliedRow[x + 2] = in[x + 2] * alpha;
+                    premultipliedRow[x + 3] = alpha;
+                }
+
+                float* out = scaledRows.data() + y * targetRowSize;
+
+                for (size_t x = 0; x < width; ++x) {
+                    const auto& coverage = columnCoverages[x];
+                    const float* pixel = premultipliedRow.data() + coverage.first * CHANNELS;
+
+                    float sum[CHANNELS] = {};
+
+                    for (const auto weight : coverage.weights) {
+                        for (size_t c = 0; c < CHANNELS; ++c) {
+                            sum[c] += pixel[c] * weight;
+                        }
+
+                        pixel += CHANNELS;
+                    }
+
+                    std::copy(sum, sum + CHANNELS, out + x * CHANNELS);
+                }
+            }
+
+            // second pass: combine the scaled rows vertically
+            // the inner loops run over whole rows, which allows the compiler to vectorize them
+            RgbaImage target;
+            target.width = width;
+            target.height = height;
+            target.pixels.resize(static_cast<size_t>(height) * targetRowSize);
+
+            std::vector<float> sumRow(targetRowSize);
+
+            for (size_t y = 0; y < height; ++y) {
+                const auto& coverage = rowCoverages[y];
+
+                std::fill(sumRow.begin(), sumRow.end(), 0.0f);
+
+                for (size_t i = 0; i < coverage.weights.size(); ++i) {
+                    const float* in = scaledRows.data() + (coverage.first + i) * targetRowSize;
+                    const float weight = coverage.weights[i];
+
+                    for (size_t x = 0; x < targetRowSize; ++x) {
+                        sumRow[x] += in[x] * weight;
+                    }
+                }
+
+                uint8_t* out = target.pixels.data() + y * targetRowSize;
+
+                for (size_t x = 0; x < targetRowSize; x += CHANNELS) {
+                    const float alpha = sumRow[x + 3];
+
+                    if (alpha < 0.5f) {
+                        std::fill(out + x, out + x + CHANNELS, 0);
+                        continue;
+                    }
+
+                    for (size_t c = 0; c < 3; ++c) {
+                        out[x + c] = static_cast<uint8_t>(std::min(sumRow[x + c] / alpha + 0.5f, 255.0f));
+                    }
+
+                    out[x + 3] = static_cast<uint8_t>(std::min(alpha + 0.5f, 255.0f));
+                }
+            }
+
+            return target;
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// system headers
+#include <cstdint>
+#include <vector>
+
+namespace linuxdeploy {
+    namespace core {
+        // 8-bit RGBA image, the channels of every pixel are stored next to each other, rows are stored top to bottom
+        class RgbaImage {
+            public:
+                uint32_t width = 0;
+                uint32_t height = 0;
+                std::vector<uint8_t> pixels;
+        };
+
+        /**
+         * Downscale an image using an area-averaging (box) filter.
+         *
+         * Every target pixel is the average of the source pixels it covers, weighted by the covered area, so the
+         * scale factor does not have to be an integer. The colors are premultiplied with their alpha value while
+         * averaging, so fully transparent pixels don't bleed into their neighbors.
+         *
+         * @param source image to downscale
+         * @param width target width, must not be larger than the source width
+         * @param height target height, must not be larger than the source height
+         * @return downscaled image
+         * @throws std::invalid_argument if the target size is empty or larger than the source size
+         */
+        RgbaImage downscaleImage(const RgbaImage& source, uint32_t width, uint32_t height);
+    }
+}
@@ -0,0 +1,154 @@
+// system headers
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// local headers
+#include "image_size.h"
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace {
+            uint32_t readBigEndian(const unsigned char* data, size_t size) {
+                uint32_t rv = 0;
+
+                for (size_t i = 0; i < size; ++i) {
+                    rv = (rv << 8) | data[i];
+                }
+
+                return rv;
+            }
+
+            template<size_t N>
+            bool readBytes(std::istream& is, std::array<unsigned char, N>& buffer) {
+                return static_cast<bool>(is.read(reinterpret_cast<char*>(buffer.data()), buffer.size()));
+            }
+
+            std::optional<ImageSize> readPngSize(std::istream& is) {
+                // the signature is followed by the IHDR chunk, which must come first, and begins with the dimensions
+                // layout: signature (8 bytes), chunk length (4 bytes), chunk type (4 bytes), width, height
+                std::array<unsigned char, 24> header{};
+
+                if (!readBytes(is, header))
+                    return std::nullopt;
+
+                if (memcmp(header.data() + 12, "IHDR", 4) != 0)
+                    return std::nullopt;
+
+                return ImageSize{readBigEndian(header.data() + 16, 4), readBigEndian(header.data() + 20, 4)};
+            }
+
+            std::optional<ImageSize> readJpegSize(std::istream& is) {
+                // skip the start of image marker, which has been checked already
+                is.seekg(2);
+
+                // the segments preceding the frame header are skipped using their lengths, so at most a few bytes of
+                // each one are read
+                for (;;) {
+                    if (is.get() != 0xFF)
+                        return std::nullopt;
+
+                    // markers may be preceded by any number of fill bytes
+                    int marker;
+                    do {
+                        marker = is.get();
+                    } while (marker == 0xFF);
+
+                    if (marker == std::char_traits<char>::eof())
+                        return std::nullopt;
+
+                    // markers without a segment
+                    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+                        continue;
+
+                    // the frame header must precede the end of image and the start of scan markers
+                    if (marker == 0xD9 || marker == 0xDA)
+                        return std::nullopt;
+
+                    std::array<unsigned char, 2> lengthBytes{};
+
+                    if (!readBytes(is, lengthBytes))
+                        return std::nullopt;
+
+                    // the length includes the length field itself
+                    const auto length = readBigEndian(lengthBytes.data(), lengthBytes.size());
+
+                    if (length < 2)
+                        return std::nullopt;
+
+                    // SOF0 to SOF15 markers, except for DHT, JPG and DAC, which share the range
+                    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+                        // layout: sample precision (1 byte), height (2 bytes), width (2 bytes)
+                        std::array<unsigned char, 5> frameHeader{};
+
+                        if (!readBytes(is, frameHeader))
+                            return std::nullopt;
+
+                        return ImageSize{readBigEndian(frameHeader.data() + 3, 2), readBigEndian(frameHeader.data() + 1, 2)};
+                    }
+
+                    if (!is.seekg(length - 2, std::ios::cur))
+                        return std::nullopt;
+                }
+            }
+
+            std::optional<ImageSize> readXpmSize(std::istream& is) {
+                // the first string in the array contains the values "<width> <height> <colors> <chars per pixel>"
+                // only the declaration and maybe a few comments precede it
+                std::string header(4096, '\0');
+                is.read(&header[0], static_cast<std::streamsize>(header.size()));
+                header.resize(static_cast<size_t>(is.gcount()));
+
+                const auto arrayBegin = header.find('{');
+
+                if (arrayBegin == std::string::npos)
+                    return std::nullopt;
+
+                const auto valuesBegin = header.find('"', arrayBegin);
+
+                if (valuesBegin == std::string::npos)
+                    return std::nullopt;
+
+                std::istringstream values(header.substr(valuesBegin + 1));
+
+                long width = 0, height = 0;
+
+                if (!(values >> width >> height) || width <= 0 || height <= 0)
+                    return std::nullopt;
+
+                return ImageSize{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+            }
+        }
+
+        std::optional<ImageSize> readImageSizeFromHeader(const fs::path& path) {
+            std::ifstream ifs(path, std::ios::binary);
+
+            if (!ifs)
+                return std::nullopt;
+
+            std::array<unsigned char, 9> magic{};
+
+            if (!readBytes(ifs, magic))
+                return std::nullopt;
+
+            ifs.seekg(0);
+
+            static const unsigned char pngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+            if (memcmp(magic.data(), pngSignature, sizeof(pngSignature)) == 0)
+                return readPngSize(ifs);
+
+            if (magic[0] == 0xFF && magic[1] == 0xD8)
+                return readJpegSize(ifs);
+
+            if (memcmp(magic.data(), "/* XPM */", magic.size()) == 0)
+                return readXpmSize(ifs);
+
+            return std::nullopt;
+        }
+    }
+}
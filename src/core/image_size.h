@@ -0,0 +1,28 @@
+#pragma once
+
+// system headers
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace linuxdeploy {
+    namespace core {
+        // dimensions of an image in pixels
+        class ImageSize {
+            public:
+                uint32_t width = 0;
+                uint32_t height = 0;
+        };
+
+        /**
+         * Read the dimensions of an image from its header, without decoding the image.
+         *
+         * Supports PNG (IHDR chunk), JPEG (SOFn marker) and XPM (values line) files. Only the first few bytes of the
+         * file are read, except for JPEG files, whose segments preceding the frame header are skipped.
+         *
+         * @param path path to image file
+         * @return dimensions, or nothing if the format is not supported or the header could not be parsed
+         */
+        std::optional<ImageSize> readImageSizeFromHeader(const std::filesystem::path& path);
+    }
+}
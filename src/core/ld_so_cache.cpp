@@ -0,0 +1,296 @@
+// system headers
+#include <cstring>
+#include <elf.h>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "ld_so_cache.h"
+
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            namespace {
+                // the data structures are defined in glibc's sysdeps/generic/dl-cache.h
+                constexpr char oldCacheMagic[] = "ld.so-1.7.0";
+                constexpr char newCacheMagic[] = "glibc-ld.so.cache";
+                constexpr char newCacheVersion[] = "1.1";
+
+                struct OldFileEntry {
+                    int32_t flags;
+                    uint32_t key;
+                    uint32_t value;
+                };
+
+                struct OldCacheHeader {
+                    char magic[sizeof(oldCacheMagic) - 1];
+                    uint32_t nlibs;
+                };
+
+                struct NewFileEntry {
+                    int32_t flags;
+                    uint32_t key;
+                    uint32_t value;
+                    uint32_t osversion;
+                    uint64_t hwcap;
+                };
+
+                struct NewCacheHeader {
+                    char magic[sizeof(newCacheMagic) - 1];
+                    char version[sizeof(newCacheVersion) - 1];
+                    uint32_t nlibs;
+                    uint32_t lenStrings;
+                    uint8_t flags;
+                    uint8_t padding[3];
+                    uint32_t extensionOffset;
+                    uint32_t unused[3];
+                };
+
+                // the lower byte of an entry's flags describes the library type
+                constexpr int32_t flagTypeMask = 0x00ff;
+                constexpr int32_t flagElf = 0x0001;
+                constexpr int32_t flagElfLibc6 = 0x0003;
+
+                // the upper bits describe the ABI the library is built for, unless it is the architecture's default
+                constexpr int32_t flagRequiredMask = 0xff00;
+
+                // returns whether the ABI flags of a cache entry are compatible with the given ELF class and machine
+                bool isCompatible(int32_t flags, uint8_t elfClass, uint16_t elfMachine) {
+                    const auto type = flags & flagTypeMask;
+
+                    if (type != flagElf && type != flagElfLibc6)
+                        return false;
+
+                    const auto required = flags & flagRequiredMask;
+
+                    switch (elfMachine) {
+                        case EM_386:
+                            return required == 0;
+                        case EM_X86_64:
+                            // x32 uses the 32-bit ELF class
+                            return required == (elfClass == ELFCLASS64 ? 0x0300 : 0x0800);
+                        case EM_AARCH64:
+                            return required == 0x0a00;
+                        case EM_ARM:
+                            // soft float and hard float libraries cannot be told apart by their headers easily, so we
+                            // accept both, the ELF check done by the caller will have to do
+                            return required == 0 || required == 0x0900 || required == 0x0b00;
+                        case EM_PPC64:
+                            return required == 0x0500;
+                        case EM_S390:
+                            return required == (elfClass == ELFCLASS64 ? 0x0400 : 0);
+                        default:
+                            // unknown machine, let the caller check the files
+                            return true;
+                    }
+                }
+
+                // returns the string at the given offset, or an empty view if the offset is invalid
+                std::string_view readString(const char* begin, size_t size, uint64_t offset) {
+                    if (offset >= size)
+                        return {};
+
+                    const auto* string = begin + offset;
+                    const auto* end = static_cast<const char*>(memchr(string, '\0', size - offset));
+
+                    if (end == nullptr)
+                        return {};
+
+                    return {string, static_cast<size_t>(end - string)};
+                }
+            }
+
+            class LdSoCache::PrivateData {
+                public:
+                    class Entry {
+                        public:
+                            std::string_view path;
+                            int32_t flags;
+                            uint64_t hwcap;
+                    };
+
+                public:
+                    const char* data = nullptr;
+                    size_t size = 0;
+
+                    // the views point into the mapped file, which stays mapped as long as this object exists
+                    // entries are stored in the order of the cache file, which is the order of preference
+                    std::unordered_map<std::string_view, std::vector<Entry>> index;
+                    size_t entriesCount = 0;
+
+                public:
+                    explicit PrivateData(const fs::path& path) {
+                        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+                        if (fd < 0) {
+                            ldLog() << LD_DEBUG << "Could not open dynamic linker cache" << path << std::endl;
+                            return;
+                        }
+
+                        struct stat statbuf{};
+                        if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0) {
+                            auto* mapping = mmap(nullptr, static_cast<size_t>(statbuf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+                            if (mapping != MAP_FAILED) {
+                                data = static_cast<const char*>(mapping);
+                                size = static_cast<size_t>(statbuf.st_size);
+                            }
+                        }
+
+                        close(fd);
+
+                        if (data == nullptr)
+                            return;
+
+                        if (!parse()) {
+                            ldLog() << LD_WARNING << "Could not parse dynamic linker cache" << path << std::endl;
+                            index.clear();
+                            entriesCount = 0;
+                        }
+                    }
+
+                    ~PrivateData() {
+                        if (data != nullptr)
+                            munmap(const_cast<char*>(data), size);
+                    }
+
+                    PrivateData(const PrivateData&) = delete;
+                    PrivateData& operator=(const PrivateData&) = delete;
+
+                private:
+                    void addEntry(std::string_view key, std::string_view value, int32_t flags, uint64_t hwcap) {
+                        if (key.empty() || value.empty())
+                            return;
+
+                        index[key].emplace_back(Entry{value, flags, hwcap});
+                        ++entriesCount;
+                    }
+
+                    bool parseNewFormat(size_t offset) {
+                        if (offset + sizeof(NewCacheHeader) > size)
+                            return false;
+
+                        NewCacheHeader header{};
+                        memcpy(&header, data + offset, sizeof(header));
+
+                        if (memcmp(header.magic, newCacheMagic, sizeof(header.magic)) != 0 ||
+                            memcmp(header.version, newCacheVersion, sizeof(header.version)) != 0) {
+                            return false;
+                        }
+
+                        const auto entriesOffset = offset + sizeof(NewCacheHeader);
+
+                        if (header.nlibs > (size - entriesOffset) / sizeof(NewFileEntry))
+                            return false;
+
+                        // in the new format, string offsets are relative to the new format's header
+                        const auto* strings = data + offset;
+                        const auto stringsSize = size - offset;
+
+                        for (uint32_t i = 0; i < header.nlibs; ++i) {
+                            NewFileEntry entry{};
+                            memcpy(&entry, data + entriesOffset + i * sizeof(NewFileEntry), sizeof(entry));
+
+                            addEntry(
+                                readString(strings, stringsSize, entry.key),
+                                readString(strings, stringsSize, entry.value),
+                                entry.flags,
+                                entry.hwcap
+                            );
+                        }
+
+                        return true;
+                    }
+
+                    bool parseOldFormat() {
+                        OldCacheHeader header{};
+                        memcpy(&header, data, sizeof(header));
+
+                        const auto entriesOffset = sizeof(OldCacheHeader);
+
+                        if (header.nlibs > (size - entriesOffset) / sizeof(OldFileEntry))
+                            return false;
+
+                        const auto entriesEnd = entriesOffset + header.nlibs * sizeof(OldFileEntry);
+
+                        // combined format: the new format follows the old one, aligned to the new header's alignment
+                        // the new format contains more information, so we prefer it
+                        for (const size_t alignment : {alignof(uint64_t), size_t(4)}) {
+                            const auto newFormatOffset = (entriesEnd + alignment - 1) & ~(alignment - 1);
+
+                            if (parseNewFormat(newFormatOffset))
+                                return true;
+                        }
+
+                        // in the old format, string offsets are relative to the end of the entries
+                        const auto* strings = data + entriesEnd;
+                        const auto stringsSize = size - entriesEnd;
+
+                        for (uint32_t i = 0; i < header.nlibs; ++i) {
+                            OldFileEntry entry{};
+                            memcpy(&entry, data + entriesOffset + i * sizeof(OldFileEntry), sizeof(entry));
+
+                            addEntry(
+                                readString(strings, stringsSize, entry.key),
+                                readString(strings, stringsSize, entry.value),
+                                entry.flags,
+                                0
+                            );
+                        }
+
+                        return true;
+                    }
+
+                    bool parse() {
+                        if (size >= sizeof(OldCacheHeader) && memcmp(data, oldCacheMagic, sizeof(OldCacheHeader::magic)) == 0)
+                            return parseOldFormat();
+
+                        return parseNewFormat(0);
+                    }
+            };
+
+            LdSoCache::LdSoCache(const fs::path& path) : d(std::make_shared<PrivateData>(path)) {}
+
+            bool LdSoCache::isValid() const {
+                return d->entriesCount > 0;
+            }
+
+            size_t LdSoCache::size() const {
+                return d->entriesCount;
+            }
+
+            std::vector<fs::path> LdSoCache::lookup(const std::string& libraryName, uint8_t elfClass, uint16_t elfMachine) const {
+                std::vector<fs::path> rv;
+
+                const auto it = d->index.find(libraryName);
+
+                if (it == d->index.end())
+                    return rv;
+
+                // libraries optimized for specific hardware are only used if there is no baseline one
+                for (const bool wantHwcap : {false, true}) {
+                    for (const auto& entry : it->second) {
+                        if ((entry.hwcap != 0) != wantHwcap)
+                            continue;
+
+                        if (!isCompatible(entry.flags, elfClass, elfMachine))
+                            continue;
+
+                        rv.emplace_back(entry.path);
+                    }
+                }
+
+                return rv;
+            }
+        }
+    }
+}
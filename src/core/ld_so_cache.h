@@ -0,0 +1,60 @@
+#pragma once
+
+// system headers
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace linuxdeploy {
+    namespace core {
+        namespace elf_file {
+            /**
+             * Read-only view of the dynamic linker's cache (/etc/ld.so.cache), as generated by ldconfig.
+             *
+             * The file is mapped into memory once, and an index by library name is built, so lookups are cheap hash
+             * table probes rather than directory scans. Both the old (libc5 compatible) format and the new format
+             * used by glibc are supported, as well as the combined format in which the new format follows the old one.
+             *
+             * If the cache cannot be read or is corrupt, the instance is empty and all lookups fail, in which case
+             * callers should fall back to searching the library directories.
+             */
+            class LdSoCache {
+                private:
+                    // private data class pattern
+                    class PrivateData;
+                    std::shared_ptr<PrivateData> d;
+
+                public:
+                    explicit LdSoCache(const std::filesystem::path& path = "/etc/ld.so.cache");
+
+                    /**
+                     * @return true if the cache could be read and contains at least one entry, false otherwise
+                     */
+                    bool isValid() const;
+
+                    /**
+                     * @return number of entries in the cache
+                     */
+                    size_t size() const;
+
+                    /**
+                     * Look up the paths of a library in the cache.
+                     * Entries which are not meant for the given ELF class and machine are skipped. Entries which
+                     * depend on hardware capabilities (e.g., in glibc-hwcaps subdirectories) are returned after the
+                     * baseline ones, since the resulting AppDir should run on any CPU.
+                     *
+                     * Callers still need to check the ELF class and machine of the returned files, as not all machines
+                     * are marked explicitly in the cache.
+                     *
+                     * @param libraryName name of the library, e.g., libc.so.6
+                     * @param elfClass ELF class of the file that requests the library
+                     * @param elfMachine ELF machine of the file that requests the library
+                     * @return paths of the matching libraries in order of preference, empty if not in the cache
+                     */
+                    std::vector<std::filesystem::path> lookup(const std::string& libraryName, uint8_t elfClass, uint16_t elfMachine) const;
+            };
+        }
+    }
+}
@@ -0,0 +1,104 @@
+// compares the cost of looking up the dependencies of an ELF file in the dynamic linker cache with scanning the system
+// library directories and with calling ldd
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+#include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/subprocess/subprocess.h"
+#include "ld_so_cache.h"
+
+using namespace linuxdeploy::core::elf_file;
+using namespace linuxdeploy::subprocess;
+
+namespace fs = std::filesystem;
+
+namespace {
+    template<typename F>
+    void benchmark(const std::string& name, size_t iterations, size_t lookupsPerIteration, F&& function) {
+        const auto begin = std::chrono::steady_clock::now();
+
+        size_t found = 0;
+        for (size_t i = 0; i < iterations; ++i) {
+            found += function();
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const auto totalNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+
+        std::cout << name << ": " << (totalNs / static_cast<double>(iterations * lookupsPerIteration)) << " ns per lookup "
+                  << "(" << found / iterations << "/" << lookupsPerIteration << " found)" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <ELF file> [iterations]" << std::endl;
+        return 1;
+    }
+
+    const fs::path path = argv[1];
+    const size_t iterations = argc >= 3 ? std::stoul(argv[2]) : 1000;
+
+    ElfFile elfFile(path);
+    const auto elfClass = elfFile.getElfClass();
+    const auto elfMachine = elfFile.getElfMachine();
+
+    // collect the names of all libraries in the dependency closure
+    std::vector<std::string> libraryNames;
+    for (const auto& dependency : elfFile.traceDynamicDependencies()) {
+        libraryNames.emplace_back(dependency.filename().string());
+    }
+
+    std::cout << "Looking up " << libraryNames.size() << " libraries, " << iterations << " iterations" << std::endl;
+
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        LdSoCache cache;
+        const auto end = std::chrono::steady_clock::now();
+
+        std::cout << "loading cache: " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count()
+                  << " us, " << cache.size() << " entries" << std::endl;
+
+        benchmark("ld.so.cache", iterations, libraryNames.size(), [&]() {
+            size_t found = 0;
+            for (const auto& libraryName : libraryNames) {
+                found += !cache.lookup(libraryName, elfClass, elfMachine).empty();
+            }
+            return found;
+        });
+    }
+
+    benchmark("directory scan", iterations, libraryNames.size(), [&]() {
+        static const std::vector<fs::path> directories = {
+            "/lib/x86_64-linux-gnu", "/usr/lib/x86_64-linux-gnu", "/lib64", "/usr/lib64", "/lib", "/usr/lib",
+        };
+
+        size_t found = 0;
+        for (const auto& libraryName : libraryNames) {
+            for (const auto& directory : directories) {
+                std::error_code ec;
+                if (fs::is_regular_file(directory / libraryName, ec)) {
+                    ++found;
+                    break;
+                }
+            }
+        }
+        return found;
+    });
+
+    // a single ldd call resolves all libraries at once, and is a lot slower, so we run fewer iterations
+    benchmark("ldd", std::max<size_t>(iterations / 100, 1), libraryNames.size(), [&]() {
+        subprocess lddProc({"ldd", path.string()});
+        const auto result = lddProc.run();
+
+        size_t found = 0;
+        for (const auto& libraryName : libraryNames) {
+            found += result.stdout_string().find(libraryName + " => /") != std::string::npos;
+        }
+        return found;
+    });
+
+    return 0;
+}
@@ -0,0 +1,420 @@
+// system headers
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "metadata_cache.h"
+
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace core {
+        namespace {
+            // the file is written in the machine's native byte order, as it is never shared between machines
+            // the version must be increased whenever the format changes, files with other versions are ignored
+            constexpr char cacheMagic[8] = {'L', 'D', 'M', 'E', 'T', 'A', '\0', '\0'};
+            constexpr uint32_t cacheVersion = 1;
+
+            struct FileHeader {
+                char magic[sizeof(cacheMagic)];
+                uint32_t version;
+                uint32_t entriesCount;
+                uint64_t dataSize;
+            };
+
+            // entries are sorted by key, which allows for binary searches without parsing the file
+            // offsets are relative to the beginning of the data area, which follows the entries
+            // values are stored as a sequence of strings, each preceded by its length
+            struct FileEntry {
+                uint64_t device;
+                uint64_t inode;
+                int64_t mtime;
+                uint64_t size;
+                uint32_t keyOffset;
+                uint32_t keyLength;
+                uint32_t valueOffset;
+                uint32_t valueLength;
+            };
+
+            // the attributes which tell whether a file has changed since an entry was stored
+            struct FileIdentity {
+                uint64_t device = 0;
+                uint64_t inode = 0;
+                int64_t mtime = 0;
+                uint64_t size = 0;
+
+                bool operator==(const FileIdentity& other) const {
+                    return device == other.device && inode == other.inode && mtime == other.mtime && size == other.size;
+                }
+            };
+
+            std::optional<FileIdentity> getFileIdentity(const std::string& path) {
+                struct stat statbuf{};
+
+                if (stat(path.c_str(), &statbuf) != 0)
+                    return std::nullopt;
+
+                FileIdentity identity;
+                identity.device = statbuf.st_dev;
+                identity.inode = statbuf.st_ino;
+                identity.mtime = static_cast<int64_t>(statbuf.st_mtim.tv_sec) * 1000000000 + statbuf.st_mtim.tv_nsec;
+                identity.size = static_cast<uint64_t>(statbuf.st_size);
+                return identity;
+            }
+
+            // kind and path are separated by a character which cannot occur in paths
+            std::string makeKey(const std::string& kind, const fs::path& path) {
+                return kind + '\0' + path.string();
+            }
+
+            std::string getPathFromKey(std::string_view key) {
+                return std::string(key.substr(key.find('\0') + 1));
+            }
+
+            std::string encodeValue(const std::vector<std::string>& value) {
+                std::string rv;
+
+                for (const auto& item : value) {
+                    const auto length = static_cast<uint32_t>(item.size());
+                    rv.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                    rv.append(item);
+                }
+
+                return rv;
+            }
+
+            std::optional<std::vector<std::string>> decodeValue(std::string_view data) {
+                std::vector<std::string> rv;
+
+                while (!data.empty()) {
+                    uint32_t length;
+
+                    if (data.size() < sizeof(length))
+                        return std::nullopt;
+
+                    memcpy(&length, data.data(), sizeof(length));
+                    data.remove_prefix(sizeof(length));
+
+                    if (data.size() < length)
+                        return std::nullopt;
+
+                    rv.emplace_back(data.substr(0, length));
+                    data.remove_prefix(length);
+                }
+
+                return rv;
+            }
+        }
+
+        class MetadataCache::PrivateData {
+            public:
+                class Record {
+                    public:
+                        FileIdentity identity;
+                        std::vector<std::string> value;
+                };
+
+            public:
+                const fs::path cacheFilePath;
+
+                // the mapped cache file, stays mapped as long as this object exists
+                const char* mapping = nullptr;
+                size_t mappingSize = 0;
+
+                // views into the mapping
+                const FileEntry* entries = nullptr;
+                size_t entriesCount = 0;
+                std::string_view data;
+
+                // entries added since the file was loaded, these take precedence over the ones in the file
+                std::map<std::string, Record> addedRecords;
+                mutable std::mutex addedRecordsMutex;
+
+                // set when entries are added, cleared when the cache is saved
+                bool dirty = false;
+
+            public:
+                explicit PrivateData(fs::path cacheFilePath) : cacheFilePath(std::move(cacheFilePath)) {
+                    const int fd = open(this->cacheFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+
+                    // a missing file is the normal case on the first run
+                    if (fd < 0)
+                        return;
+
+                    struct stat statbuf{};
+                    if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0) {
+                        auto* rv = mmap(nullptr, static_cast<size_t>(statbuf.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+                        if (rv != MAP_FAILED) {
+                            mapping = static_cast<const char*>(rv);
+                            mappingSize = static_cast<size_t>(statbuf.st_size);
+                        }
+                    }
+
+                    close(fd);
+
+                    if (mapping != nullptr && !parse()) {
+                        ldLog() << LD_WARNING << "Ignoring invalid metadata cache file" << this->cacheFilePath << std::endl;
+                        entries = nullptr;
+                        entriesCount = 0;
+                        data = {};
+                    }
+                }
+
+                ~PrivateData() {
+                    if (mapping != nullptr)
+                        munmap(const_cast<char*>(mapping), mappingSize);
+                }
+
+                PrivateData(const PrivateData&) = delete;
+                PrivateData& operator=(const PrivateData&) = delete;
+
+            private:
+                bool parse() {
+                    FileHeader header{};
+
+                    if (mappingSize < sizeof(header))
+                        return false;
+
+                    memcpy(&header, mapping, sizeof(header));
+
+                    if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion)
+                        return false;
+
+                    const auto entriesSize = static_cast<uint64_t>(header.entriesCount) * sizeof(FileEntry);
+
+                    if (sizeof(header) + entriesSize + header.dataSize != mappingSize)
+                        return false;
+
+                    // mmap returns page aligned memory, and the header size is a multiple of the entries' alignment
+                    entries = reinterpret_cast<const FileEntry*>(mapping + sizeof(header));
+                    entriesCount = header.entriesCount;
+                    data = std::string_view(mapping + sizeof(header) + entriesSize, header.dataSize);
+
+                    for (size_t i = 0; i < entriesCount; ++i) {
+                        const auto& entry = entries[i];
+
+                        if (static_cast<uint64_t>(entry.keyOffset) + entry.keyLength > data.size() ||
+                            static_cast<uint64_t>(entry.valueOffset) + entry.valueLength > data.size()) {
+                            return false;
+                        }
+                    }
+
+                    return true;
+                }
+
+            public:
+                std::string_view getKey(const FileEntry& entry) const {
+                    return data.substr(entry.keyOffset, entry.keyLength);
+                }
+
+                std::string_view getValue(const FileEntry& entry) const {
+                    return data.substr(entry.valueOffset, entry.valueLength);
+                }
+
+                static FileIdentity getIdentity(const FileEntry& entry) {
+                    FileIdentity identity;
+                    identity.device = entry.device;
+                    identity.inode = entry.inode;
+                    identity.mtime = entry.mtime;
+                    identity.size = entry.size;
+                    return identity;
+                }
+
+                const FileEntry* findEntry(std::string_view key) const {
+                    const auto* end = entries + entriesCount;
+
+                    const auto* it = std::lower_bound(entries, end, key, [this](const FileEntry& entry, std::string_view key) {
+                        return getKey(entry) < key;
+                    });
+
+                    if (it == end || getKey(*it) != key)
+                        return nullptr;
+
+                    return it;
+                }
+
+                bool write(const std::map<std::string, Record>& records) const {
+                    std::error_code ec;
+                    fs::create_directories(cacheFilePath.parent_path(), ec);
+
+                    std::vector<FileEntry> fileEntries;
+                    fileEntries.reserve(records.size());
+
+                    std::string fileData;
+
+                    for (const auto& [key, record] : records) {
+                        FileEntry entry{};
+                        entry.device = record.identity.device;
+                        entry.inode = record.identity.inode;
+                        entry.mtime = record.identity.mtime;
+                        entry.size = record.identity.size;
+
+                        entry.keyOffset = static_cast<uint32_t>(fileData.size());
+                        entry.keyLength = static_cast<uint32_t>(key.size());
+                        fileData.append(key);
+
+                        const auto encodedValue = encodeValue(record.value);
+                        entry.valueOffset = static_cast<uint32_t>(fileData.size());
+                        entry.valueLength = static_cast<uint32_t>(encodedValue.size());
+                        fileData.append(encodedValue);
+
+                        fileEntries.emplace_back(entry);
+                    }
+
+                    FileHeader header{};
+                    memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+                    header.version = cacheVersion;
+                    header.entriesCount = static_cast<uint32_t>(fileEntries.size());
+                    header.dataSize = fileData.size();
+
+                    // the file is written next to the final one and renamed afterwards, so that concurrent runs
+                    // always see a complete file
+                    auto tempFilePath = cacheFilePath.string() + ".XXXXXX";
+                    const int fd = mkstemp(tempFilePath.data());
+
+                    if (fd < 0)
+                        return false;
+
+                    auto writeAll = [fd](const void* buffer, size_t size) {
+                        const auto* position = static_cast<const char*>(buffer);
+
+                        while (size > 0) {
+                            const auto rv = ::write(fd, position, size);
+
+                            if (rv < 0) {
+                                if (errno == EINTR)
+                                    continue;
+                                return false;
+                            }
+
+                            position += rv;
+                            size -= static_cast<size_t>(rv);
+                        }
+
+                        return true;
+                    };
+
+                    const bool success = writeAll(&header, sizeof(header)) &&
+                        writeAll(fileEntries.data(), fileEntries.size() * sizeof(FileEntry)) &&
+                        writeAll(fileData.data(), fileData.size());
+
+                    if (close(fd) != 0 || !success || rename(tempFilePath.c_str(), cacheFilePath.c_str()) != 0) {
+                        unlink(tempFilePath.c_str());
+                        return false;
+                    }
+
+                    return true;
+                }
+        };
+
+        MetadataCache::MetadataCache(const fs::path& cacheFilePath) : d(std::make_shared<PrivateData>(cacheFilePath)) {}
+
+        std::shared_ptr<MetadataCache> MetadataCache::fromEnvironment() {
+            static const auto instance = []() -> std::shared_ptr<MetadataCache> {
+                const auto* cacheDir = getenv("LINUXDEPLOY_CACHE_DIR");
+
+                if (cacheDir == nullptr || cacheDir[0] == '\0')
+                    return nullptr;
+
+                const auto cacheFilePath = fs::path(cacheDir) / "metadata.cache";
+                ldLog() << LD_DEBUG << "Using metadata cache" << cacheFilePath << std::endl;
+
+                return std::make_shared<MetadataCache>(cacheFilePath);
+            }();
+
+            return instance;
+        }
+
+        std::optional<std::vector<std::string>> MetadataCache::get(const std::string& kind, const fs::path& path) const {
+            const auto identity = getFileIdentity(path.string());
+
+            if (!identity.has_value())
+                return std::nullopt;
+
+            const auto key = makeKey(kind, path);
+
+            {
+                std::lock_guard<std::mutex> lock(d->addedRecordsMutex);
+
+                const auto it = d->addedRecords.find(key);
+
+                if (it != d->addedRecords.end()) {
+                    if (!(it->second.identity == *identity))
+                        return std::nullopt;
+
+                    return it->second.value;
+                }
+            }
+
+            // the mapped data is never modified, so no lock is needed to read it
+            const auto* entry = d->findEntry(key);
+
+            if (entry == nullptr || !(PrivateData::getIdentity(*entry) == *identity))
+                return std::nullopt;
+
+            return decodeValue(d->getValue(*entry));
+        }
+
+        void MetadataCache::put(const std::string& kind, const fs::path& path, std::vector<std::string> value) {
+            const auto identity = getFileIdentity(path.string());
+
+            if (!identity.has_value())
+                return;
+
+            std::lock_guard<std::mutex> lock(d->addedRecordsMutex);
+            d->addedRecords[makeKey(kind, path)] = PrivateData::Record{*identity, std::move(value)};
+            d->dirty = true;
+        }
+
+        bool MetadataCache::save() {
+            std::lock_guard<std::mutex> lock(d->addedRecordsMutex);
+
+            // nothing has changed, so the file is up to date
+            if (!d->dirty)
+                return true;
+
+            auto records = d->addedRecords;
+
+            // keep the entries from the file which are still valid
+            for (size_t i = 0; i < d->entriesCount; ++i) {
+                const auto& entry = d->entries[i];
+                const std::string key(d->getKey(entry));
+
+                if (records.find(key) != records.end())
+                    continue;
+
+                const auto identity = PrivateData::getIdentity(entry);
+                const auto currentIdentity = getFileIdentity(getPathFromKey(key));
+
+                if (!currentIdentity.has_value() || !(*currentIdentity == identity))
+                    continue;
+
+                auto value = decodeValue(d->getValue(entry));
+
+                if (value.has_value())
+                    records.emplace(key, PrivateData::Record{identity, std::move(*value)});
+            }
+
+            if (!d->write(records)) {
+                ldLog() << LD_WARNING << "Failed to write metadata cache" << d->cacheFilePath << std::endl;
+                return false;
+            }
+
+            ldLog() << LD_DEBUG << "Wrote" << records.size() << "entries to metadata cache" << d->cacheFilePath << std::endl;
+
+            d->dirty = false;
+            return true;
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// system headers
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace linuxdeploy {
+    namespace core {
+        /**
+         * Persistent cache for metadata computed from files, e.g., the parsed dynamic section of a library or the
+         * copyright files found for it.
+         *
+         * Values are lists of strings, stored per kind of metadata and path. An entry is only valid as long as the
+         * identity of the file at the path (device, inode, modification time and size) does not change.
+         *
+         * The cache file is memory-mapped, and entries are looked up with a binary search in the mapped data, so
+         * opening the cache is cheap regardless of its size. New entries are kept in memory until save() is called.
+         * Instances may be used from several threads at once.
+         */
+        class MetadataCache {
+            private:
+                // private data class pattern
+                class PrivateData;
+                std::shared_ptr<PrivateData> d;
+
+            public:
+                /**
+                 * Open the cache stored in the given file. A missing or invalid file results in an empty cache.
+                 *
+                 * @param cacheFilePath path to cache file
+                 */
+                explicit MetadataCache(const std::filesystem::path& cacheFilePath);
+
+                /**
+                 * Return the cache in $LINUXDEPLOY_CACHE_DIR, or nullptr if the variable is not set.
+                 * All callers share the same instance.
+                 */
+                static std::shared_ptr<MetadataCache> fromEnvironment();
+
+                /**
+                 * Look up the value stored for a file.
+                 *
+                 * @param kind kind of metadata
+                 * @param path path to file
+                 * @return stored value, or nothing if there is no entry or the file has changed since it was stored
+                 */
+                std::optional<std::vector<std::string>> get(const std::string& kind, const std::filesystem::path& path) const;
+
+                /**
+                 * Store a value for a file. The current identity of the file is stored along with it.
+                 * Does nothing if the file does not exist.
+                 *
+                 * @param kind kind of metadata
+                 * @param path path to file
+                 * @param value value to store
+                 */
+                void put(const std::string& kind, const std::filesystem::path& path, std::vector<std::string> value);
+
+                /**
+                 * Write the cache to its file if entries have been added. The file is replaced atomically, so
+                 * concurrent runs never see a partially written file.
+                 * Entries whose files have changed or vanished are dropped.
+                 *
+                 * @return true on success, false otherwise
+                 */
+                bool save();
+        };
+    }
+}
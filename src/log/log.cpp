@@ -1,6 +1,26 @@
+// system includes
+#include <mutex>
+#include <sstream>
+
 // local includes
 #include "linuxdeploy/log/log.h"
 
+namespace {
+    // messages may be logged from several threads at once
+    // to keep lines from different threads from being interleaved, every thread collects its output in a buffer until the
+    // end of a line, which is then written as a whole
+    // statements which don't end their line are written once they are complete, i.e., when the ldLog temporaries are
+    // destroyed, so nothing remains in the buffer when the thread exits
+    std::mutex outputMutex;
+    thread_local std::string pendingOutput;
+
+    void flushPendingOutput(std::ostream& stream) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        stream << pendingOutput << std::flush;
+        pendingOutput.clear();
+    }
+}
+
 namespace linuxdeploy::log {
     LD_LOGLEVEL ldLog::verbosity = LD_INFO;
 
@@ -14,6 +34,16 @@ namespace linuxdeploy::log {
         logLevelSet = false;
     };
 
+    ldLog::~ldLog() {
+        if (pendingOutput.empty())
+            return;
+
+        // destructors must not throw
+        try {
+            flushPendingOutput(stream);
+        } catch (...) {}
+    }
+
     ldLog::ldLog(bool prependSpace, bool logLevelSet, LD_LOGLEVEL logLevel) {
         this->prependSpace = prependSpace;
         this->currentLogLevel = logLevel;
@@ -22,7 +52,7 @@ namespace linuxdeploy::log {
 
     void ldLog::checkPrependSpace() {
         if (prependSpace) {
-            stream << " ";
+            pendingOutput += ' ';
             prependSpace = false;
         }
     }
@@ -35,7 +65,7 @@ namespace linuxdeploy::log {
     ldLog ldLog::operator<<(const std::string& message) {
         if (checkVerbosity()) {
             checkPrependSpace();
-            stream << message;
+            pendingOutput += message;
         }
 
         return ldLog(true, logLevelSet, currentLogLevel);
@@ -43,7 +73,7 @@ namespace linuxdeploy::log {
     ldLog ldLog::operator<<(const char* message) {
         if (checkVerbosity()) {
             checkPrependSpace();
-            stream << message;
+            pendingOutput += message;
         }
 
         return ldLog(true, logLevelSet, currentLogLevel);
@@ -52,7 +82,7 @@ namespace linuxdeploy::log {
     ldLog ldLog::operator<<(const std::filesystem::path& path) {
         if (checkVerbosity()) {
             checkPrependSpace();
-            stream << path.string();
+            pendingOutput += path.string();
         }
 
         return ldLog(true, logLevelSet, currentLogLevel);
@@ -73,7 +103,13 @@ namespace linuxdeploy::log {
     ldLog ldLog::operator<<(stdEndlType strm) {
         if (checkVerbosity()) {
             checkPrependSpace();
-            stream << strm;
+
+            // the manipulator decides what to write, e.g., std::endl a line break and std::flush nothing at all
+            std::ostringstream manipulated;
+            strm(manipulated);
+            pendingOutput += manipulated.str();
+
+            flushPendingOutput(stream);
         }
 
         return ldLog(false, logLevelSet, currentLogLevel);
@@ -91,13 +127,13 @@ namespace linuxdeploy::log {
         if (checkVerbosity()) {
             switch (logLevel) {
                 case LD_DEBUG:
-                    stream << "DEBUG: ";
+                    pendingOutput += "DEBUG: ";
                     break;
                 case LD_WARNING:
-                    stream << "WARNING: ";
+                    pendingOutput += "WARNING: ";
                     break;
                 case LD_ERROR:
-                    stream << "ERROR: ";
+                    pendingOutput += "ERROR: ";
                     break;
                 default:
                     break;
@@ -122,6 +158,7 @@ namespace linuxdeploy::log {
     }
 
     void ldLog::write(const char* s, const size_t n) {
-        stream.write(s, n);
+        pendingOutput.append(s, n);
+        flushPendingOutput(stream);
     }
 }
@@ -1,5 +1,10 @@
 // system headers
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
 
 // library headers
 #include <args.hxx>
@@ -9,8 +14,11 @@
 #include "linuxdeploy/desktopfile/desktopfile.h"
 #include "linuxdeploy/log/log.h"
 #include "linuxdeploy/plugin/plugin.h"
+#include "linuxdeploy/util/thread_pool.h"
 #include "linuxdeploy/util/util.h"
 #include "core.h"
+#include "server.h"
+#include "plugin/plugin_shared_library.h"
 
 using namespace linuxdeploy;
 using namespace linuxdeploy::core;
@@ -19,6 +27,55 @@ using namespace linuxdeploy::util;
 
 namespace fs = std::filesystem;
 
+namespace {
+    // runs the given plugins, concurrently if there is more than one, and returns whether all of them succeeded
+    bool runPlugins(const std::vector<NamedPlugin>& plugins, appdir::AppDir& appDir, size_t maxParallelPlugins) {
+        std::vector<int> exitCodes;
+
+        // shared library plugins work on the AppDir instance, which must not be used by the server at the same time
+        // they call linuxdeploy's functions rather than running it again, so they don't need the server anyway
+        // they never run concurrently with other plugins
+        if (plugins.size() == 1 && dynamic_cast<plugin::SharedLibraryPlugin*>(plugins.front().second) != nullptr) {
+            exitCodes.emplace_back(plugins.front().second->run(appDir));
+        } else {
+            // nested linuxdeploy processes run by the plugins forward their requests to this process, which can reuse
+            // its state rather than having to start from scratch
+            // the requests are handled one at a time, so concurrent plugins can share the server
+            std::optional<server::Server> server;
+            subprocess::subprocess_env_map_t environment;
+
+            try {
+                server.emplace(appDir);
+                environment[server::SOCKET_ENV_VAR] = server->socketPath().string();
+            } catch (const std::runtime_error& e) {
+                ldLog() << LD_WARNING << "Failed to start server for nested linuxdeploy processes:" << e.what() << std::endl;
+            }
+
+            // the AppDir instance may be used by the server only, the plugins just get the path
+            if (plugins.size() == 1) {
+                exitCodes.emplace_back(plugins.front().second->run(appDir.path(), environment));
+            } else {
+                thread_pool::ThreadPool pool(std::min(plugins.size(), maxParallelPlugins));
+
+                exitCodes = pool.map(plugins.begin(), plugins.end(), [&appDir, &environment](const NamedPlugin& plugin) {
+                    return plugin.second->run(appDir.path(), environment);
+                });
+            }
+        }
+
+        bool success = true;
+
+        for (size_t i = 0; i < plugins.size(); ++i) {
+            if (exitCodes[i] != 0) {
+                ldLog() << LD_ERROR << "Failed to run plugin:" << plugins[i].first << "(exit code:" << exitCodes[i] << LD_NO_SPACE << ")" << std::endl;
+                success = false;
+            }
+        }
+
+        return success;
+    }
+}
+
 int main(int argc, char** argv) {
     args::ArgumentParser parser(
         "linuxdeploy -- create AppDir bundles with ease"
@@ -30,6 +87,9 @@ int main(int argc, char** argv) {
 
     args::ValueFlag<std::string> appDirPath(parser, "appdir", "Path to target AppDir", {"appdir"});
 
+    args::ValueFlag<int> jobs(parser, "jobs", "Number of files to process in parallel (default: number of CPU cores), also limits the number of parallel-safe input plugins run concurrently", {'j', "jobs"});
+    args::ValueFlag<std::string> deduplicateFiles(parser, "method", "Replace identical files in the AppDir with hardlinks (method: hardlink) or relative symlinks (method: symlink)", {"deduplicate-files"});
+
     args::ValueFlagList<std::string> sharedLibraryPaths(parser, "library", "Shared library to deploy", {'l', "library"});
     args::ValueFlagList<std::string> excludeLibraryPatterns(parser, "pattern", "Shared library to exclude from deployment (glob pattern)", {"exclude-library"});
 
@@ -42,6 +102,7 @@ int main(int argc, char** argv) {
 
     args::ValueFlagList<std::string> iconPaths(parser, "icon file", "Icon to deploy", {'i', "icon-file"});
     args::ValueFlag<std::string> iconTargetFilename(parser, "filename", "Filename all icons passed via -i should be renamed to", {"icon-filename"});
+    args::ValueFlag<std::string> generateIconPath(parser, "icon file", "Large icon to generate PNG icons in the common hicolor sizes from (vector images are deployed as scalable icon instead)", {"generate-icons-from"});
 
     args::ValueFlag<std::string> customAppRunPath(parser, "AppRun path", "Path to custom AppRun script (linuxdeploy will not create a symlink but copy this file instead)", {"custom-apprun"});
 
@@ -89,7 +150,48 @@ int main(int argc, char** argv) {
         ldLog::setVerbosity((LD_LOGLEVEL) verbosity.Get());
     }
 
-    auto foundPlugins = linuxdeploy::plugin::findPlugins();
+    // when run by a plugin, forward the request to the linuxdeploy process running the plugin, unless it uses options
+    // the server doesn't support
+    if (getenv("LINUXDEPLOY_PLUGIN_MODE") != nullptr && getenv(server::SOCKET_ENV_VAR) != nullptr && appDirPath &&
+        !listPlugins && !inputPlugins && !outputPlugins && !excludeLibraryPatterns && !desktopFilePaths &&
+        !createDesktopFile && !iconTargetFilename && !generateIconPath && !customAppRunPath && !deduplicateFiles) {
+        // the server runs in another working directory
+        server::Request request;
+        request.appDirPath = fs::absolute(appDirPath.Get());
+
+        auto addCommands = [&request](const char* command, const std::vector<std::string>& paths) {
+            for (const auto& path : paths) {
+                request.commands.emplace_back(command, fs::absolute(path).string());
+            }
+        };
+
+        addCommands(server::DEPLOY_LIBRARY_COMMAND, sharedLibraryPaths.Get());
+        addCommands(server::DEPLOY_EXECUTABLE_COMMAND, executablePaths.Get());
+        addCommands(server::DEPLOY_DEPS_ONLY_COMMAND, deployDepsOnlyPaths.Get());
+        addCommands(server::DEPLOY_ICON_COMMAND, iconPaths.Get());
+
+        if (const auto exitCode = server::sendRequest(getenv(server::SOCKET_ENV_VAR), request)) {
+            ldLog() << "Request has been handled by parent linuxdeploy process" << std::endl;
+            return *exitCode;
+        }
+
+        ldLog() << LD_DEBUG << "Parent linuxdeploy process could not handle request, running on our own" << std::endl;
+    }
+
+    // probing plugins requires running them, so only the ones which are going to be used are searched for
+    std::map<std::string, linuxdeploy::plugin::IPlugin*> foundPlugins;
+
+    if (listPlugins) {
+        foundPlugins = linuxdeploy::plugin::findPlugins();
+    } else {
+        std::set<std::string> requestedPlugins;
+
+        for (const auto& pluginNames : {inputPlugins.Get(), outputPlugins.Get()}) {
+            requestedPlugins.insert(pluginNames.begin(), pluginNames.end());
+        }
+
+        foundPlugins = linuxdeploy::plugin::findPlugins(requestedPlugins);
+    }
 
     if (listPlugins) {
         ldLog() << "Available plugins:" << std::endl;
@@ -111,6 +213,26 @@ int main(int argc, char** argv) {
     appdir::AppDir appDir(appDirPath.Get());
     appDir.setExcludeLibraryPatterns(excludeLibraryPatterns.Get());
 
+    if (jobs) {
+        if (jobs.Get() < 1) {
+            ldLog() << LD_ERROR << "--jobs must be at least 1" << std::endl;
+            return 1;
+        }
+
+        appDir.setJobs(static_cast<size_t>(jobs.Get()));
+    }
+
+    auto deduplicationMethod = appdir::DEDUPLICATE_USING_HARDLINKS;
+
+    if (deduplicateFiles) {
+        if (deduplicateFiles.Get() == "symlink") {
+            deduplicationMethod = appdir::DEDUPLICATE_USING_SYMLINKS;
+        } else if (deduplicateFiles.Get() != "hardlink") {
+            ldLog() << LD_ERROR << "Invalid deduplication method:" << deduplicateFiles.Get() << "(must be hardlink or symlink)" << std::endl;
+            return 1;
+        }
+    }
+
     // allow disabling copyright files deployment via environment variable
     if (getenv("DISABLE_COPYRIGHT_FILES_DEPLOYMENT") != nullptr) {
         ldLog() << std::endl << LD_WARNING << "Copyright files deployment disabled" << std::endl;
@@ -169,28 +291,8 @@ int main(int argc, char** argv) {
         ldLog() << std::endl << "-- Deploying dependencies only for ELF files --" << std::endl;
 
         for (const auto& path : deployDepsOnlyPaths.Get()) {
-            if (fs::is_directory(path)) {
-                ldLog() << "Deploying files in directory" << path << std::endl;
-
-                for (auto it = fs::directory_iterator{path}; it != fs::directory_iterator{}; ++it) {
-                    if (!fs::is_regular_file(*it)) {
-                        continue;
-                    }
-
-                    if (!appDir.deployDependenciesOnlyForElfFile(*it, true)) {
-                        ldLog() << LD_WARNING << "Failed to deploy dependencies for ELF file" << *it << LD_NO_SPACE << ", skipping" << std::endl;
-                        continue;
-                    }
-                }
-            } else if (fs::is_regular_file(path)) {
-                if (!appDir.deployDependenciesOnlyForElfFile(path)) {
-                    ldLog() << LD_ERROR << "Failed to deploy dependencies for ELF file: " << path << std::endl;
-                    return 1;
-                }
-            } else {
-                ldLog() << LD_ERROR << "No such file or directory: " << path << std::endl;
+            if (!linuxdeploy::deployDependenciesOnly(path, appDir))
                 return 1;
-            }
         }
     }
 
@@ -204,11 +306,11 @@ int main(int argc, char** argv) {
     // run input plugins before deploying icons and desktop files
     // the input plugins might even fetch these resources somewhere into the AppDir, and this way, the user can make use of that
     if (inputPlugins) {
+        std::vector<NamedPlugin> plugins;
+
         for (const auto& pluginName : inputPlugins.Get()) {
             auto it = foundPlugins.find(std::string(pluginName));
 
-            ldLog() << std::endl << "-- Running input plugin:" << pluginName << "--" << std::endl;
-
             if (it == foundPlugins.end()) {
                 ldLog() << LD_ERROR << "Could not find plugin:" << pluginName << std::endl;
                 return 1;
@@ -225,12 +327,29 @@ int main(int argc, char** argv) {
                 return 1;
             }
 
-            auto retcode = plugin->run(appDir.path());
+            plugins.emplace_back(pluginName, plugin);
+        }
 
-            if (retcode != 0) {
-                ldLog() << LD_ERROR << "Failed to run plugin:" << pluginName << "(exit code:" << retcode << LD_NO_SPACE << ")" << std::endl;
-                return 1;
+        // the number of plugins which run concurrently is only limited if the user asks for it
+        const auto maxParallelPlugins = jobs ? static_cast<size_t>(jobs.Get()) : plugins.size();
+
+        // consecutive plugins which declared that they only touch their own files are run concurrently, in which case
+        // the run takes about as long as the slowest of them, all other plugins are run on their own in the given order
+        for (const auto& batch : batchPlugins(plugins, maxParallelPlugins)) {
+            if (batch.size() == 1) {
+                ldLog() << std::endl << "-- Running input plugin:" << batch.front().first << "--" << std::endl;
+            } else {
+                std::vector<std::string> batchNames;
+
+                for (const auto& plugin : batch) {
+                    batchNames.emplace_back(plugin.first);
+                }
+
+                ldLog() << std::endl << "-- Running input plugins in parallel:" << join(batchNames, " ") << "--" << std::endl;
             }
+
+            if (!runPlugins(batch, appDir, maxParallelPlugins))
+                return 1;
         }
     }
 
@@ -258,6 +377,30 @@ int main(int argc, char** argv) {
         }
     }
 
+    if (generateIconPath) {
+        ldLog() << std::endl << "-- Generating icons --" << std::endl;
+
+        const auto& iconPath = generateIconPath.Get();
+
+        if (!fs::exists(iconPath)) {
+            ldLog() << LD_ERROR << "No such file or directory: " << iconPath << std::endl;
+            return 1;
+        }
+
+        bool iconsGeneratedSuccessfully;
+
+        if (iconTargetFilename) {
+            iconsGeneratedSuccessfully = appDir.generateIcons(iconPath, iconTargetFilename.Get());
+        } else {
+            iconsGeneratedSuccessfully = appDir.generateIcons(iconPath);
+        }
+
+        if (!iconsGeneratedSuccessfully) {
+            ldLog() << LD_ERROR << "Failed to generate icons from: " << iconPath << std::endl;
+            return 1;
+        }
+    }
+
     if (desktopFilePaths) {
         ldLog() << std::endl << "-- Deploying desktop files --" << std::endl;
 
@@ -282,6 +425,14 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // duplicates can only be found once all files are in place
+    if (deduplicateFiles) {
+        ldLog() << std::endl << "-- Deduplicating files in AppDir --" << std::endl;
+
+        // the duplicates which could not be replaced are still intact, so the AppDir is usable anyway
+        (void) appDir.deduplicateFiles(deduplicationMethod);
+    }
+
     if (createDesktopFile) {
         if (!executablePaths) {
             ldLog() << LD_ERROR << "--create-desktop-file requires at least one executable to be passed" << std::endl;
@@ -351,12 +502,8 @@ int main(int argc, char** argv) {
                 return 1;
             }
 
-            auto retcode = plugin->run(appDir.path());
-
-            if (retcode != 0) {
-                ldLog() << LD_ERROR << "Failed to run plugin:" << pluginName << "(exit code:" << retcode << LD_NO_SPACE << ")" << std::endl;
+            if (!runPlugins({{pluginName, plugin}}, appDir, 1))
                 return 1;
-            }
         }
     }
 
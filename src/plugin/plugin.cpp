@@ -1,22 +1,91 @@
 // system headers
+#include <algorithm>
 #include <filesystem>
+#include <optional>
 #include <regex>
 #include <set>
 #include <string>
 
 // local headers
+#include "linuxdeploy/core/appdir.h"
 #include "linuxdeploy/log/log.h"
 #include "linuxdeploy/plugin/plugin.h"
 #include "linuxdeploy/util/util.h"
+#include "linuxdeploy/util/thread_pool.h"
+#include "core/metadata_cache.h"
+#include "plugin_shared_library.h"
 #include "plugin_type0.h"
 
 using namespace linuxdeploy::log;
+using namespace linuxdeploy::util::thread_pool;
 
 namespace fs = std::filesystem;
 
 namespace linuxdeploy {
     namespace plugin {
+        namespace {
+            // kind of the entries in the metadata cache
+            // the value is empty if the plugin does not implement a supported API level, otherwise it consists of the
+            // API level, the plugin type and the space separated capabilities
+            const std::string pluginCacheKind = "plugin";
+
+            // returns nothing if the cached value can't be used, e.g., because it was stored by another version
+            std::optional<IPlugin*> createPluginInstanceFromCache(const fs::path& path, const std::vector<std::string>& cachedValue) {
+                if (cachedValue.empty()) {
+                    ldLog() << LD_DEBUG << "Plugin" << path << "does not implement a supported API level (cached)" << std::endl;
+                    return nullptr;
+                }
+
+                // entries stored by versions which didn't probe the capabilities yet lack them, and are probed again
+                if (cachedValue.size() != 3 || cachedValue[0] != "0")
+                    return std::nullopt;
+
+                const auto pluginType = cachedValue[1] == "output" ? OUTPUT_TYPE : INPUT_TYPE;
+
+                const auto capabilitiesList = util::split(cachedValue[2], ' ');
+                std::set<std::string> capabilities(capabilitiesList.begin(), capabilitiesList.end());
+
+                ldLog() << LD_DEBUG << "Using cached probe results for plugin" << path << std::endl;
+
+                return new Type0Plugin(path, pluginType, capabilities);
+            }
+        }
+
+        int IPlugin::run(const fs::path& appDirPath, const subprocess::subprocess_env_map_t&) {
+            return run(appDirPath);
+        }
+
+        int IPlugin::run(core::appdir::AppDir& appDir) {
+            return run(appDir.path());
+        }
+
+        bool IPlugin::hasCapability(const std::string& capability) const {
+            const auto pluginCapabilities = capabilities();
+            return pluginCapabilities.find(capability) != pluginCapabilities.end();
+        }
+
         IPlugin* createPluginInstance(const std::filesystem::path& path) {
+            // shared libraries are loaded rather than run, which is cheap enough to skip the cache
+            if (SharedLibraryPlugin::isSharedLibraryPlugin(path)) {
+                try {
+                    return new SharedLibraryPlugin(path);
+                } catch (const WrongApiLevelError& e) {
+                    ldLog() << LD_DEBUG << e.what() << std::endl;
+                    return nullptr;
+                }
+            }
+
+            // probing a plugin requires running it twice, which is slow, especially for AppImages, so the results are
+            // cached for as long as the file doesn't change
+            const auto metadataCache = core::MetadataCache::fromEnvironment();
+
+            if (metadataCache != nullptr) {
+                if (const auto cachedValue = metadataCache->get(pluginCacheKind, path)) {
+                    if (const auto rv = createPluginInstanceFromCache(path, *cachedValue))
+                        return *rv;
+                }
+            }
+
             IPlugin* rv = nullptr;
 
             // test whether it's a type 0 plugin
@@ -26,12 +95,27 @@ namespace linuxdeploy {
                 ldLog() << LD_DEBUG << e.what() << std::endl;
             }
 
+            if (metadataCache != nullptr) {
+                if (rv == nullptr) {
+                    metadataCache->put(pluginCacheKind, path, {});
+                } else {
+                    const auto capabilities = rv->capabilities();
+                    const std::vector<std::string> capabilitiesList(capabilities.begin(), capabilities.end());
+
+                    metadataCache->put(pluginCacheKind, path, {std::to_string(rv->apiLevel()), rv->pluginTypeString(), util::join(capabilitiesList, " ")});
+                }
+            }
+
             return rv;
         }
 
-        std::map<std::string, IPlugin*> findPlugins() {
+        // searches the plugin directories, and probes all plugins found in them, or the requested ones only
+        static std::map<std::string, IPlugin*> findPluginsInSearchPaths(const std::set<std::string>* names) {
             std::map<std::string, IPlugin*> foundPlugins;
 
+            // candidates in order of precedence, the directories are searched first, and probed concurrently later
+            std::vector<std::pair<std::string, fs::path>> candidates;
+
             const auto PATH = getenv("PATH");
 
             auto paths = util::split(PATH, ':');
@@ -75,7 +159,9 @@ namespace linuxdeploy {
 
                         // file must be executable...
                         static constexpr auto isExecutable = fs::perms::owner_exec | fs::perms::group_exec | fs::perms::others_exec;
-                        if (!(static_cast<unsigned int>(fs::status(*i).permissions()) & static_cast<unsigned int>(isExecutable))) {
+                        // ... unless it's a shared library plugin, which is loaded rather than run
+                        if (!(static_cast<unsigned int>(fs::status(*i).permissions()) & static_cast<unsigned int>(isExecutable)) &&
+                            !SharedLibraryPlugin::isSharedLibraryPlugin(i->path())) {
                             if (extendedDebugLoggingEnabled)
                                 ldLog() << LD_DEBUG << "File/symlink is not executable, skipping:" << i->path() << std::endl;
 
@@ -99,26 +185,74 @@ namespace linuxdeploy {
                         continue;
                     }
 
-                    try {
-                        auto name = res[1].str();
-                        auto* plugin = createPluginInstance(*i);
-                        if (plugin == nullptr) {
-                            ldLog() << LD_DEBUG << "Failed to create instance for plugin" << i->path() << std::endl;;
-                        } else {
-                            ldLog() << LD_DEBUG << "Found plugin '" << LD_NO_SPACE << name << LD_NO_SPACE << "':" << plugin->path() << std::endl;
-
-                            if (foundPlugins.find(name) != foundPlugins.end()) {
-                                ldLog() << LD_DEBUG << "Already found" << name << "plugin in" << foundPlugins[name]->path() << std::endl;
-                            } else {
-                                foundPlugins[name] = plugin;
-                            }
-                        }
-                    } catch (const PluginError& e) {
-                        ldLog() << LD_WARNING << "Could not load plugin" << i->path() << LD_NO_SPACE << ": " << e.what();
+                    auto name = res[1].str();
+
+                    // plugins which haven't been asked for don't need to be probed
+                    if (names != nullptr && names->find(name) == names->end()) {
+                        if (extendedDebugLoggingEnabled)
+                            ldLog() << LD_DEBUG << "Plugin not requested, skipping:" << i->path() << std::endl;
+
+                        continue;
                     }
+
+                    // the same directory may be searched more than once, e.g., if it's in $PATH and the current
+                    // working directory
+                    if (std::find_if(candidates.begin(), candidates.end(), [&i](const auto& candidate) { return candidate.second == i->path(); }) != candidates.end())
+                        continue;
+
+                    candidates.emplace_back(name, i->path());
+                }
+            }
+
+            if (candidates.empty())
+                return foundPlugins;
+
+            // probing mostly waits for the plugin processes, so all candidates can be probed at once
+            ThreadPool pool(candidates.size());
+
+            const auto plugins = pool.map(candidates.begin(), candidates.end(), [](const auto& candidate) -> IPlugin* {
+                try {
+                    return createPluginInstance(candidate.second);
+                } catch (const PluginError& e) {
+                    ldLog() << LD_WARNING << "Could not load plugin" << candidate.second << LD_NO_SPACE << ": " << e.what() << std::endl;
+                    return nullptr;
+                }
+            });
+
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                const auto& [name, path] = candidates[i];
+                auto* plugin = plugins[i];
+
+                if (plugin == nullptr) {
+                    ldLog() << LD_DEBUG << "Failed to create instance for plugin" << path << std::endl;
+                    continue;
+                }
+
+                ldLog() << LD_DEBUG << "Found plugin '" << LD_NO_SPACE << name << LD_NO_SPACE << "':" << plugin->path() << std::endl;
+
+                if (foundPlugins.find(name) != foundPlugins.end()) {
+                    ldLog() << LD_DEBUG << "Already found" << name << "plugin in" << foundPlugins[name]->path() << std::endl;
+                } else {
+                    foundPlugins[name] = plugin;
                 }
             }
+
+            if (const auto metadataCache = core::MetadataCache::fromEnvironment(); metadataCache != nullptr)
+                metadataCache->save();
+
             return foundPlugins;
         }
+
+        std::map<std::string, IPlugin*> findPlugins() {
+            return findPluginsInSearchPaths(nullptr);
+        }
+
+        std::map<std::string, IPlugin*> findPlugins(const std::set<std::string>& names) {
+            // no need to search the directories if no plugin has been asked for
+            if (names.empty())
+                return {};
+
+            return findPluginsInSearchPaths(&names);
+        }
     }
 }
@@ -1,15 +1,21 @@
 // system headers
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstring>
 #include <filesystem>
-#include <thread>
+#include <poll.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
 #include <utility>
+#include <vector>
 
 // local headers
 #include <linuxdeploy/plugin/plugin_process_handler.h>
 #include <linuxdeploy/subprocess/process.h>
 #include <linuxdeploy/util/util.h>
 #include <linuxdeploy/log/log.h>
-#include <linuxdeploy/subprocess/pipe_reader.h>
 
 namespace fs = std::filesystem;
 
@@ -20,12 +26,15 @@ namespace linuxdeploy {
         plugin_process_handler::plugin_process_handler(std::string name, fs::path path) : name_(std::move(name)),
                                                                                           path_(std::move(path)) {}
 
-        int plugin_process_handler::run(const fs::path& appDir) const {
+        int plugin_process_handler::run(const fs::path& appDir, const subprocess::subprocess_env_map_t& environment) const {
             // prepare arguments and environment variables
             const std::initializer_list<std::string> args = {path_.string(), "--appdir", appDir.string()};
 
             auto environmentVariables = subprocess::get_environment();
 
+            for (const auto& [name, value] : environment)
+                environmentVariables[name] = value;
+
             // add $LINUXDEPLOY, which points to the current binary
             // we do not need to pass $APPIMAGE or alike, since while linuxdeploy is running, the path in the
             // temporary mountpoint of its AppImage will be valid anyway
@@ -34,99 +43,140 @@ namespace linuxdeploy {
             linuxdeploy::subprocess::process proc{args, environmentVariables};
 
             // we want to insert a custom log prefix whenever a CR or LF is written into either buffer
-            // like in subprocess's check_output, we use pipe readers to read from the subprocess's stdout/stderr pipes
-            // however, we just dump everything we receive directly in the log, using our ĺogging framework
-            // we store an ldLog instance per stream so we can just send all data into those, which allows us to get away
-            // with relatively small buffers (we don't have to cache complete lines or alike)
+            // we wait for data on both of the subprocess's stdout/stderr pipes at once, and dump everything we receive
+            // directly in the log, using our logging framework
+            // only complete lines are written, so that the lines of plugins which run concurrently are not interleaved
+
+            // a plugin which never ends its line must not make us buffer its entire output
+            constexpr size_t max_pending_line_size = 64 * 1024;
+
             class pipe_to_be_logged {
             public:
-                pipe_reader reader_;
-                std::string stream_name_;
-                ldLog log_;
-                bool print_prefix_in_next_iteration_;
+                int fd_;
+                std::string log_prefix_;
+                // incomplete line, which is logged once the rest of it has been read
+                std::string pending_line_;
                 bool eof = false;
 
-                pipe_to_be_logged(int pipe_fd, std::string stream_name) : reader_(pipe_fd),
-                                                                          stream_name_(std::move(stream_name)),
-                                                                          log_(),
-                                                                          print_prefix_in_next_iteration_(true) {}
+                pipe_to_be_logged(int fd, const std::string& plugin_name, const std::string& stream_name)
+                    : fd_(fd), log_prefix_("[" + plugin_name + "/" + stream_name + "] ") {}
+
+                // appends the complete lines in the given data, including their control chars, to output, each
+                // prefixed with our prefix
+                void forward(const char* data, const size_t size, std::string& output) {
+                    const char* const end = data + size;
+                    const char* next_lf = nullptr;
+
+                    while (data != end) {
+                        // we look for the next LF only once it has been passed, and for the next CR only up to the
+                        // next LF, so the data is scanned just once even if it consists of lots of short lines
+                        if (next_lf == nullptr || next_lf < data) {
+                            next_lf = static_cast<const char*>(memchr(data, '\n', end - data));
+
+                            if (next_lf == nullptr)
+                                next_lf = end;
+                        }
+
+                        const auto* next_cr = static_cast<const char*>(memchr(data, '\r', next_lf - data));
+
+                        // we don't care which one goes first -- we pick the closest one
+                        const auto* next_control_char = next_cr != nullptr ? next_cr : next_lf;
+
+                        if (next_control_char == end) {
+                            pending_line_.append(data, end);
+
+                            if (pending_line_.size() >= max_pending_line_size) {
+                                pending_line_ += '\n';
+                                flush_pending_line(output);
+                            }
+
+                            break;
+                        }
+
+                        // need to make sure we include the control char in the write
+                        pending_line_.append(data, next_control_char + 1);
+                        flush_pending_line(output);
+
+                        data = next_control_char + 1;
+                    }
+                }
+
+                // the plugin may not have terminated its last line
+                void finish(std::string& output) {
+                    if (!pending_line_.empty()) {
+                        pending_line_ += '\n';
+                        flush_pending_line(output);
+                    }
+                }
+
+            private:
+                void flush_pending_line(std::string& output) {
+                    output += log_prefix_;
+                    output += pending_line_;
+                    pending_line_.clear();
+                }
             };
 
             std::array<pipe_to_be_logged, 2> pipes_to_be_logged{
-                pipe_to_be_logged(proc.stdout_fd(), "stdout"),
-                pipe_to_be_logged(proc.stderr_fd(), "stderr"),
+                pipe_to_be_logged(proc.stdout_fd(), name_, "stdout"),
+                pipe_to_be_logged(proc.stderr_fd(), name_, "stderr"),
             };
 
-            for (;;) {
-                for (auto& pipe_to_be_logged : pipes_to_be_logged) {
-                    if (pipe_to_be_logged.eof) {
+            // the buffers are reused for all reads
+            std::vector<char> read_buffer(64 * 1024);
+
+            // the lines from one read are sent to the log at once, which saves locking it for every line
+            std::string output;
+
+            std::array<pollfd, 2> poll_fds{};
+
+            // once all pipes are EOF, we can stop reading
+            while (!std::all_of(pipes_to_be_logged.begin(), pipes_to_be_logged.end(), [](const pipe_to_be_logged& pipe_state) {
+                return pipe_state.eof;
+            })) {
+                for (size_t i = 0; i < pipes_to_be_logged.size(); ++i) {
+                    // poll() ignores negative file descriptors
+                    poll_fds[i] = {pipes_to_be_logged[i].eof ? -1 : pipes_to_be_logged[i].fd_, POLLIN, 0};
+                }
+
+                // sleep until there is something to do
+                if (poll(poll_fds.data(), poll_fds.size(), -1) < 0) {
+                    if (errno == EINTR)
                         continue;
+
+                    throw std::runtime_error{"unexpected error waiting for plugin output: " + std::string(strerror(errno))};
+                }
+
+                for (size_t i = 0; i < pipes_to_be_logged.size(); ++i) {
+                    auto& pipe_to_be_logged = pipes_to_be_logged[i];
+
+                    if (poll_fds[i].revents == 0)
+                        continue;
+
+                    if ((poll_fds[i].revents & POLLNVAL) != 0)
+                        throw std::runtime_error{"poll() failed unexpectedly"};
+
+                    // besides POLLIN, this handles POLLHUP, after which read() returns the remaining data, then EOF
+                    const auto rv = ::read(pipe_to_be_logged.fd_, read_buffer.data(), read_buffer.size());
+
+                    if (rv < 0) {
+                        if (errno == EINTR || errno == EAGAIN)
+                            continue;
+
+                        throw std::runtime_error{"unexpected error reading from pipe: " + std::string(strerror(errno))};
                     }
 
-                    const auto log_prefix = "[" + name_ + "/" + pipe_to_be_logged.stream_name_ + "] ";
-
-                    // since we have our own ldLog instance for every pipe, we can get away with this rather small read buffer
-                    subprocess::subprocess_result_buffer_t intermediate_buffer(4096);
-
-                    // (try to) read from pipe
-                    switch (pipe_to_be_logged.reader_.read(intermediate_buffer)) {
-                        case pipe_reader::result::SUCCESS: {
-                            // all we have to do now is to look for CR or LF, send everything up to that location into the ldLog instance,
-                            // write our prefix and then repeat
-                            for (auto it = intermediate_buffer.begin(); it != intermediate_buffer.end(); ++it) {
-                                if (pipe_to_be_logged.print_prefix_in_next_iteration_) {
-                                    pipe_to_be_logged.log_ << log_prefix;
-                                }
-
-                                const auto next_lf = std::find(it, intermediate_buffer.end(), '\n');
-                                const auto next_cr = std::find(it, intermediate_buffer.end(), '\r');
-
-                                // we don't care which one goes first -- we pick the closest one, write everything up to it into our ldLog,
-                                // then print our prefix and repeat that until there's nothing left in our buffer
-                                auto next_control_char = std::min({next_lf, next_cr});
-
-                                // if there is a control char, we remember this for the next iteration, where we print our
-                                // log prefix
-                                // in any case, we can write the remaining buffer contents into the ldLog object
-                                pipe_to_be_logged.print_prefix_in_next_iteration_ = (next_control_char !=
-                                                                                     intermediate_buffer.end());
-
-                                const auto distance_from_begin_to_it = std::distance(intermediate_buffer.begin(), it);
-                                auto distance_from_it_to_next_cc = std::distance(it, next_control_char);
-
-                                if (pipe_to_be_logged.print_prefix_in_next_iteration_) {
-                                    distance_from_it_to_next_cc++;
-                                }
-
-                                // need to make sure we include the control char in the write
-                                pipe_to_be_logged.log_.write(
-                                    intermediate_buffer.data() + distance_from_begin_to_it,
-                                    distance_from_it_to_next_cc
-                                );
-
-                                it = next_control_char;
-
-                                // TODO: should not be necessary, should be fixed in for loop
-                                if (!pipe_to_be_logged.print_prefix_in_next_iteration_) {
-                                    break;
-                                }
-                            }
-                            break;
-                        }
-                        case pipe_reader::result::END_OF_FILE: {
-                            pipe_to_be_logged.eof = true;
-                            break;
-                        }
-                        case pipe_reader::result::TIMEOUT:
-                            break;
+                    if (rv == 0) {
+                        pipe_to_be_logged.eof = true;
+                        pipe_to_be_logged.finish(output);
+                    } else {
+                        pipe_to_be_logged.forward(read_buffer.data(), static_cast<size_t>(rv), output);
                     }
-                }
 
-                // once all buffers are EOF, we can stop reading
-                if (std::all_of(pipes_to_be_logged.begin(), pipes_to_be_logged.end(), [](const pipe_to_be_logged& pipe_state) {
-                    return pipe_state.eof;
-                })) {
-                    break;
+                    if (!output.empty()) {
+                        ldLog().write(output.data(), output.size());
+                        output.clear();
+                    }
                 }
             }
 
@@ -0,0 +1,106 @@
+// measures the CPU time linuxdeploy spends forwarding the output of a chatty plugin into its log
+// the plugin is a shell script, which either writes lots of lines at once, or trickles them in slowly, in which case the
+// forwarder should mostly be waiting
+// the log output is discarded, the time the plugin itself needs is not included in the CPU time
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+
+#include "linuxdeploy/plugin/plugin_process_handler.h"
+
+using namespace linuxdeploy::plugin;
+
+namespace fs = std::filesystem;
+
+namespace {
+    double getCpuTimeMs() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+
+        const auto toMs = [](const timeval& tv) {
+            return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+        };
+
+        return toMs(usage.ru_utime) + toMs(usage.ru_stime);
+    }
+
+    void benchmark(const std::string& name, const fs::path& pluginPath) {
+        const auto begin = std::chrono::steady_clock::now();
+        const auto cpuBegin = getCpuTimeMs();
+
+        plugin_process_handler handler("benchmark", pluginPath);
+        const auto exitCode = handler.run("/nonexistent.AppDir");
+
+        const auto cpuEnd = getCpuTimeMs();
+        const auto end = std::chrono::steady_clock::now();
+        const auto wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count();
+
+        std::cerr << name << ": " << (cpuEnd - cpuBegin) << " ms CPU, " << wallMs << " ms wall clock"
+                  << " (exit code " << exitCode << ")" << std::endl;
+    }
+
+    fs::path writePlugin(const fs::path& dir, const std::string& name, const std::string& body) {
+        const auto path = dir / name;
+
+        std::ofstream ofs(path);
+        ofs << "#!/bin/sh" << std::endl << body << std::endl;
+        ofs.close();
+
+        fs::permissions(path, fs::perms::owner_all);
+
+        return path;
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t linesCount = argc >= 2 ? std::stoul(argv[1]) : 200000;
+
+    auto tempDirTemplate = (fs::temp_directory_path() / "plugin-process-handler-benchmark-XXXXXX").string();
+
+    if (mkdtemp(tempDirTemplate.data()) == nullptr) {
+        std::cerr << "Failed to create temporary directory" << std::endl;
+        return 1;
+    }
+
+    const fs::path tempDir = tempDirTemplate;
+
+    const auto count = std::to_string(linesCount);
+
+    // lines of a typical length, on both streams at once
+    const auto burstPlugin = writePlugin(tempDir, "burst.sh",
+        "yes 'Deploying library /usr/lib/x86_64-linux-gnu/libQt5Core.so.5 to AppDir/usr/lib' | head -n " + count + " &\n"
+        "yes 'Setting rpath in ELF file AppDir/usr/lib/libQt5Core.so.5 to $ORIGIN' | head -n " + count + " >&2\n"
+        "wait"
+    );
+
+    // progress output, which uses CR rather than LF, and has no line break at all for a long time
+    const auto progressPlugin = writePlugin(tempDir, "progress.sh",
+        "yes 'Copying files... 42%' | head -n " + count + " | tr '\\n' '\\r'"
+    );
+
+    // a plugin which mostly waits, like one which downloads or compiles something
+    const auto tricklePlugin = writePlugin(tempDir, "trickle.sh",
+        "for i in $(seq 20); do echo \"Step $i\"; sleep 0.1; done"
+    );
+
+    // the forwarded lines are written to std::cout, which must not end up on the terminal
+    std::ofstream devNull("/dev/null");
+    auto* const originalBuffer = std::cout.rdbuf(devNull.rdbuf());
+
+    std::cerr << "Forwarding the output of plugins (" << linesCount << " lines per stream)" << std::endl;
+
+    benchmark("burst on stdout and stderr", burstPlugin);
+    benchmark("progress without line breaks", progressPlugin);
+    benchmark("20 lines in 2 seconds", tricklePlugin);
+
+    std::cout.rdbuf(originalBuffer);
+
+    fs::remove_all(tempDir);
+
+    return 0;
+}
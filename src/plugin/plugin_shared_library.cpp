@@ -0,0 +1,243 @@
+// system headers
+#include <dlfcn.h>
+#include <exception>
+#include <filesystem>
+#include <regex>
+#include <sstream>
+
+// local headers
+#include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/log/log.h"
+#include "linuxdeploy/plugin/exceptions.h"
+#include "linuxdeploy/plugin/shared_library_api.h"
+#include "linuxdeploy/util/util.h"
+#include "plugin_shared_library.h"
+
+using namespace linuxdeploy::core::appdir;
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace plugin {
+        namespace {
+            typedef int (*api_level_function_t)();
+            typedef const char* (*plugin_type_function_t)();
+            typedef int (*run_function_t)(const linuxdeploy_plugin_host*);
+
+            AppDir& getAppDir(void* appDir) {
+                return *static_cast<AppDir*>(appDir);
+            }
+
+            fs::path getPathArgument(const char* path) {
+                if (path == nullptr)
+                    return {};
+
+                return path;
+            }
+
+            // relative destinations are interpreted relative to the AppDir, an empty one selects the default location
+            fs::path getDestinationArgument(AppDir& appDir, const char* destination) {
+                const auto rv = getPathArgument(destination);
+
+                if (rv.empty() || rv.is_absolute())
+                    return rv;
+
+                return appDir.path() / rv;
+            }
+
+            // exceptions must not be thrown through the plugin's code, which is not necessarily C++
+            template<typename F>
+            int callOperation(const char* operationName, F&& operation) {
+                try {
+                    return operation() ? 1 : 0;
+                } catch (const std::exception& e) {
+                    ldLog() << LD_ERROR << "Plugin operation" << operationName << "failed:" << e.what() << std::endl;
+                    return 0;
+                }
+            }
+
+            int deployLibrary(void* appDir, const char* path, const char* destination) {
+                return callOperation("deploy_library", [&]() {
+                    return getAppDir(appDir).deployLibrary(getPathArgument(path), getDestinationArgument(getAppDir(appDir), destination));
+                });
+            }
+
+            int forceDeployLibrary(void* appDir, const char* path, const char* destination) {
+                return callOperation("force_deploy_library", [&]() {
+                    return getAppDir(appDir).forceDeployLibrary(getPathArgument(path), getDestinationArgument(getAppDir(appDir), destination));
+                });
+            }
+
+            int deployExecutable(void* appDir, const char* path, const char* destination) {
+                return callOperation("deploy_executable", [&]() {
+                    return getAppDir(appDir).deployExecutable(getPathArgument(path), getDestinationArgument(getAppDir(appDir), destination));
+                });
+            }
+
+            int deployDependenciesOnlyForElfFile(void* appDir, const char* path) {
+                return callOperation("deploy_dependencies_only_for_elf_file", [&]() {
+                    return getAppDir(appDir).deployDependenciesOnlyForElfFile(getDestinationArgument(getAppDir(appDir), path));
+                });
+            }
+
+            int deployFile(void* appDir, const char* from, const char* to) {
+                return callOperation("deploy_file", [&]() {
+                    return !getAppDir(appDir).deployFile(getPathArgument(from), getDestinationArgument(getAppDir(appDir), to)).empty();
+                });
+            }
+
+            int deployIcon(void* appDir, const char* path) {
+                return callOperation("deploy_icon", [&]() {
+                    return getAppDir(appDir).deployIcon(getPathArgument(path));
+                });
+            }
+
+            int executeDeferredOperations(void* appDir) {
+                return callOperation("execute_deferred_operations", [&]() {
+                    return getAppDir(appDir).executeDeferredOperations();
+                });
+            }
+        }
+
+        class SharedLibraryPlugin::PrivateData {
+            public:
+                const fs::path pluginPath;
+                std::string name;
+                PLUGIN_TYPE pluginType = INPUT_TYPE;
+
+                // the library stays loaded for as long as the plugin exists
+                void* handle = nullptr;
+                run_function_t runFunction = nullptr;
+
+            public:
+                explicit PrivateData(const fs::path& path) : pluginPath(path) {
+                    ldLog() << LD_DEBUG << "Loading shared library plugin" << path << std::endl;
+
+                    // the plugin's symbols must not interfere with the ones of other plugins
+                    handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+
+                    if (handle == nullptr) {
+                        throw PluginError("Failed to load shared library plugin: " + std::string(dlerror()));
+                    }
+
+                    try {
+                        load();
+                    } catch (...) {
+                        dlclose(handle);
+                        throw;
+                    }
+
+                    std::cmatch res;
+                    std::regex_match(path.filename().c_str(), res, PLUGIN_EXPR);
+                    name = res[1].str();
+                }
+
+                ~PrivateData() {
+                    dlclose(handle);
+                }
+
+                PrivateData(const PrivateData&) = delete;
+                PrivateData& operator=(const PrivateData&) = delete;
+
+            private:
+                template<typename T>
+                T findSymbol(const char* symbolName) const {
+                    return reinterpret_cast<T>(dlsym(handle, symbolName));
+                }
+
+                void load() {
+                    const auto apiLevelFunction = findSymbol<api_level_function_t>("linuxdeploy_plugin_api_level");
+
+                    if (apiLevelFunction == nullptr) {
+                        throw WrongApiLevelError("Shared library does not implement the plugin API: " + pluginPath.string());
+                    }
+
+                    const auto apiLevel = apiLevelFunction();
+
+                    if (apiLevel != LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL) {
+                        std::stringstream msg;
+                        msg << "Shared library plugins must implement API level " << LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL
+                            << ", not " << apiLevel;
+                        throw WrongApiLevelError(msg.str());
+                    }
+
+                    const auto pluginTypeFunction = findSymbol<plugin_type_function_t>("linuxdeploy_plugin_type");
+                    runFunction = findSymbol<run_function_t>("linuxdeploy_plugin_run");
+
+                    if (pluginTypeFunction == nullptr || runFunction == nullptr) {
+                        throw PluginError("Shared library plugin does not implement all required functions: " + pluginPath.string());
+                    }
+
+                    const auto* typeString = pluginTypeFunction();
+
+                    if (typeString != nullptr && std::string(typeString) == "output") {
+                        pluginType = OUTPUT_TYPE;
+                    } else if (typeString == nullptr || std::string(typeString) != "input") {
+                        throw PluginError("Shared library plugin has invalid type: " + pluginPath.string());
+                    }
+                }
+        };
+
+        SharedLibraryPlugin::SharedLibraryPlugin(const fs::path& path) : IPlugin(path), d(std::make_shared<PrivateData>(path)) {}
+
+        bool SharedLibraryPlugin::isSharedLibraryPlugin(const fs::path& path) {
+            return util::strLower(path.extension().string()) == ".so";
+        }
+
+        fs::path SharedLibraryPlugin::path() const {
+            return d->pluginPath;
+        }
+
+        int SharedLibraryPlugin::apiLevel() const {
+            return LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL;
+        }
+
+        PLUGIN_TYPE SharedLibraryPlugin::pluginType() const {
+            return d->pluginType;
+        }
+
+        std::string SharedLibraryPlugin::pluginTypeString() const {
+            return d->pluginType == OUTPUT_TYPE ? "output" : "input";
+        }
+
+        std::set<std::string> SharedLibraryPlugin::capabilities() const {
+            return {};
+        }
+
+        int SharedLibraryPlugin::run(const fs::path& appDirPath) {
+            AppDir appDir(appDirPath);
+            return run(appDir);
+        }
+
+        int SharedLibraryPlugin::run(AppDir& appDir) {
+            const auto appDirPath = fs::absolute(appDir.path()).string();
+
+            linuxdeploy_plugin_host host{};
+            host.size = sizeof(host);
+            host.appdir = &appDir;
+            host.appdir_path = appDirPath.c_str();
+            host.deploy_library = deployLibrary;
+            host.force_deploy_library = forceDeployLibrary;
+            host.deploy_executable = deployExecutable;
+            host.deploy_dependencies_only_for_elf_file = deployDependenciesOnlyForElfFile;
+            host.deploy_file = deployFile;
+            host.deploy_icon = deployIcon;
+            host.execute_deferred_operations = executeDeferredOperations;
+
+            const auto rv = d->runFunction(&host);
+
+            if (rv != 0)
+                return rv;
+
+            // like executable plugins, which run linuxdeploy in plugin mode, the plugin's files must be in place when
+            // it has finished
+            if (!appDir.executeDeferredOperations()) {
+                ldLog() << LD_ERROR << "Failed to execute deferred operations queued by plugin" << d->name << std::endl;
+                return 1;
+            }
+
+            return 0;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+// system headers
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+
+// local headers
+#include "linuxdeploy/plugin/plugin.h"
+
+#pragma once
+
+namespace linuxdeploy {
+    namespace plugin {
+        /*
+         * Plugin implemented as a shared library, which is loaded into the linuxdeploy process.
+         * See linuxdeploy/plugin/shared_library_api.h for the API plugins must implement.
+         */
+        class SharedLibraryPlugin : public IPlugin {
+            private:
+                // private data class pattern
+                class PrivateData;
+                std::shared_ptr<PrivateData> d;
+
+            public:
+                // load plugin from given path
+                // throws WrongApiLevelError if the library doesn't implement the shared library plugin API
+                explicit SharedLibraryPlugin(const std::filesystem::path& path);
+
+                // plugins are recognized by their file extension
+                static bool isSharedLibraryPlugin(const std::filesystem::path& path);
+
+            public:
+                std::filesystem::path path() const override;
+                int apiLevel() const override;
+                PLUGIN_TYPE pluginType() const override;
+                std::string pluginTypeString() const override;
+
+                // the plugin operates on the AppDir instance, which must not be used by several threads at once, therefore
+                // it never runs concurrently with other plugins
+                std::set<std::string> capabilities() const override;
+
+                // shared library plugins need the AppDir instance, this creates one for the given path
+                int run(const std::filesystem::path& appDirPath) override;
+
+                // run the plugin on the given AppDir, and execute the operations it queued
+                int run(core::appdir::AppDir& appDir) override;
+        };
+    }
+}
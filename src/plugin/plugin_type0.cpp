@@ -1,5 +1,6 @@
 // system headers
 #include <filesystem>
+#include <utility>
 #include "plugin_type0.h"
 
 using namespace linuxdeploy::log;
@@ -10,5 +11,8 @@ namespace linuxdeploy {
     namespace plugin {
         // it should suffice to just use the base class's constructor code
         Type0Plugin::Type0Plugin(const std::filesystem::path& path) : PluginBase(path) {}
+
+        Type0Plugin::Type0Plugin(const std::filesystem::path& path, PLUGIN_TYPE pluginType, std::set<std::string> capabilities)
+            : PluginBase(path, pluginType, std::move(capabilities)) {}
     }
 }
@@ -1,5 +1,6 @@
 // system headers
 #include <filesystem>
+#include <set>
 #include <string>
 
 // local headers
@@ -17,6 +18,7 @@ namespace linuxdeploy {
         class Type0Plugin : public base::PluginBase<0> {
             public:
                 explicit Type0Plugin(const std::filesystem::path& path);
+                Type0Plugin(const std::filesystem::path& path, PLUGIN_TYPE pluginType, std::set<std::string> capabilities);
         };
     }
 }
@@ -0,0 +1,359 @@
+// system headers
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "core.h"
+#include "server.h"
+
+using namespace linuxdeploy::core;
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace linuxdeploy {
+    namespace server {
+        namespace {
+            constexpr auto PROTOCOL_VERSION = "1";
+
+            // requests are generated by linuxdeploy itself, these limits only protect against garbage
+            constexpr uint32_t MAX_STRINGS_COUNT = 1 << 16;
+            constexpr uint32_t MAX_STRING_LENGTH = 1 << 20;
+
+            bool readAll(int fd, void* buffer, size_t size) {
+                auto* position = static_cast<char*>(buffer);
+
+                while (size > 0) {
+                    const auto rv = ::read(fd, position, size);
+
+                    if (rv < 0 && errno == EINTR)
+                        continue;
+
+                    if (rv <= 0)
+                        return false;
+
+                    position += rv;
+                    size -= static_cast<size_t>(rv);
+                }
+
+                return true;
+            }
+
+            bool writeAll(int fd, const void* buffer, size_t size) {
+                const auto* position = static_cast<const char*>(buffer);
+
+                while (size > 0) {
+                    // the peer may have gone away, which must not kill this process with SIGPIPE
+                    const auto rv = ::send(fd, position, size, MSG_NOSIGNAL);
+
+                    if (rv < 0 && errno == EINTR)
+                        continue;
+
+                    if (rv < 0)
+                        return false;
+
+                    position += rv;
+                    size -= static_cast<size_t>(rv);
+                }
+
+                return true;
+            }
+
+            bool writeStrings(int fd, const std::vector<std::string>& strings) {
+                const auto count = static_cast<uint32_t>(strings.size());
+
+                if (!writeAll(fd, &count, sizeof(count)))
+                    return false;
+
+                for (const auto& string : strings) {
+                    const auto length = static_cast<uint32_t>(string.size());
+
+                    if (!writeAll(fd, &length, sizeof(length)) || !writeAll(fd, string.data(), string.size()))
+                        return false;
+                }
+
+                return true;
+            }
+
+            std::optional<std::vector<std::string>> readStrings(int fd) {
+                uint32_t count;
+
+                if (!readAll(fd, &count, sizeof(count)) || count > MAX_STRINGS_COUNT)
+                    return std::nullopt;
+
+                std::vector<std::string> rv(count);
+
+                for (auto& string : rv) {
+                    uint32_t length;
+
+                    if (!readAll(fd, &length, sizeof(length)) || length > MAX_STRING_LENGTH)
+                        return std::nullopt;
+
+                    string.resize(length);
+
+                    if (!readAll(fd, string.data(), length))
+                        return std::nullopt;
+                }
+
+                return rv;
+            }
+
+            sockaddr_un makeAddress(const fs::path& socketPath) {
+                sockaddr_un address{};
+                address.sun_family = AF_UNIX;
+
+                const auto& pathString = socketPath.string();
+
+                // the path must fit including the terminating null byte
+                if (pathString.size() >= sizeof(address.sun_path))
+                    throw std::runtime_error("Socket path too long: " + pathString);
+
+                strncpy(address.sun_path, pathString.c_str(), sizeof(address.sun_path) - 1);
+
+                return address;
+            }
+        }
+
+        class Server::PrivateData {
+            public:
+                appdir::AppDir& appDir;
+
+                fs::path socketDirPath;
+                fs::path socketPath;
+
+                int listenFd = -1;
+
+                // written to on destruction to wake up the server thread
+                int stopPipe[2] = {-1, -1};
+
+                std::thread thread;
+
+            public:
+                explicit PrivateData(appdir::AppDir& appDir) : appDir(appDir) {
+                    // the socket is created in a private directory, so other users can't connect to it
+                    auto socketDirTemplate = (fs::temp_directory_path() / "linuxdeploy-server-XXXXXX").string();
+
+                    if (mkdtemp(socketDirTemplate.data()) == nullptr)
+                        throw std::runtime_error("Failed to create socket directory: " + std::string(strerror(errno)));
+
+                    socketDirPath = socketDirTemplate;
+                    socketPath = socketDirPath / "socket";
+
+                    try {
+                        setUpSocket();
+                    } catch (...) {
+                        cleanUp();
+                        throw;
+                    }
+
+                    ldLog() << LD_DEBUG << "Listening for requests of nested linuxdeploy processes on" << socketPath << std::endl;
+
+                    thread = std::thread([this]() { serve(); });
+                }
+
+                ~PrivateData() {
+                    // a request which is being handled is finished first
+                    const char stop = 0;
+                    (void) ::write(stopPipe[1], &stop, sizeof(stop));
+                    thread.join();
+
+                    cleanUp();
+                }
+
+                PrivateData(const PrivateData&) = delete;
+                PrivateData& operator=(const PrivateData&) = delete;
+
+            private:
+                void setUpSocket() {
+                    if (pipe2(stopPipe, O_CLOEXEC) != 0)
+                        throw std::runtime_error("Failed to create pipe: " + std::string(strerror(errno)));
+
+                    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+                    if (listenFd < 0)
+                        throw std::runtime_error("Failed to create socket: " + std::string(strerror(errno)));
+
+                    const auto address = makeAddress(socketPath);
+
+                    if (bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, 16) != 0)
+                        throw std::runtime_error("Failed to listen on socket: " + std::string(strerror(errno)));
+                }
+
+                void cleanUp() {
+                    for (const auto fd : {listenFd, stopPipe[0], stopPipe[1]}) {
+                        if (fd >= 0)
+                            close(fd);
+                    }
+
+                    std::error_code ec;
+                    fs::remove_all(socketDirPath, ec);
+                }
+
+                void serve() {
+                    for (;;) {
+                        std::array<pollfd, 2> pollFds{{
+                            {listenFd, POLLIN, 0},
+                            {stopPipe[0], POLLIN, 0},
+                        }};
+
+                        if (poll(pollFds.data(), pollFds.size(), -1) < 0) {
+                            if (errno == EINTR)
+                                continue;
+
+                            ldLog() << LD_ERROR << "Failed to wait for requests:" << strerror(errno) << std::endl;
+                            return;
+                        }
+
+                        if (pollFds[1].revents != 0)
+                            return;
+
+                        const int connectionFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+
+                        if (connectionFd < 0)
+                            continue;
+
+                        handleConnection(connectionFd);
+                        close(connectionFd);
+                    }
+                }
+
+                void handleConnection(int connectionFd) {
+                    const auto strings = readStrings(connectionFd);
+
+                    int32_t exitCode = UNSUPPORTED_REQUEST;
+
+                    // the number of strings must be even: version, AppDir and pairs of command and argument
+                    if (strings.has_value() && strings->size() >= 2 && strings->size() % 2 == 0 && (*strings)[0] == PROTOCOL_VERSION) {
+                        Request request;
+                        request.appDirPath = (*strings)[1];
+
+                        for (size_t i = 2; i < strings->size(); i += 2) {
+                            request.commands.emplace_back((*strings)[i], (*strings)[i + 1]);
+                        }
+
+                        exitCode = handleRequest(request);
+                    } else {
+                        ldLog() << LD_WARNING << "Received invalid request from nested linuxdeploy process" << std::endl;
+                    }
+
+                    (void) writeAll(connectionFd, &exitCode, sizeof(exitCode));
+                }
+
+                int handleRequest(const Request& request) {
+                    std::error_code ec;
+
+                    if (!fs::equivalent(request.appDirPath, appDir.path(), ec)) {
+                        ldLog() << LD_DEBUG << "Request from nested linuxdeploy process is for another AppDir:" << request.appDirPath << std::endl;
+                        return UNSUPPORTED_REQUEST;
+                    }
+
+                    ldLog() << std::endl << "-- Handling request from nested linuxdeploy process --" << std::endl;
+
+                    try {
+                        // the plugin may have added files which need their dependencies, unchanged files are skipped
+                        if (!appDir.deployDependenciesForExistingFiles()) {
+                            ldLog() << LD_ERROR << "Failed to deploy dependencies for existing files" << std::endl;
+                            return 1;
+                        }
+
+                        for (const auto& [command, argument] : request.commands) {
+                            if (!handleCommand(command, argument))
+                                return 1;
+                        }
+
+                        if (!appDir.executeDeferredOperations())
+                            return 1;
+                    } catch (const std::exception& e) {
+                        ldLog() << LD_ERROR << "Failed to handle request from nested linuxdeploy process:" << e.what() << std::endl;
+                        return 1;
+                    }
+
+                    return 0;
+                }
+
+                bool handleCommand(const std::string& command, const std::string& argument) {
+                    if (command == DEPLOY_LIBRARY_COMMAND) {
+                        if (!appDir.forceDeployLibrary(argument)) {
+                            ldLog() << LD_ERROR << "Failed to deploy library: " << argument << std::endl;
+                            return false;
+                        }
+                    } else if (command == DEPLOY_EXECUTABLE_COMMAND) {
+                        if (!appDir.deployExecutable(argument)) {
+                            ldLog() << LD_ERROR << "Failed to deploy executable: " << argument << std::endl;
+                            return false;
+                        }
+                    } else if (command == DEPLOY_DEPS_ONLY_COMMAND) {
+                        return deployDependenciesOnly(argument, appDir);
+                    } else if (command == DEPLOY_ICON_COMMAND) {
+                        if (!appDir.deployIcon(argument)) {
+                            ldLog() << LD_ERROR << "Failed to deploy icon: " << argument << std::endl;
+                            return false;
+                        }
+                    } else {
+                        ldLog() << LD_ERROR << "Unknown command in request from nested linuxdeploy process:" << command << std::endl;
+                        return false;
+                    }
+
+                    return true;
+                }
+        };
+
+        Server::Server(appdir::AppDir& appDir) : d(std::make_shared<PrivateData>(appDir)) {}
+
+        fs::path Server::socketPath() const {
+            return d->socketPath;
+        }
+
+        std::optional<int> sendRequest(const fs::path& socketPath, const Request& request) {
+            sockaddr_un address{};
+
+            try {
+                address = makeAddress(socketPath);
+            } catch (const std::runtime_error& e) {
+                ldLog() << LD_DEBUG << e.what() << std::endl;
+                return std::nullopt;
+            }
+
+            const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+            if (fd < 0)
+                return std::nullopt;
+
+            std::vector<std::string> strings{PROTOCOL_VERSION, request.appDirPath.string()};
+
+            for (const auto& [command, argument] : request.commands) {
+                strings.emplace_back(command);
+                strings.emplace_back(argument);
+            }
+
+            int32_t exitCode = UNSUPPORTED_REQUEST;
+
+            const bool success = connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0 &&
+                writeStrings(fd, strings) &&
+                readAll(fd, &exitCode, sizeof(exitCode));
+
+            close(fd);
+
+            if (!success) {
+                ldLog() << LD_DEBUG << "Failed to send request to linuxdeploy server" << socketPath << std::endl;
+                return std::nullopt;
+            }
+
+            if (exitCode == UNSUPPORTED_REQUEST)
+                return std::nullopt;
+
+            return exitCode;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+// system headers
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// local headers
+#include "linuxdeploy/core/appdir.h"
+
+namespace linuxdeploy {
+    namespace server {
+        /*
+         * Environment variable which contains the path to the socket of the server, if any.
+         */
+        static constexpr auto SOCKET_ENV_VAR = "LINUXDEPLOY_SERVER_SOCKET";
+
+        /*
+         * Request sent by a nested linuxdeploy process, which is run by a plugin in plugin mode.
+         *
+         * The commands are executed in order, and correspond to the command line options with the same names. Before
+         * the commands are executed, the dependencies of new or changed files in the AppDir are deployed. Afterwards,
+         * the deferred operations are executed, like they are at the end of a plugin mode run.
+         *
+         * On the wire, a request is a list of strings, each of which is preceded by its length. The list is preceded by
+         * the number of strings, and consists of the protocol version, the AppDir path, and a command and argument for
+         * each command. The response is the exit code of the request, or UNSUPPORTED_REQUEST. All numbers are 32-bit
+         * integers in the machine's byte order, as the socket is never shared between machines.
+         */
+        class Request {
+            public:
+                std::filesystem::path appDirPath;
+                std::vector<std::pair<std::string, std::string>> commands;
+        };
+
+        static constexpr auto DEPLOY_LIBRARY_COMMAND = "library";
+        static constexpr auto DEPLOY_EXECUTABLE_COMMAND = "executable";
+        static constexpr auto DEPLOY_DEPS_ONLY_COMMAND = "deploy-deps-only";
+        static constexpr auto DEPLOY_ICON_COMMAND = "icon-file";
+
+        // returned if the server can't handle the request, e.g., because it's working on another AppDir
+        static constexpr int UNSUPPORTED_REQUEST = -1;
+
+        /*
+         * Local server which executes requests of nested linuxdeploy processes on the AppDir of this process.
+         *
+         * Plugins may run linuxdeploy again to deploy files. Instead of doing all the work from scratch, these processes
+         * forward their requests to the server, which reuses the state of the AppDir, e.g., the visited files and the
+         * parsed libraries.
+         *
+         * The server listens on a Unix socket in a temporary directory. Its path is passed to the plugins in
+         * SOCKET_ENV_VAR, rather than set in the environment of this process, which other threads may be reading while
+         * they start processes. Requests are executed one at a time on a separate thread, the AppDir must not be used
+         * otherwise while the server exists. Therefore, shared library plugins, which work on the AppDir instance, are
+         * run without a server.
+         */
+        class Server {
+            private:
+                // private data class pattern
+                class PrivateData;
+                std::shared_ptr<PrivateData> d;
+
+            public:
+                // throws std::runtime_error if the socket can't be set up
+                explicit Server(core::appdir::AppDir& appDir);
+
+                std::filesystem::path socketPath() const;
+        };
+
+        /*
+         * Send a request to the server listening on the given socket, and wait for it to be executed.
+         *
+         * @return exit code, or nothing if the server is unreachable or can't handle the request
+         */
+        std::optional<int> sendRequest(const std::filesystem::path& socketPath, const Request& request);
+    }
+}
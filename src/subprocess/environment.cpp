@@ -0,0 +1,144 @@
+// system headers
+#include <algorithm>
+#include <mutex>
+#include <unistd.h>
+
+// local headers
+#include "linuxdeploy/subprocess/environment.h"
+
+#ifdef __FreeBSD__
+// On FreeBSD environ has to be declared in the consumer code
+extern "C" {
+    extern char** environ;
+}
+#endif
+
+namespace linuxdeploy {
+    namespace subprocess {
+        class environment::data {
+        public:
+            const std::vector<std::string> entries;
+
+            // points into entries, which are never modified
+            std::vector<char*> pointers;
+
+        public:
+            explicit data(std::vector<std::string> entries) : entries(std::move(entries)) {
+                pointers.reserve(this->entries.size() + 1);
+
+                for (const auto& entry : this->entries) {
+                    pointers.emplace_back(const_cast<char*>(entry.c_str()));
+                }
+
+                // must be null terminated, of course
+                pointers.emplace_back(nullptr);
+            }
+
+            std::vector<std::string>::const_iterator find(const std::string& name) const {
+                return std::find_if(entries.begin(), entries.end(), [&name](const std::string& entry) {
+                    return entry.size() > name.size() && entry[name.size()] == '=' && entry.compare(0, name.size(), name) == 0;
+                });
+            }
+        };
+
+        environment::environment(std::shared_ptr<const data> data) : data_(std::move(data)) {}
+
+        environment::environment() : data_(std::make_shared<const data>(std::vector<std::string>{})) {}
+
+        environment environment::current() {
+            static std::mutex mutex;
+
+            // the environ array the cached instance has been built from
+            // setenv() and unsetenv() either modify the array or replace it, and never modify the strings of existing
+            // entries, so comparing the pointers is sufficient to detect changes
+            static std::vector<char*> cached_environ;
+            static environment cached;
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            size_t size = 0;
+            if (environ != nullptr) {
+                while (environ[size] != nullptr) {
+                    ++size;
+                }
+            }
+
+            if (size != cached_environ.size() || !std::equal(cached_environ.begin(), cached_environ.end(), environ)) {
+                cached_environ.assign(environ, environ + size);
+
+                std::vector<std::string> entries;
+                entries.reserve(size);
+
+                for (const auto* entry : cached_environ) {
+                    entries.emplace_back(entry);
+                }
+
+                cached = environment(std::make_shared<const data>(std::move(entries)));
+            }
+
+            return cached;
+        }
+
+        environment environment::from_map(const subprocess_env_map_t& map) {
+            std::vector<std::string> entries;
+            entries.reserve(map.size());
+
+            for (const auto& [name, value] : map) {
+                entries.emplace_back(name + '=' + value);
+            }
+
+            return environment(std::make_shared<const data>(std::move(entries)));
+        }
+
+        environment environment::set(const std::string& name, const std::string& value) const {
+            auto entries = data_->entries;
+            const auto it = entries.begin() + (data_->find(name) - data_->entries.begin());
+
+            if (it != entries.end()) {
+                *it = name + '=' + value;
+            } else {
+                entries.emplace_back(name + '=' + value);
+            }
+
+            return environment(std::make_shared<const data>(std::move(entries)));
+        }
+
+        environment environment::unset(const std::string& name) const {
+            const auto it = data_->find(name);
+
+            if (it == data_->entries.end()) {
+                return *this;
+            }
+
+            auto entries = data_->entries;
+            entries.erase(entries.begin() + (it - data_->entries.begin()));
+
+            return environment(std::make_shared<const data>(std::move(entries)));
+        }
+
+        std::optional<std::string_view> environment::get(const std::string& name) const {
+            const auto it = data_->find(name);
+
+            if (it == data_->entries.end()) {
+                return std::nullopt;
+            }
+
+            return std::string_view(*it).substr(name.size() + 1);
+        }
+
+        subprocess_env_map_t environment::to_map() const {
+            subprocess_env_map_t rv;
+
+            for (const auto& entry : data_->entries) {
+                const auto first_eq = entry.find('=');
+                rv[entry.substr(0, first_eq)] = first_eq == std::string::npos ? "" : entry.substr(first_eq + 1);
+            }
+
+            return rv;
+        }
+
+        char* const* environment::envp() const {
+            return data_->pointers.data();
+        }
+    }
+}
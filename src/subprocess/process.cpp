@@ -2,10 +2,11 @@
 #include <algorithm>
 #include <stdexcept>
 #include <utility>
+#include <fcntl.h>
 #include <unistd.h>
 #include <memory.h>
+#include <spawn.h>
 #include <sys/wait.h>
-#include <sstream>
 
 // local headers
 #include "linuxdeploy/subprocess/process.h"
@@ -16,12 +17,13 @@
 using namespace linuxdeploy::subprocess;
 
 namespace {
+    // exec*() does not modify the strings, so no copies are needed
     std::vector<char*> make_args_vector(const std::vector<std::string>& args) {
         std::vector<char*> rv{};
-        rv.reserve(args.size());
+        rv.reserve(args.size() + 1);
 
         for (const auto& arg : args) {
-            rv.emplace_back(strdup(arg.c_str()));
+            rv.emplace_back(const_cast<char*>(arg.c_str()));
         }
 
         // execv* want a nullptr-terminated array
@@ -54,26 +56,11 @@ namespace {
         }
     }
 
-    using env_vector_t = std::vector<char*>;
-
-    /**
-     * Convert a map of environment variables to a vector usable within
-     * @param map
-     * @return
-     */
-    env_vector_t env_map_to_vector(const subprocess_env_map_t& map) {
-        env_vector_t out;
-
-        for (const auto& [name, value] : map) {
-            std::ostringstream oss;
-            oss << name << '=' << value;
-            out.emplace_back(strdup(oss.str().c_str()));
-        }
-
-        // must be null terminated, of course
-        out.emplace_back(nullptr);
-
-        return out;
+    // posix_spawn() creates the child without copying the parent's page tables, unlike fork()
+    // therefore, its cost does not depend on the size of our process
+    // fork() can still be used for debugging purposes
+    bool use_fork() {
+        return getenv("LINUXDEPLOY_USE_FORK") != nullptr;
     }
 }
 
@@ -90,15 +77,18 @@ int process::stderr_fd() const {
 }
 
 process::process(std::initializer_list<std::string> args)
-    : process(std::vector<std::string>(args), get_environment()) {}
+    : process(std::vector<std::string>(args), environment::current()) {}
 
 process::process(std::initializer_list<std::string> args, const subprocess_env_map_t& env)
-    : process(std::vector<std::string>(args), env) {}
+    : process(std::vector<std::string>(args), environment::from_map(env)) {}
 
 process::process(const std::vector<std::string>& args)
-    : process(args, get_environment()) {}
+    : process(args, environment::current()) {}
 
-process::process(const std::vector<std::string>& args, const subprocess_env_map_t& env) {
+process::process(const std::vector<std::string>& args, const subprocess_env_map_t& env)
+    : process(args, environment::from_map(env)) {}
+
+process::process(const std::vector<std::string>& args, const environment& env) {
     // preconditions
     util::assert::assert_not_empty(args);
 
@@ -107,9 +97,11 @@ process::process(const std::vector<std::string>& args, const subprocess_env_map_
     int stdout_pipe_fds[2];
     int stderr_pipe_fds[2];
 
-    // FIXME: for debugging of #150
+    // the pipes must not leak into child processes started concurrently by other threads, otherwise reading from them
+    // does not end before those processes have exited, too
+    // dup2() clears the flag on the fds connected to the child's stdout and stderr
     auto create_pipe = [](int fds[]) {
-        const auto rv = pipe(fds);
+        const auto rv = pipe2(fds, O_CLOEXEC);
 
         if (rv != 0) {
             const auto error = errno;
@@ -121,61 +113,74 @@ process::process(const std::vector<std::string>& args, const subprocess_env_map_
     create_pipe(stdout_pipe_fds);
     create_pipe(stderr_pipe_fds);
 
-    // create child process
-    child_pid_ = fork();
-
-    if (child_pid_ < 0) {
-        throw std::runtime_error{"fork() failed"};
-    }
+    // prepare arguments for exec*
+    // this must happen before forking, as allocating memory in the child is unsafe when other threads are running
+    // the environment is serialized already
+    const auto exec_args = make_args_vector(args);
+    const auto exec_env = env.envp();
 
-    if (child_pid_ == 0) {
-        // we're in the child process
+    if (use_fork()) {
+        // create child process
+        child_pid_ = fork();
 
-        // first step: close the read end of both pipes
-        close_pipe_fd(stdout_pipe_fds[READ_END_]);
-        close_pipe_fd(stderr_pipe_fds[READ_END_]);
+        if (child_pid_ < 0) {
+            throw std::runtime_error{"fork() failed"};
+        }
 
-        auto connect_fd = [](int fd, int fileno) {
-            for (;;) {
-                if (dup2(fd, fileno) == -1) {
-                    const auto error = errno;
-                    if (error != EINTR) {
-                        throw std::logic_error{"failed to connect pipes: " + std::string(strerror(error))};
+        if (child_pid_ == 0) {
+            // we're in the child process
+
+            // first step: close the read end of both pipes
+            close_pipe_fd(stdout_pipe_fds[READ_END_]);
+            close_pipe_fd(stderr_pipe_fds[READ_END_]);
+
+            auto connect_fd = [](int fd, int fileno) {
+                for (;;) {
+                    if (dup2(fd, fileno) == -1) {
+                        const auto error = errno;
+                        if (error != EINTR) {
+                            throw std::logic_error{"failed to connect pipes: " + std::string(strerror(error))};
+                        }
+                        continue;
                     }
-                    continue;
-                }
 
-                break;
-            }
-        };
+                    break;
+                }
+            };
 
-        connect_fd(stdout_pipe_fds[WRITE_END_], STDOUT_FILENO);
-        connect_fd(stderr_pipe_fds[WRITE_END_], STDERR_FILENO);
+            connect_fd(stdout_pipe_fds[WRITE_END_], STDOUT_FILENO);
+            connect_fd(stderr_pipe_fds[WRITE_END_], STDERR_FILENO);
 
-        // now, we also have to close the write end of both pipes
-        close_pipe_fd(stdout_pipe_fds[WRITE_END_]);
-        close_pipe_fd(stderr_pipe_fds[WRITE_END_]);
+            // now, we also have to close the write end of both pipes
+            close_pipe_fd(stdout_pipe_fds[WRITE_END_]);
+            close_pipe_fd(stderr_pipe_fds[WRITE_END_]);
 
-        // prepare arguments for exec*
-        auto exec_args = make_args_vector(args);
-        auto exec_env = env_map_to_vector(env);
+            // call subprocess
+            execvpe(args.front().c_str(), exec_args.data(), exec_env);
 
-        // call subprocess
-        execvpe(args.front().c_str(), exec_args.data(), exec_env.data());
+            // only reached if exec* fails
+            throw std::runtime_error{"exec() failed: " + std::string(strerror(errno))};
+        }
+    } else {
+        // the pipes' write ends are connected to the child's stdout and stderr, all other fds of the pipes are closed
+        // on exec as they have O_CLOEXEC set
+        posix_spawn_file_actions_t file_actions;
+        posix_spawn_file_actions_init(&file_actions);
+        posix_spawn_file_actions_adddup2(&file_actions, stdout_pipe_fds[WRITE_END_], STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&file_actions, stderr_pipe_fds[WRITE_END_], STDERR_FILENO);
 
-        // only reached if exec* fails
+        // unlike a failing exec*() call in a forked child, errors are reported to the parent
+        const auto rv = posix_spawnp(&child_pid_, args.front().c_str(), &file_actions, nullptr, exec_args.data(), exec_env);
 
-        // clean up memory if exec should ever return
-        // prevents memleaks if the exception below would be handled by a caller
-        auto deleter = [](char* ptr) {
-            free(ptr);
-            ptr = nullptr;
-        };
+        posix_spawn_file_actions_destroy(&file_actions);
 
-        std::for_each(exec_args.begin(), exec_args.end(), deleter);
-        std::for_each(exec_env.begin(), exec_env.end(), deleter);
+        if (rv != 0) {
+            for (const auto fd : {stdout_pipe_fds[READ_END_], stdout_pipe_fds[WRITE_END_], stderr_pipe_fds[READ_END_], stderr_pipe_fds[WRITE_END_]}) {
+                close_pipe_fd(fd);
+            }
 
-        throw std::runtime_error{"exec() failed: " + std::string(strerror(errno))};
+            throw std::runtime_error{"exec() failed: " + std::string(strerror(rv))};
+        }
     }
 
     // parent code
@@ -1,19 +1,19 @@
 // system headers
 #include <array>
 #include <algorithm>
-#include <array>
+#include <cstring>
+#include <exception>
 #include <iostream>
 #include <memory>
+#include <poll.h>
 #include <stdexcept>
 #include <utility>
 #include <unistd.h>
-#include <thread>
 #include <sstream>
 
 // local headers
 #include "linuxdeploy/subprocess/subprocess.h"
 #include "linuxdeploy/subprocess/process.h"
-#include "linuxdeploy/subprocess/pipe_reader.h"
 #include "linuxdeploy/subprocess/subprocess_result.h"
 #include "linuxdeploy/util/assert.h"
 #include "linuxdeploy/log/log.h"
@@ -22,87 +22,198 @@ namespace linuxdeploy {
     namespace subprocess {
         using namespace log;
 
+        namespace {
+            // passes complete lines from chunks of output to a callback
+            // only lines spanning multiple chunks are copied
+            class line_splitter {
+            private:
+                const line_callback_t& callback_;
+                std::string partial_line_;
+
+            public:
+                explicit line_splitter(const line_callback_t& callback) : callback_(callback) {}
+
+                void feed(std::string_view data) {
+                    for (;;) {
+                        const auto newline = data.find('\n');
+
+                        if (newline == std::string_view::npos) {
+                            partial_line_.append(data);
+                            return;
+                        }
+
+                        if (partial_line_.empty()) {
+                            callback_(data.substr(0, newline));
+                        } else {
+                            partial_line_.append(data.substr(0, newline));
+                            callback_(partial_line_);
+                            partial_line_.clear();
+                        }
+
+                        data.remove_prefix(newline + 1);
+                    }
+                }
+
+                // passes the last line if it is not terminated by a newline
+                void flush() {
+                    if (!partial_line_.empty()) {
+                        callback_(partial_line_);
+                        partial_line_.clear();
+                    }
+                }
+            };
+        }
+
         subprocess::subprocess(std::initializer_list<std::string> args)
-            : subprocess(std::vector<std::string>(args), get_environment()) {}
+            : subprocess(std::vector<std::string>(args), environment::current()) {}
 
         subprocess::subprocess(std::initializer_list<std::string> args, subprocess_env_map_t env)
-            : subprocess(std::vector<std::string>(args), std::move(env)) {}
+            : subprocess(std::vector<std::string>(args), environment::from_map(env)) {}
 
         subprocess::subprocess(std::vector<std::string> args)
-            : args_(std::move(args)), env_(get_environment()) {}
+            : subprocess(std::move(args), environment::current()) {}
 
         subprocess::subprocess(std::vector<std::string> args, subprocess_env_map_t env)
+            : subprocess(std::move(args), environment::from_map(env)) {}
+
+        subprocess::subprocess(std::initializer_list<std::string> args, environment env)
+            : subprocess(std::vector<std::string>(args), std::move(env)) {}
+
+        subprocess::subprocess(std::vector<std::string> args, environment env)
             : args_(std::move(args)), env_(std::move(env)) {
             // preconditions
             util::assert::assert_not_empty(args_);
         }
 
+        const std::vector<std::string>& subprocess::args() const {
+            return args_;
+        }
+
+        const environment& subprocess::env() const {
+            return env_;
+        }
+
         subprocess_result subprocess::run() const {
+            std::array<subprocess_result_buffer_t, 2> buffers;
+
+            const auto exit_code = run(
+                [&buffers](std::string_view data) { buffers[0].insert(buffers[0].end(), data.begin(), data.end()); },
+                [&buffers](std::string_view data) { buffers[1].insert(buffers[1].end(), data.begin(), data.end()); }
+            );
+
+            // make sure contents are null-terminated
+            buffers[0].emplace_back('\0');
+            buffers[1].emplace_back('\0');
+
+            return subprocess_result{exit_code, std::move(buffers[0]), std::move(buffers[1])};
+        }
+
+        int subprocess::run(const output_callback_t& on_stdout, const output_callback_t& on_stderr) const {
             process proc{args_, env_};
 
-            class PipeState {
-            public:
-                pipe_reader reader;
-                subprocess_result_buffer_t buffer;
-                bool eof = false;
+            // both pipes are watched with a single poll() call, which returns as soon as either of them has data or
+            // is closed
+            // once the child has exited, both pipes report EOF immediately, so no polling interval is needed to detect
+            // the exit, and waiting for EOF ensures that all output is collected
+            std::array<pollfd, 2> pollfds{{
+                {proc.stdout_fd(), POLLIN, 0},
+                {proc.stderr_fd(), POLLIN, 0},
+            }};
 
-                explicit PipeState(int fd) : reader(fd) {}
-            };
+            const std::array<const output_callback_t*, 2> callbacks{&on_stdout, &on_stderr};
 
-            // create pipe readers and empty buffers for both stdout and stderr
-            // we manage them in this (admittedly, kind of complex-looking) array so we can later easily perform the
-            // operations in a loop
-            std::array<PipeState, 2> buffers = {
-                PipeState(proc.stdout_fd()),
-                PipeState(proc.stderr_fd())
-            };
+            // the pipes are drained even if a callback throws, otherwise the child could block forever writing to them
+            std::exception_ptr callback_error;
 
-            for (;;) {
-                for (auto& pipe_state: buffers) {
-                    // read some bytes into smaller intermediate buffer to prevent either of the pipes to overflow
-                    // the results are immediately appended to the main buffer
-                    subprocess_result_buffer_t intermediate_buffer(4096);
-
-                    // (try to) read all available data from pipe
-                    for (; !pipe_state.eof;) {
-                        switch (pipe_state.reader.read(intermediate_buffer)) {
-                            case pipe_reader::result::SUCCESS: {
-                                // append to main buffer
-                                pipe_state.buffer.reserve(pipe_state.buffer.size() + intermediate_buffer.size());
-                                std::copy(intermediate_buffer.begin(), intermediate_buffer.end(),
-                                          std::back_inserter(pipe_state.buffer));
-                                break;
-                            }
-                            case pipe_reader::result::END_OF_FILE: {
-                                pipe_state.eof = true;
-                                break;
-                            }
-                            default:
-                                break;
-                        }
+            // read in large chunks to keep the number of system calls low for programs with lots of output
+            std::vector<char> intermediate_buffer(64 * 1024);
+
+            for (size_t open_pipes = pollfds.size(); open_pipes > 0;) {
+                if (poll(pollfds.data(), pollfds.size(), -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
                     }
-                }
 
-                if (proc.is_running()) {
-                    // reduce load on CPU until EOF
-                    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                    throw std::runtime_error{"unexpected error polling pipes: " + std::string(strerror(errno))};
                 }
 
-                // once all buffers are EOF, we can stop reading
-                if (std::all_of(buffers.begin(), buffers.end(), [](const PipeState& pipe_state) {
-                    return pipe_state.eof;
-                })) {
-                    break;
+                for (size_t i = 0; i < pollfds.size(); ++i) {
+                    auto& pfd = pollfds[i];
+
+                    // poll() ignores negative file descriptors, which we use to mark pipes that have reached EOF
+                    if (pfd.fd < 0 || pfd.revents == 0) {
+                        continue;
+                    }
+
+                    if ((pfd.revents & POLLNVAL) != 0) {
+                        throw std::runtime_error{"poll() failed unexpectedly"};
+                    }
+
+                    // POLLHUP and POLLERR are handled by read(), which then returns 0 or an error, respectively
+                    const auto rv = ::read(pfd.fd, intermediate_buffer.data(), intermediate_buffer.size());
+
+                    if (rv < 0) {
+                        if (errno == EINTR || errno == EAGAIN) {
+                            continue;
+                        }
+
+                        throw std::runtime_error{"unexpected error reading from pipe: " + std::string(strerror(errno))};
+                    }
+
+                    if (rv == 0) {
+                        pfd.fd = -1;
+                        --open_pipes;
+                        continue;
+                    }
+
+                    const auto& callback = *callbacks[i];
+
+                    if (callback && !callback_error) {
+                        try {
+                            callback(std::string_view(intermediate_buffer.data(), static_cast<size_t>(rv)));
+                        } catch (...) {
+                            callback_error = std::current_exception();
+                        }
+                    }
                 }
             }
 
-            // make sure contents are null-terminated
-            buffers[0].buffer.emplace_back('\0');
-            buffers[1].buffer.emplace_back('\0');
+            const auto exit_code = proc.close();
+
+            if (callback_error) {
+                std::rethrow_exception(callback_error);
+            }
+
+            return exit_code;
+        }
+
+        int subprocess::run_lines(const line_callback_t& on_stdout_line, const line_callback_t& on_stderr_line) const {
+            line_splitter stdout_splitter(on_stdout_line);
+            line_splitter stderr_splitter(on_stderr_line);
 
-            auto exit_code = proc.close();
+            // empty callbacks make run() skip the streams entirely
+            auto make_callback = [](const line_callback_t& line_callback, line_splitter& splitter) -> output_callback_t {
+                if (!line_callback) {
+                    return {};
+                }
+
+                return [&splitter](std::string_view data) { splitter.feed(data); };
+            };
+
+            const auto exit_code = run(
+                make_callback(on_stdout_line, stdout_splitter),
+                make_callback(on_stderr_line, stderr_splitter)
+            );
+
+            if (on_stdout_line) {
+                stdout_splitter.flush();
+            }
+
+            if (on_stderr_line) {
+                stderr_splitter.flush();
+            }
 
-            return subprocess_result{exit_code, buffers[0].buffer, buffers[1].buffer};
+            return exit_code;
         }
 
         std::string subprocess::check_output() const {
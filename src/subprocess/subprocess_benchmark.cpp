@@ -0,0 +1,110 @@
+// measures the overhead of subprocess::run() for a child process which exits immediately
+// the bare fork(), exec() and waitpid() calls serve as a baseline
+// the process creation backends are compared with different amounts of memory in use, as the cost of fork() grows
+// with the size of the calling process
+
+#include <chrono>
+#include <future>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "linuxdeploy/subprocess/subprocess.h"
+#include "linuxdeploy/subprocess/subprocess_pool.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace {
+    template<typename F>
+    void benchmark(const std::string& name, size_t iterations, F&& function) {
+        const auto begin = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < iterations; ++i) {
+            function();
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        const auto totalUs = std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count();
+
+        std::cout << name << ": " << (totalUs / static_cast<double>(iterations)) << " us per call" << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    const size_t iterations = argc >= 2 ? std::stoul(argv[1]) : 200;
+
+    std::cout << "Running " << iterations << " no-op child processes" << std::endl;
+
+    benchmark("fork/exec/waitpid", iterations, []() {
+        const auto pid = fork();
+
+        if (pid == 0) {
+            execlp("true", "true", nullptr);
+            _exit(127);
+        }
+
+        int status;
+        waitpid(pid, &status, 0);
+    });
+
+    benchmark("subprocess::run", iterations, []() {
+        subprocess({"true"}).run();
+    });
+
+    benchmark("subprocess::run with output", iterations, []() {
+        subprocess({"echo", "Hello World"}).run();
+    });
+
+    // the children mostly wait, so the pool runs more of them at once than there are CPUs
+    // the time reported is the total time for all children
+    benchmark("subprocess_pool, 8 children at once (sleep 0.01, total)", 1, [iterations]() {
+        subprocess_pool pool(8);
+
+        std::vector<std::future<subprocess_result>> futures;
+        for (size_t i = 0; i < iterations; ++i) {
+            futures.emplace_back(pool.submit(subprocess({"sh", "-c", "sleep 0.01"})));
+        }
+
+        for (auto& future : futures) {
+            future.get();
+        }
+    });
+
+    benchmark("subprocess::run (sleep 0.01)", iterations, []() {
+        subprocess({"sh", "-c", "sleep 0.01"}).run();
+    });
+
+    std::cout << std::endl << "Comparing process creation backends" << std::endl;
+
+    // keep all allocations alive, so that the process grows
+    std::vector<std::unique_ptr<char[]>> allocations;
+    size_t allocatedMiB = 0;
+
+    for (const size_t sizeMiB : {0, 256, 1024}) {
+        while (allocatedMiB < sizeMiB) {
+            // touch the memory, otherwise it is not mapped, and does not need to be copied
+            allocations.emplace_back(new char[1024 * 1024]);
+            memset(allocations.back().get(), 1, 1024 * 1024);
+            ++allocatedMiB;
+        }
+
+        std::cout << "With " << sizeMiB << " MiB allocated:" << std::endl;
+
+        setenv("LINUXDEPLOY_USE_FORK", "1", 1);
+        benchmark("  fork", iterations, []() {
+            subprocess({"true"}).run();
+        });
+
+        unsetenv("LINUXDEPLOY_USE_FORK");
+        benchmark("  posix_spawn", iterations, []() {
+            subprocess({"true"}).run();
+        });
+    }
+
+    return 0;
+}
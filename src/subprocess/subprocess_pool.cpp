@@ -0,0 +1,275 @@
+// system headers
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// local headers
+#include "linuxdeploy/subprocess/subprocess_pool.h"
+#include "linuxdeploy/subprocess/process.h"
+
+namespace linuxdeploy {
+    namespace subprocess {
+        namespace {
+            class job {
+            public:
+                std::vector<std::string> args;
+                environment env;
+                std::promise<subprocess_result> promise;
+
+                // only set while the child is running
+                std::unique_ptr<process> proc;
+
+                // stdout and stderr, set to -1 once they have reached EOF
+                std::array<int, 2> fds{-1, -1};
+                std::array<subprocess_result_buffer_t, 2> buffers;
+
+                // set if reading the output failed
+                std::exception_ptr error;
+
+            public:
+                job(std::vector<std::string> args, environment env) : args(std::move(args)), env(std::move(env)) {}
+
+                bool is_finished() const {
+                    return fds[0] < 0 && fds[1] < 0;
+                }
+
+                void start() {
+                    proc = std::make_unique<process>(args, env);
+                    fds = {proc->stdout_fd(), proc->stderr_fd()};
+                }
+
+                // must be called once both pipes have reached EOF
+                void finish() {
+                    try {
+                        const auto exit_code = proc->close();
+
+                        if (error) {
+                            std::rethrow_exception(error);
+                        }
+
+                        // make sure contents are null-terminated, like subprocess::run() does
+                        buffers[0].emplace_back('\0');
+                        buffers[1].emplace_back('\0');
+
+                        promise.set_value(subprocess_result{exit_code, std::move(buffers[0]), std::move(buffers[1])});
+                    } catch (...) {
+                        promise.set_exception(std::current_exception());
+                    }
+
+                    proc.reset();
+                }
+            };
+        }
+
+        class subprocess_pool::state {
+        public:
+            const size_t max_running;
+
+            std::mutex mutex;
+            std::deque<std::unique_ptr<job>> queue;
+            bool stopping = false;
+
+            // written to in order to interrupt the event loop's poll() call when new jobs are submitted
+            // the read end is non-blocking, so it can be drained
+            std::array<int, 2> wakeup_fds{-1, -1};
+
+            std::thread event_loop;
+
+        public:
+            explicit state(size_t max_running) : max_running(max_running) {
+                if (pipe2(wakeup_fds.data(), O_CLOEXEC | O_NONBLOCK) != 0) {
+                    throw std::runtime_error{"failed to create pipe: " + std::string(strerror(errno))};
+                }
+            }
+
+            ~state() {
+                ::close(wakeup_fds[0]);
+                ::close(wakeup_fds[1]);
+            }
+
+            void wake_up() const {
+                const char c = 0;
+
+                // if the pipe is full, the event loop has not been woken up yet anyway
+                while (::write(wakeup_fds[1], &c, 1) < 0 && errno == EINTR) {}
+            }
+
+            void drain_wakeup_pipe() const {
+                std::array<char, 64> buffer{};
+
+                for (;;) {
+                    const auto rv = ::read(wakeup_fds[0], buffer.data(), buffer.size());
+
+                    if (rv > 0 || (rv < 0 && errno == EINTR)) {
+                        continue;
+                    }
+
+                    break;
+                }
+            }
+
+            void run() {
+                std::vector<std::unique_ptr<job>> running;
+
+                // the first entry is the wakeup pipe, the others belong to the job and stream stored at the same index
+                std::vector<pollfd> pollfds;
+                std::vector<std::pair<job*, size_t>> pollfd_owners;
+
+                // read in large chunks to keep the number of system calls low for programs with lots of output
+                std::vector<char> intermediate_buffer(64 * 1024);
+
+                for (;;) {
+                    std::vector<std::unique_ptr<job>> started;
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+
+                        while (running.size() + started.size() < max_running && !queue.empty()) {
+                            started.emplace_back(std::move(queue.front()));
+                            queue.pop_front();
+                        }
+
+                        if (stopping && running.empty() && started.empty()) {
+                            return;
+                        }
+                    }
+
+                    // starting the children does not need the lock, so submit() is never blocked by it
+                    bool start_failed = false;
+
+                    for (auto& started_job : started) {
+                        try {
+                            started_job->start();
+                            running.emplace_back(std::move(started_job));
+                        } catch (...) {
+                            started_job->promise.set_exception(std::current_exception());
+                            start_failed = true;
+                        }
+                    }
+
+                    // the slots of the jobs which failed to start can be used by queued ones right away
+                    if (start_failed) {
+                        continue;
+                    }
+
+                    pollfds.assign({{wakeup_fds[0], POLLIN, 0}});
+                    pollfd_owners.assign({{nullptr, 0}});
+
+                    for (const auto& running_job : running) {
+                        for (size_t i = 0; i < running_job->fds.size(); ++i) {
+                            if (running_job->fds[i] >= 0) {
+                                pollfds.push_back({running_job->fds[i], POLLIN, 0});
+                                pollfd_owners.emplace_back(running_job.get(), i);
+                            }
+                        }
+                    }
+
+                    if (poll(pollfds.data(), pollfds.size(), -1) < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+
+                        // cannot be recovered from, but must not take down the event loop, or the pool would hang
+                        const auto error = std::make_exception_ptr(std::runtime_error{
+                            "unexpected error polling pipes: " + std::string(strerror(errno))
+                        });
+
+                        for (auto& running_job : running) {
+                            running_job->error = error;
+                            running_job->fds = {-1, -1};
+                        }
+                    }
+
+                    if (pollfds[0].revents != 0) {
+                        drain_wakeup_pipe();
+                    }
+
+                    for (size_t i = 1; i < pollfds.size(); ++i) {
+                        const auto& pfd = pollfds[i];
+
+                        if (pfd.revents == 0) {
+                            continue;
+                        }
+
+                        auto& [owner, stream] = pollfd_owners[i];
+
+                        // POLLHUP and POLLERR are handled by read(), which then returns 0 or an error, respectively
+                        const auto rv = ::read(pfd.fd, intermediate_buffer.data(), intermediate_buffer.size());
+
+                        if (rv < 0) {
+                            if (errno == EINTR || errno == EAGAIN) {
+                                continue;
+                            }
+
+                            owner->error = std::make_exception_ptr(std::runtime_error{
+                                "unexpected error reading from pipe: " + std::string(strerror(errno))
+                            });
+                            owner->fds[stream] = -1;
+                            continue;
+                        }
+
+                        if (rv == 0) {
+                            owner->fds[stream] = -1;
+                            continue;
+                        }
+
+                        auto& buffer = owner->buffers[stream];
+                        buffer.insert(buffer.end(), intermediate_buffer.begin(), intermediate_buffer.begin() + rv);
+                    }
+
+                    // once both pipes have reached EOF, the child has exited or is about to, so waiting is cheap
+                    for (auto& running_job : running) {
+                        if (running_job->is_finished()) {
+                            running_job->finish();
+                        }
+                    }
+
+                    running.erase(std::remove_if(running.begin(), running.end(), [](const std::unique_ptr<job>& running_job) {
+                        return running_job->is_finished();
+                    }), running.end());
+                }
+            }
+        };
+
+        subprocess_pool::subprocess_pool(size_t max_running) {
+            if (max_running == 0) {
+                max_running = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            state_ = std::make_unique<state>(max_running);
+            state_->event_loop = std::thread([this]() { state_->run(); });
+        }
+
+        subprocess_pool::~subprocess_pool() {
+            {
+                std::lock_guard<std::mutex> lock(state_->mutex);
+                state_->stopping = true;
+            }
+
+            state_->wake_up();
+            state_->event_loop.join();
+        }
+
+        std::future<subprocess_result> subprocess_pool::submit(const subprocess& proc) {
+            auto new_job = std::make_unique<job>(proc.args(), proc.env());
+            auto future = new_job->promise.get_future();
+
+            {
+                std::lock_guard<std::mutex> lock(state_->mutex);
+                state_->queue.emplace_back(std::move(new_job));
+            }
+
+            state_->wake_up();
+
+            return future;
+        }
+    }
+}
@@ -4,6 +4,19 @@
 // shorter than using namespace ...
 using namespace linuxdeploy::subprocess;
 
+namespace {
+    // the buffers are null-terminated, like the strings, the terminator is not part of the contents
+    std::string_view make_view(const subprocess_result_buffer_t& buffer) {
+        std::string_view rv(buffer.data(), buffer.size());
+
+        if (!rv.empty() && rv.back() == '\0') {
+            rv.remove_suffix(1);
+        }
+
+        return rv;
+    }
+}
+
 subprocess_result::subprocess_result(int exit_code, subprocess_result_buffer_t stdout_contents,
                                      subprocess_result_buffer_t stderr_contents)
     : exit_code_(exit_code), stdout_contents_(std::move(stdout_contents)), stderr_contents_(std::move(stderr_contents)) {}
@@ -28,3 +41,11 @@ std::string subprocess_result::stdout_string() const {
 std::string subprocess_result::stderr_string() const {
     return stderr_contents().data();
 }
+
+std::string_view subprocess_result::stdout_view() const {
+    return make_view(stdout_contents_);
+}
+
+std::string_view subprocess_result::stderr_view() const {
+    return make_view(stderr_contents_);
+}
@@ -1,10 +1,20 @@
+// system headers
+#include <fstream>
+#include <link.h>
+#include <map>
+
 // library headers
 #include "gtest/gtest.h"
 
 // local headers
 #include  "linuxdeploy/core/appdir.h"
+#include  "linuxdeploy/core/elf_file.h"
+#include  "linuxdeploy/subprocess/subprocess.h"
+#include  "core/image_resample.h"
+#include  "core/image_size.h"
 #include  "test_util.h"
 
+using namespace linuxdeploy::core;
 using namespace linuxdeploy::core::appdir;
 using namespace linuxdeploy::desktopfile;
 using namespace std::filesystem;
@@ -24,6 +34,27 @@ namespace {
         const auto resolvedPath = read_symlink(symlinkPath);
         EXPECT_TRUE(resolvedPath == targetPath) << resolvedPath << " " << targetPath;
     }
+
+    // the test files are built for the machine running the tests, so we can use the native ELF structures
+    size_t countLoadSegments(const path& elfFilePath) {
+        std::ifstream ifs(elfFilePath, std::ios::binary);
+
+        ElfW(Ehdr) ehdr{};
+        ifs.read(reinterpret_cast<char*>(&ehdr), sizeof(ehdr));
+        ifs.seekg(static_cast<std::streamoff>(ehdr.e_phoff));
+
+        size_t count = 0;
+
+        for (size_t i = 0; i < ehdr.e_phnum; ++i) {
+            ElfW(Phdr) phdr{};
+            ifs.read(reinterpret_cast<char*>(&phdr), sizeof(phdr));
+
+            if (phdr.p_type == PT_LOAD)
+                ++count;
+        }
+
+        return count;
+    }
 }
 
 namespace AppDirTest {
@@ -115,6 +146,43 @@ namespace AppDirTest {
         assertIsRegularFile(libTargetPath);
     }
 
+    TEST_F(AppDirUnitTestsFixture, deployExecutableStripsAndSetsRPath) {
+        // the rpath to the library directory doesn't fit into the existing structures, so a new segment is needed
+        const auto binaryDir = tmpAppDir / "usr/bin/a/rather/long/path/which/does/not/fit/";
+        appDir.deployExecutable(SIMPLE_EXECUTABLE_PATH, binaryDir);
+        ASSERT_TRUE(appDir.executeDeferredOperations());
+
+        const auto binaryTargetPath = binaryDir / path(SIMPLE_EXECUTABLE_PATH).filename();
+        const auto libTargetPath = tmpAppDir / "usr/lib" / path(SIMPLE_LIBRARY_PATH).filename();
+
+        const std::string binaryRPath = "$ORIGIN/../../../../../../../../../lib";
+        ASSERT_GT(binaryRPath.size(), elf_file::ElfFile(SIMPLE_EXECUTABLE_PATH).getRPath().size());
+
+        const std::map<path, std::string> expectedRPaths{
+            {binaryTargetPath, binaryRPath},
+            // the library had no rpath before
+            {libTargetPath, "$ORIGIN"},
+        };
+
+        for (const auto& [deployedPath, expectedRPath] : expectedRPaths) {
+            elf_file::ElfFile elfFile(deployedPath);
+
+            // both edits are made in a single pass
+            EXPECT_FALSE(elfFile.isStrippable()) << deployedPath;
+            EXPECT_EQ(elfFile.getDtRunPath(), expectedRPath) << deployedPath;
+            EXPECT_TRUE(elfFile.getDtRPath().empty()) << deployedPath;
+        }
+
+        EXPECT_EQ(countLoadSegments(binaryTargetPath), countLoadSegments(SIMPLE_EXECUTABLE_PATH) + 1);
+        EXPECT_EQ(countLoadSegments(libTargetPath), countLoadSegments(SIMPLE_LIBRARY_PATH) + 1);
+
+        // the executable must find the deployed library using the new rpath
+        linuxdeploy::subprocess::subprocess proc({binaryTargetPath.string()});
+        const auto result = proc.run();
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_string().rfind("Hello World", 0), 0);
+    }
+
     TEST_F(AppDirUnitTestsFixture, deployDesktopFile) {
         const DesktopFile desktopFile{SIMPLE_DESKTOP_ENTRY_PATH};
         appDir.deployDesktopFile(desktopFile);
@@ -176,6 +244,114 @@ namespace AppDirTest {
         assertIsRegularFile(targetPath);
     }
 
+    TEST_F(AppDirUnitTestsFixture, deduplicateFiles) {
+        const auto firstCopy = tmpAppDir / "usr/share/doc/a/file";
+        const auto secondCopy = tmpAppDir / "usr/share/doc/b/file";
+        const auto otherFile = tmpAppDir / "usr/share/doc/b/other_file";
+        ASSERT_TRUE(appDir.copyFile(SIMPLE_FILE_PATH, firstCopy));
+        ASSERT_TRUE(appDir.copyFile(SIMPLE_FILE_PATH, secondCopy));
+
+        {
+            std::ofstream ofs(otherFile);
+            ofs << "other content";
+        }
+
+        ASSERT_TRUE(appDir.deduplicateFiles());
+
+        EXPECT_TRUE(equivalent(firstCopy, secondCopy));
+        EXPECT_EQ(hard_link_count(firstCopy), 2);
+        EXPECT_EQ(hard_link_count(otherFile), 1);
+
+        // the file with the lexicographically smallest path is kept, so the symlink must point there
+        remove(secondCopy);
+        ASSERT_TRUE(appDir.copyFile(SIMPLE_FILE_PATH, secondCopy));
+        ASSERT_TRUE(appDir.deduplicateFiles(DEDUPLICATE_USING_SYMLINKS));
+
+        assertIsSymlink(relative(firstCopy, secondCopy.parent_path()), secondCopy);
+        assertIsRegularFile(firstCopy);
+    }
+
+    TEST_F(AppDirUnitTestsFixture, readImageSizeFromHeader) {
+        const auto pngSize = readImageSizeFromHeader(SIMPLE_ICON_PATH);
+        ASSERT_TRUE(pngSize.has_value());
+        EXPECT_EQ(pngSize->width, 16);
+        EXPECT_EQ(pngSize->height, 16);
+
+        // start of image, an APP0 segment which must be skipped, and a baseline frame header of a 64x32 image
+        const auto jpegPath = tmpAppDir / "icon.jpg";
+        {
+            const unsigned char data[] = {
+                0xFF, 0xD8,
+                0xFF, 0xE0, 0x00, 0x06, 'J', 'F', 'I', 'F',
+                0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x20, 0x00, 0x40, 0x01, 0x01, 0x11, 0x00,
+            };
+            std::ofstream ofs(jpegPath, std::ios::binary);
+            ofs.write(reinterpret_cast<const char*>(data), sizeof(data));
+        }
+
+        const auto jpegSize = readImageSizeFromHeader(jpegPath);
+        ASSERT_TRUE(jpegSize.has_value());
+        EXPECT_EQ(jpegSize->width, 64);
+        EXPECT_EQ(jpegSize->height, 32);
+
+        const auto xpmPath = tmpAppDir / "icon.xpm";
+        {
+            std::ofstream ofs(xpmPath);
+            ofs << "/* XPM */\nstatic char *icon[] = {\n/* columns rows colors chars-per-pixel */\n\"48 24 1 1\",\n\"  c None\",\n";
+        }
+
+        const auto xpmSize = readImageSizeFromHeader(xpmPath);
+        ASSERT_TRUE(xpmSize.has_value());
+        EXPECT_EQ(xpmSize->width, 48);
+        EXPECT_EQ(xpmSize->height, 24);
+
+        // other formats are not supported
+        EXPECT_FALSE(readImageSizeFromHeader(SIMPLE_ICON_PATH2).has_value());
+    }
+
+    TEST_F(AppDirUnitTestsFixture, downscaleImage) {
+        // 3x3 image: an opaque red pixel, and transparent green ones, which must not change the color
+        RgbaImage source;
+        source.width = 3;
+        source.height = 3;
+        source.pixels.resize(3 * 3 * 4);
+
+        for (size_t i = 0; i < 9; ++i) {
+            const uint8_t pixel[] = {0, 255, 0, 0};
+            std::copy(pixel, pixel + 4, source.pixels.begin() + i * 4);
+        }
+
+        const uint8_t red[] = {255, 0, 0, 255};
+        std::copy(red, red + 4, source.pixels.begin());
+
+        // every target pixel covers 1.5x1.5 source pixels, the top left one covers 1 of 2.25 opaque pixels
+        const auto target = downscaleImage(source, 2, 2);
+        ASSERT_EQ(target.width, 2);
+        ASSERT_EQ(target.height, 2);
+        ASSERT_EQ(target.pixels.size(), 2 * 2 * 4);
+
+        EXPECT_EQ(target.pixels[0], 255);
+        EXPECT_EQ(target.pixels[1], 0);
+        EXPECT_EQ(target.pixels[2], 0);
+        EXPECT_EQ(target.pixels[3], 113);
+
+        // the other pixels are transparent
+        for (size_t i = 4; i < target.pixels.size(); ++i) {
+            EXPECT_EQ(target.pixels[i], 0);
+        }
+
+        EXPECT_THROW(downscaleImage(source, 4, 4), std::invalid_argument);
+    }
+
+    TEST_F(AppDirUnitTestsFixture, generateIcons) {
+        ASSERT_TRUE(appDir.generateIcons(SIMPLE_ICON_PATH, "generated"));
+
+        // the master icon is 16x16, larger sizes must not be generated
+        const auto iconsPath = tmpAppDir / "usr/share/icons/hicolor";
+        assertIsRegularFile(iconsPath / "16x16/apps/generated.png");
+        EXPECT_FALSE(exists(iconsPath / "22x22/apps/generated.png"));
+    }
+
     TEST_F(AppDirUnitTestsFixture, testDeployingNonexistingFile) {
         const auto nonexistingFilePath = "/i/am/sure/this/file/does/not/exist";
         // it is very unlikely that this file does not exist, but we should probably check that...
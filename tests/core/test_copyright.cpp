@@ -0,0 +1,85 @@
+// system headers
+#include <cstdlib>
+#include <fstream>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "core/copyright/copyright_dpkgdatabase.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core::copyright;
+
+namespace LinuxDeployTest {
+    class DpkgDatabaseTest : public ::testing::Test {
+        public:
+            fs::path tempDir;
+            fs::path docDir;
+
+        public:
+            void SetUp() override {
+                tempDir = make_temporary_directory();
+
+                const auto adminDir = tempDir / "dpkg";
+                fs::create_directories(adminDir / "info");
+                setenv("DPKG_ADMINDIR", adminDir.c_str(), true);
+
+                docDir = tempDir / "doc";
+                fs::create_directories(docDir / "foo");
+                std::ofstream(docDir / "foo" / "copyright") << "foo copyright";
+
+                // like on merged /usr systems, lib is a symlink to usr/lib
+                fs::create_directories(tempDir / "usr" / "lib");
+                fs::create_directory_symlink("usr/lib", tempDir / "lib");
+
+                std::ofstream(tempDir / "usr" / "lib" / "libfoo.so.1") << "";
+                std::ofstream(tempDir / "usr" / "lib" / "libfoo-extra.so.1") << "";
+
+                // one list contains the canonical path, the other one the path below the symlink only
+                std::ofstream(adminDir / "info" / "foo.list") << (tempDir / "usr" / "lib" / "libfoo.so.1").string() << "\n";
+                std::ofstream(adminDir / "info" / "foo:amd64.list") << (tempDir / "lib" / "libfoo-extra.so.1").string() << "\n";
+
+                // files with other extensions are not file lists
+                std::ofstream(adminDir / "info" / "bar.md5sums") << (tempDir / "usr" / "lib" / "libbar.so.1").string() << "\n";
+            }
+
+            void TearDown() override {
+                unsetenv("DPKG_ADMINDIR");
+                fs::remove_all(tempDir);
+            }
+    };
+
+    TEST_F(DpkgDatabaseTest, checkAdminDirectoryFromEnvironment) {
+        EXPECT_EQ(DpkgDatabaseCopyrightFilesManager::getAdminDirectory(), tempDir / "dpkg");
+        EXPECT_TRUE(DpkgDatabaseCopyrightFilesManager::isAvailable());
+    }
+
+    TEST_F(DpkgDatabaseTest, checkLookupByCanonicalPath) {
+        DpkgDatabaseCopyrightFilesManager manager(docDir);
+
+        const std::vector<fs::path> expected{docDir / "foo" / "copyright"};
+
+        EXPECT_EQ(manager.getCopyrightFilesForPath(tempDir / "usr" / "lib" / "libfoo.so.1"), expected);
+
+        // the path is resolved before looking it up
+        EXPECT_EQ(manager.getCopyrightFilesForPath(tempDir / "lib" / "libfoo.so.1"), expected);
+    }
+
+    TEST_F(DpkgDatabaseTest, checkLookupByPathAsPassed) {
+        DpkgDatabaseCopyrightFilesManager manager(docDir);
+
+        // the database only contains the path below the symlink, the architecture is not part of the package name
+        EXPECT_EQ(
+            manager.getCopyrightFilesForPath(tempDir / "lib" / "libfoo-extra.so.1"),
+            std::vector<fs::path>{docDir / "foo" / "copyright"}
+        );
+    }
+
+    TEST_F(DpkgDatabaseTest, checkUnknownFiles) {
+        DpkgDatabaseCopyrightFilesManager manager(docDir);
+
+        EXPECT_TRUE(manager.getCopyrightFilesForPath(tempDir / "usr" / "lib" / "libbar.so.1").empty());
+        EXPECT_TRUE(manager.getCopyrightFilesForPath(tempDir / "does" / "not" / "exist").empty());
+    }
+}
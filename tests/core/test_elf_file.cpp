@@ -1,7 +1,17 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <link.h>
+
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 
 #include "linuxdeploy/core/elf_file.h"
+#include "linuxdeploy/subprocess/subprocess.h"
+#include "linuxdeploy/subprocess/util.h"
+#include "core/elf_editor.h"
+#include "test_util.h"
 
 using namespace std;
 using namespace linuxdeploy::core;
@@ -30,6 +40,76 @@ namespace {
     void expectThrowsElfFileErrorFileNotFound(const char* path) {
         expectElfFileConstructorThrowMessage(path, "No such file or directory: ");
     }
+
+    std::string readFile(const fs::path& path) {
+        std::ifstream ifs(path, std::ios::binary);
+        return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+    }
+
+    // the test files are built for the machine running the tests, so we can use the native ELF structures
+    ElfW(Ehdr) readElfHeader(const std::string& data) {
+        ElfW(Ehdr) ehdr{};
+        memcpy(&ehdr, data.data(), sizeof(ehdr));
+        return ehdr;
+    }
+
+    std::vector<ElfW(Shdr)> readSectionHeaders(const std::string& data) {
+        const auto ehdr = readElfHeader(data);
+
+        std::vector<ElfW(Shdr)> shdrs(ehdr.e_shnum);
+        memcpy(shdrs.data(), data.data() + ehdr.e_shoff, shdrs.size() * sizeof(ElfW(Shdr)));
+        return shdrs;
+    }
+
+    std::vector<std::string> getSectionNames(const fs::path& path) {
+        const auto data = readFile(path);
+        const auto shdrs = readSectionHeaders(data);
+        const auto& shstrtab = shdrs[readElfHeader(data).e_shstrndx];
+
+        std::vector<std::string> names;
+
+        for (const auto& shdr : shdrs)
+            names.emplace_back(data.c_str() + shstrtab.sh_offset + shdr.sh_name);
+
+        return names;
+    }
+
+    // the program headers including the raw data, i.e., everything the dynamic linker needs
+    std::string getProgramHeaders(const fs::path& path) {
+        const auto data = readFile(path);
+        const auto ehdr = readElfHeader(data);
+        return data.substr(ehdr.e_phoff, ehdr.e_phnum * sizeof(ElfW(Phdr)));
+    }
+
+    // swap the section header of the given name with the first one after the null section, which is a loaded one,
+    // like some post-link tools do
+    void moveSectionHeaderToFront(const fs::path& path, const std::string& name) {
+        auto data = readFile(path);
+        const auto ehdr = readElfHeader(data);
+        auto shdrs = readSectionHeaders(data);
+
+        const auto names = getSectionNames(path);
+        const auto it = std::find(names.begin(), names.end(), name);
+        ASSERT_NE(it, names.end());
+        ASSERT_NE(shdrs[1].sh_flags & SHF_ALLOC, 0);
+
+        std::swap(shdrs[1], shdrs[std::distance(names.begin(), it)]);
+        memcpy(data.data() + ehdr.e_shoff, shdrs.data(), shdrs.size() * sizeof(ElfW(Shdr)));
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs << data;
+    }
+
+    // run the executable, using the libraries in the given directory
+    void expectExecutableRuns(const fs::path& executablePath, const fs::path& libraryDir) {
+        auto env = linuxdeploy::subprocess::get_environment();
+        env["LD_LIBRARY_PATH"] = libraryDir.string();
+
+        linuxdeploy::subprocess::subprocess proc({executablePath.string()}, env);
+        const auto result = proc.run();
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_string().rfind("Hello World", 0), 0);
+    }
 }
 
 namespace LinuxDeployTest {
@@ -51,6 +131,92 @@ namespace LinuxDeployTest {
         EXPECT_FALSE(staticLibraryFile.isDynamicallyLinked());
     }
 
+    TEST_F(ElfFileTest, checkNeededLibraries) {
+        ElfFile executableFile(SIMPLE_EXECUTABLE_PATH);
+        EXPECT_THAT(executableFile.getNeededLibraries(), ::testing::Contains("libsimple_library.so"));
+        EXPECT_FALSE(executableFile.getInterpreter().empty());
+
+        ElfFile staticExecutableFile(SIMPLE_EXECUTABLE_STATIC_PATH);
+        EXPECT_TRUE(staticExecutableFile.getNeededLibraries().empty());
+        EXPECT_TRUE(staticExecutableFile.getRPath().empty());
+
+        ElfFile libraryFile(SIMPLE_LIBRARY_PATH);
+        EXPECT_EQ(libraryFile.getSoname(), "libsimple_library.so");
+    }
+
+    TEST_F(ElfFileTest, checkTraceDynamicDependencies) {
+        ElfFile executableFile(SIMPLE_EXECUTABLE_PATH);
+        const auto dependencies = executableFile.traceDynamicDependencies();
+
+        const auto hasDependency = [&dependencies](const std::string& prefix) {
+            return std::any_of(dependencies.begin(), dependencies.end(), [&prefix](const fs::path& path) {
+                return path.is_absolute() && path.filename().string().rfind(prefix, 0) == 0;
+            });
+        };
+
+        EXPECT_TRUE(hasDependency("libsimple_library.so"));
+        EXPECT_TRUE(hasDependency("libc.so"));
+
+        // the dynamic linker must never be part of the result
+        EXPECT_FALSE(hasDependency("ld-linux"));
+    }
+
+    TEST_F(ElfFileTest, checkSetRPath) {
+        const auto tempDir = make_temporary_directory();
+
+        const auto executablePath = tempDir / "simple_executable";
+        const auto libraryPath = tempDir / "libsimple_library.so";
+        fs::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        fs::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+
+        // the library has no rpath yet, so a new entry must be added
+        const std::string longRPath = "$ORIGIN/a/rather/long/path/which/does/not/fit/into/the/string/table:$ORIGIN";
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath(longRPath));
+        EXPECT_EQ(ElfFile(libraryPath).getDtRunPath(), longRPath);
+
+        // a shorter value is written in place
+        const auto librarySize = fs::file_size(libraryPath);
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(libraryPath).getDtRunPath(), "$ORIGIN");
+        EXPECT_EQ(fs::file_size(libraryPath), librarySize);
+
+        // the executable's existing runpath must be replaced with one that can find the library in its new location
+        EXPECT_TRUE(ElfFile(executablePath).setRPath(longRPath));
+        EXPECT_EQ(ElfFile(executablePath).getDtRunPath(), longRPath);
+        EXPECT_TRUE(ElfFile(executablePath).getDtRPath().empty());
+        EXPECT_EQ(ElfFile(executablePath).getRPath(), longRPath);
+
+        const auto dependencies = ElfFile(executablePath).traceDynamicDependencies();
+        EXPECT_THAT(dependencies, ::testing::Contains(libraryPath));
+
+        // the modified files must still be loadable
+        linuxdeploy::subprocess::subprocess proc({executablePath.string()});
+        const auto result = proc.run();
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_string().rfind("Hello World", 0), 0);
+
+        fs::remove_all(tempDir);
+    }
+
+    TEST_F(ElfFileTest, checkSetRPathDoesNotOverwriteMergedStrings) {
+        const auto tempDir = make_temporary_directory();
+
+        const auto libraryPath = tempDir / "libsimple_library.so";
+        fs::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+
+        // like linkers merging strings, the new value reuses the end of the soname in the string table
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("library.so"));
+        EXPECT_EQ(ElfFile(libraryPath).getDtRunPath(), "library.so");
+        EXPECT_EQ(ElfFile(libraryPath).getSoname(), "libsimple_library.so");
+
+        // a shorter value would fit, but writing it in place would truncate the soname
+        EXPECT_TRUE(ElfFile(libraryPath).setRPath("$ORIGIN"));
+        EXPECT_EQ(ElfFile(libraryPath).getDtRunPath(), "$ORIGIN");
+        EXPECT_EQ(ElfFile(libraryPath).getSoname(), "libsimple_library.so");
+
+        fs::remove_all(tempDir);
+    }
+
     TEST_F(ElfFileTest, checkInvalidElfHeaderOnEmptyFile) {
         expectThrowsElfFileErrorInvalidElfHeader("/dev/null");
     }
@@ -64,4 +230,87 @@ namespace LinuxDeployTest {
     TEST_F(ElfFileTest, checkFileNotFound) {
         expectThrowsElfFileErrorFileNotFound("/abc/def/ghi/jkl/mno/pqr/stu/vwx/yz");
     }
+
+    TEST_F(ElfFileTest, checkStrip) {
+        const auto tempDir = make_temporary_directory();
+
+        const auto executablePath = tempDir / "simple_executable";
+        const auto libraryPath = tempDir / "libsimple_library.so";
+        fs::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        fs::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+
+        for (const auto& path : {executablePath, libraryPath}) {
+            ASSERT_TRUE(ElfFile(path).isStrippable());
+            ASSERT_THAT(getSectionNames(path), ::testing::IsSupersetOf({".symtab", ".strtab"}));
+
+            const auto neededLibraries = ElfFile(path).getNeededLibraries();
+            const auto soname = ElfFile(path).getSoname();
+            const auto rpath = ElfFile(path).getRPath();
+            const auto programHeaders = getProgramHeaders(path);
+            const auto sizeBefore = fs::file_size(path);
+
+            {
+                ElfEditor editor(path);
+                EXPECT_TRUE(editor.strip());
+                editor.save();
+            }
+
+            EXPECT_FALSE(ElfFile(path).isStrippable());
+            EXPECT_THAT(getSectionNames(path), ::testing::Not(::testing::Contains(".symtab")));
+            EXPECT_THAT(getSectionNames(path), ::testing::Not(::testing::Contains(".strtab")));
+            EXPECT_THAT(getSectionNames(path), ::testing::Contains(".dynsym"));
+            EXPECT_LT(fs::file_size(path), sizeBefore);
+
+            // the data needed at runtime must be left untouched
+            EXPECT_EQ(ElfFile(path).getNeededLibraries(), neededLibraries);
+            EXPECT_EQ(ElfFile(path).getSoname(), soname);
+            EXPECT_EQ(ElfFile(path).getRPath(), rpath);
+            EXPECT_EQ(getProgramHeaders(path), programHeaders);
+
+            // stripping again does not change anything
+            EXPECT_FALSE(ElfEditor(path).strip());
+        }
+
+        EXPECT_EQ(ElfFile(libraryPath).getSoname(), "libsimple_library.so");
+        EXPECT_THAT(ElfFile(executablePath).getNeededLibraries(), ::testing::Contains("libsimple_library.so"));
+
+        expectExecutableRuns(executablePath, tempDir);
+
+        fs::remove_all(tempDir);
+    }
+
+    TEST_F(ElfFileTest, checkStripRejectsUnsupportedLayout) {
+        const auto tempDir = make_temporary_directory();
+
+        const auto executablePath = tempDir / "simple_executable";
+        const auto libraryPath = tempDir / "libsimple_library.so";
+        fs::copy_file(SIMPLE_EXECUTABLE_PATH, executablePath);
+        fs::copy_file(SIMPLE_LIBRARY_PATH, libraryPath);
+
+        // a section to remove precedes loaded sections, whose indices would change
+        moveSectionHeaderToFront(libraryPath, ".comment");
+        const auto contentsBefore = readFile(libraryPath);
+
+        EXPECT_THROW(ElfEditor(libraryPath).strip(), ElfEditError);
+
+        // the file must not have been modified, so that strip can be used instead
+        EXPECT_EQ(readFile(libraryPath), contentsBefore);
+        EXPECT_TRUE(ElfFile(libraryPath).isStrippable());
+
+        expectExecutableRuns(executablePath, tempDir);
+
+        // relocatable files need their symbol tables
+        const auto objectPath = tempDir / "object.o";
+        fs::copy_file(SIMPLE_LIBRARY_PATH, objectPath);
+        {
+            auto data = readFile(objectPath);
+            auto ehdr = readElfHeader(data);
+            ehdr.e_type = ET_REL;
+            memcpy(data.data(), &ehdr, sizeof(ehdr));
+            std::ofstream(objectPath, std::ios::binary | std::ios::trunc) << data;
+        }
+        EXPECT_THROW(ElfEditor(objectPath).strip(), ElfEditError);
+
+        fs::remove_all(tempDir);
+    }
 }
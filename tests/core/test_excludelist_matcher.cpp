@@ -0,0 +1,61 @@
+// system headers
+#include <string>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/util/excludelist_matcher.h"
+#include "linuxdeploy/util/util.h"
+#include "excludelist.h"
+
+using namespace linuxdeploy::util::misc;
+
+namespace LinuxDeployTest {
+    TEST(ExcludelistMatcherTest, checkMatchesLikeFnmatch) {
+        const std::vector<std::string> patterns = {"libc.so.6", "libfoo*", "*.so.42", "libbar*.so", "lib?az.so", "libq[ux]x.so"};
+        const ExcludelistMatcher matcher(patterns);
+
+        const std::vector<std::string> names = {
+            "libc.so.6", "libc.so.7", "libfoo", "libfoo.so.1", "libf", "libbaz.so.42", ".so.42", "libbar.so",
+            "libbar1.so", "libbar.so.1", "libbar/x.so", "libbaz.so", "libquux.so", "libqux.so", "libqax.so",
+        };
+
+        for (const auto& name : names) {
+            EXPECT_EQ(matcher.matches(name), linuxdeploy::util::isInExcludelist(name, patterns)) << name;
+        }
+
+        EXPECT_TRUE(matcher.matches(std::string("libfoo.so.1")));
+        EXPECT_FALSE(matcher.matches(std::string("libbar/x.so")));
+    }
+
+    TEST(ExcludelistMatcherTest, checkEmptyMatcher) {
+        EXPECT_FALSE(ExcludelistMatcher().matches(std::string("libc.so.6")));
+        EXPECT_FALSE(ExcludelistMatcher().matches(std::string()));
+    }
+
+    TEST(ExcludelistMatcherTest, checkGeneratedExcludelist) {
+        const ExcludelistMatcher matcher(generatedExcludelist);
+
+        // every entry, names which differ from them slightly, and libraries which are usually deployed
+        std::vector<std::string> names = {
+            "libQt5Core.so.5", "libgtk-3.so.0", "libglib-2.0.so.0", "libpng16.so.16", "libssl.so.3", "libfoo.so.1", "",
+        };
+
+        for (const auto& entry : generatedExcludelist) {
+            names.emplace_back(entry);
+            names.emplace_back(entry + ".1");
+            names.emplace_back(entry.substr(0, entry.size() - 1));
+            names.emplace_back("x" + entry);
+        }
+
+        for (const auto& name : names) {
+            EXPECT_EQ(matcher.matches(name), linuxdeploy::util::isInExcludelist(name, generatedExcludelist)) << name;
+        }
+
+        for (const auto& entry : generatedExcludelist) {
+            EXPECT_TRUE(matcher.matches(entry)) << entry;
+        }
+    }
+}
@@ -0,0 +1,224 @@
+// system headers
+#include <fstream>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/log/log.h"
+#include "core/file_copy.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core;
+using namespace linuxdeploy::log;
+
+namespace fs = std::filesystem;
+
+namespace LinuxDeployTest {
+    class FileCopyTest : public ::testing::Test {
+        public:
+            fs::path tempDir;
+            fs::path sourcePath;
+
+            // larger than the buffer used for read/write, so that the copy takes more than one step
+            std::string contents;
+
+        public:
+            void SetUp() override {
+                tempDir = make_temporary_directory();
+                sourcePath = tempDir / "source";
+
+                std::mt19937 generator(42);
+                std::uniform_int_distribution<int> distribution(0, 255);
+
+                contents.resize(300 * 1024 + 17);
+
+                for (auto& c : contents)
+                    c = static_cast<char>(distribution(generator));
+
+                writeFile(sourcePath, contents);
+                fs::permissions(sourcePath, fs::perms::owner_all | fs::perms::group_read | fs::perms::others_exec);
+            }
+
+            void TearDown() override {
+                fs::remove_all(tempDir);
+            }
+
+            static void writeFile(const fs::path& path, const std::string& data) {
+                std::ofstream ofs(path, std::ios::binary);
+                ofs << data;
+            }
+
+            static std::string readFile(const fs::path& path) {
+                std::ifstream ifs(path, std::ios::binary);
+                return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+            }
+
+            static mode_t getMode(const fs::path& path) {
+                struct stat statbuf{};
+
+                if (stat(path.c_str(), &statbuf) != 0)
+                    return 0;
+
+                return statbuf.st_mode & 07777;
+            }
+
+            // copies the source file to the given path, and returns the debug messages logged meanwhile
+            std::string copyAndCaptureLog(const fs::path& to) {
+                ldLog::setVerbosity(LD_DEBUG);
+                ::testing::internal::CaptureStdout();
+
+                copyFileContents(sourcePath, to);
+
+                const auto output = ::testing::internal::GetCapturedStdout();
+                ldLog::setVerbosity(LD_INFO);
+
+                return output;
+            }
+    };
+
+    TEST_F(FileCopyTest, checkCopy) {
+        const auto destinationPath = tempDir / "destination";
+
+        copyFileContents(sourcePath, destinationPath);
+
+        EXPECT_EQ(readFile(destinationPath), contents);
+        EXPECT_EQ(getMode(destinationPath), getMode(sourcePath));
+    }
+
+    TEST_F(FileCopyTest, checkCopyEmptyFile) {
+        const auto emptyFilePath = tempDir / "empty";
+        writeFile(emptyFilePath, "");
+
+        const auto destinationPath = tempDir / "destination";
+        writeFile(destinationPath, contents);
+
+        copyFileContents(emptyFilePath, destinationPath);
+
+        EXPECT_EQ(fs::file_size(destinationPath), 0);
+    }
+
+    TEST_F(FileCopyTest, checkCopyAcrossFilesystems) {
+        // the kernel can't clone the files, and copy_file_range may not be able to copy them either
+        if (!fs::is_directory("/dev/shm"))
+            GTEST_SKIP() << "/dev/shm is not available";
+
+        const auto otherTempDir = make_temporary_directory("/dev/shm/linuxdeploy-tests-XXXXXX");
+
+        struct stat tempDirStat{}, otherTempDirStat{};
+        ASSERT_EQ(stat(tempDir.c_str(), &tempDirStat), 0);
+        ASSERT_EQ(stat(otherTempDir.c_str(), &otherTempDirStat), 0);
+
+        if (tempDirStat.st_dev == otherTempDirStat.st_dev) {
+            fs::remove_all(otherTempDir);
+            GTEST_SKIP() << "/dev/shm is on the same filesystem as /tmp";
+        }
+
+        const auto destinationPath = otherTempDir / "destination";
+        copyFileContents(sourcePath, destinationPath);
+
+        EXPECT_EQ(readFile(destinationPath), contents);
+        EXPECT_EQ(getMode(destinationPath), getMode(sourcePath));
+
+        // and back again
+        const auto copyPath = tempDir / "copy";
+        copyFileContents(destinationPath, copyPath);
+
+        EXPECT_EQ(readFile(copyPath), contents);
+
+        fs::remove_all(otherTempDir);
+    }
+
+    TEST_F(FileCopyTest, checkExistingDestinationIsReplaced) {
+        const auto destinationPath = tempDir / "destination";
+
+        // the destination is longer than the source, and has other permissions
+        writeFile(destinationPath, contents + contents);
+        fs::permissions(destinationPath, fs::perms::owner_read | fs::perms::owner_write);
+
+        copyFileContents(sourcePath, destinationPath);
+
+        EXPECT_EQ(readFile(destinationPath), contents);
+        EXPECT_EQ(getMode(destinationPath), getMode(sourcePath));
+    }
+
+    TEST_F(FileCopyTest, checkModeIsPreservedDespiteUmask) {
+        const auto destinationPath = tempDir / "destination";
+
+        const auto previousUmask = umask(077);
+        copyFileContents(sourcePath, destinationPath);
+        umask(previousUmask);
+
+        EXPECT_EQ(getMode(sourcePath), 0741);
+        EXPECT_EQ(getMode(destinationPath), 0741);
+    }
+
+    TEST_F(FileCopyTest, checkCopyOntoItselfThrows) {
+        EXPECT_THROW(copyFileContents(sourcePath, sourcePath), fs::filesystem_error);
+
+        // the same file may be reached through other paths as well
+        const auto hardlinkPath = tempDir / "hardlink";
+        fs::create_hard_link(sourcePath, hardlinkPath);
+        EXPECT_THROW(copyFileContents(sourcePath, hardlinkPath), fs::filesystem_error);
+
+        const auto symlinkPath = tempDir / "symlink";
+        fs::create_symlink(sourcePath, symlinkPath);
+        EXPECT_THROW(copyFileContents(symlinkPath, sourcePath), fs::filesystem_error);
+
+        // the file must not have been truncated
+        EXPECT_EQ(readFile(sourcePath), contents);
+    }
+
+    TEST_F(FileCopyTest, checkInvalidSourcesThrow) {
+        EXPECT_THROW(copyFileContents(tempDir / "doesnotexist", tempDir / "destination"), fs::filesystem_error);
+        EXPECT_THROW(copyFileContents(tempDir, tempDir / "destination"), fs::filesystem_error);
+        EXPECT_FALSE(fs::exists(tempDir / "destination"));
+
+        EXPECT_THROW(copyFileContents(sourcePath, tempDir / "doesnotexist" / "destination"), fs::filesystem_error);
+    }
+
+    TEST_F(FileCopyTest, checkCopyMethodIsCached) {
+        const std::string message = "to copy files from device";
+
+        auto countMessages = [&message](const std::string& output) {
+            size_t count = 0;
+
+            for (auto pos = output.find(message); pos != std::string::npos; pos = output.find(message, pos + 1))
+                ++count;
+
+            return count;
+        };
+
+        // another test may have copied files within this filesystem already, then the method is known already
+        const auto firstOutput = copyAndCaptureLog(tempDir / "first");
+        EXPECT_LE(countMessages(firstOutput), 1) << firstOutput;
+
+        // now it's known for sure
+        const auto secondOutput = copyAndCaptureLog(tempDir / "second");
+        EXPECT_EQ(countMessages(secondOutput), 0) << secondOutput;
+
+        EXPECT_EQ(readFile(tempDir / "first"), contents);
+        EXPECT_EQ(readFile(tempDir / "second"), contents);
+    }
+
+    TEST_F(FileCopyTest, checkConcurrentCopies) {
+        std::vector<std::thread> threads;
+
+        for (int i = 0; i < 8; ++i) {
+            threads.emplace_back([this, i]() {
+                copyFileContents(sourcePath, tempDir / ("destination" + std::to_string(i)));
+            });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        for (int i = 0; i < 8; ++i)
+            EXPECT_EQ(readFile(tempDir / ("destination" + std::to_string(i))), contents);
+    }
+}
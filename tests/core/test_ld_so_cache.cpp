@@ -0,0 +1,220 @@
+// system headers
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/core/elf_file.h"
+#include "core/ld_so_cache.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core::elf_file;
+
+namespace fs = std::filesystem;
+
+namespace {
+    // flags ldconfig stores for libc6 libraries on x86_64 and i386
+    constexpr int32_t x86_64Flags = 0x0303;
+    constexpr int32_t i386Flags = 0x0003;
+
+    class CacheEntry {
+        public:
+            std::string key;
+            std::string value;
+            int32_t flags;
+            uint64_t hwcap;
+    };
+
+    template<typename T>
+    void appendValue(std::string& data, T value) {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    // the layouts are defined in glibc's sysdeps/generic/dl-cache.h
+    // in the new format, string offsets are relative to the beginning of its header
+    std::string buildNewFormat(const std::vector<CacheEntry>& entries) {
+        constexpr size_t headerSize = 48;
+        constexpr size_t entrySize = 24;
+
+        std::string strings;
+        std::string data;
+
+        data.append("glibc-ld.so.cache");
+        data.append("1.1");
+        appendValue<uint32_t>(data, entries.size());
+
+        const auto stringsOffset = headerSize + entries.size() * entrySize;
+
+        std::string entriesData;
+
+        for (const auto& entry : entries) {
+            appendValue<int32_t>(entriesData, entry.flags);
+            appendValue<uint32_t>(entriesData, stringsOffset + strings.size());
+            strings.append(entry.key).push_back('\0');
+            appendValue<uint32_t>(entriesData, stringsOffset + strings.size());
+            strings.append(entry.value).push_back('\0');
+            appendValue<uint32_t>(entriesData, 0);
+            appendValue<uint64_t>(entriesData, entry.hwcap);
+        }
+
+        appendValue<uint32_t>(data, strings.size());
+        data.append(headerSize - data.size(), '\0');
+
+        return data + entriesData + strings;
+    }
+
+    // in the old format, string offsets are relative to the end of the entries
+    // if given, the new format is appended like ldconfig does in the combined format, and the old format's strings
+    // are placed after it
+    std::string buildOldFormat(const std::vector<CacheEntry>& entries, const std::string& newFormat = "") {
+        constexpr size_t headerSize = 16;
+        constexpr size_t entrySize = 12;
+
+        std::string data("ld.so-1.7.0");
+        data.push_back('\0');
+        appendValue<uint32_t>(data, entries.size());
+
+        const auto entriesEnd = headerSize + entries.size() * entrySize;
+
+        std::string trailer;
+
+        if (!newFormat.empty()) {
+            trailer.append(((entriesEnd + 7) & ~size_t(7)) - entriesEnd, '\0');
+            trailer.append(newFormat);
+        }
+
+        std::string strings;
+
+        for (const auto& entry : entries) {
+            appendValue<int32_t>(data, entry.flags);
+            appendValue<uint32_t>(data, trailer.size() + strings.size());
+            strings.append(entry.key).push_back('\0');
+            appendValue<uint32_t>(data, trailer.size() + strings.size());
+            strings.append(entry.value).push_back('\0');
+        }
+
+        return data + trailer + strings;
+    }
+
+    fs::path writeCacheFile(const fs::path& dir, const std::string& data) {
+        const auto path = dir / "ld.so.cache";
+
+        std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+        ofs << data;
+
+        return path;
+    }
+
+    std::vector<fs::path> lookupX86_64(const LdSoCache& cache, const std::string& libraryName) {
+        return cache.lookup(libraryName, ELFCLASS64, EM_X86_64);
+    }
+}
+
+namespace LinuxDeployTest {
+    class LdSoCacheTest : public ::testing::Test {
+        public:
+            fs::path tempDir;
+
+        public:
+            void SetUp() override {
+                tempDir = make_temporary_directory();
+            }
+
+            void TearDown() override {
+                fs::remove_all(tempDir);
+            }
+    };
+
+    TEST_F(LdSoCacheTest, checkMissingAndInvalidFiles) {
+        LdSoCache missingCache("/abc/def/ghi/ld.so.cache");
+        EXPECT_FALSE(missingCache.isValid());
+        EXPECT_TRUE(lookupX86_64(missingCache, "libc.so.6").empty());
+
+        LdSoCache invalidCache(SIMPLE_FILE_PATH);
+        EXPECT_FALSE(invalidCache.isValid());
+
+        // the header claims more entries than the file contains
+        auto truncated = buildNewFormat({{"libfoo.so.1", "/lib/libfoo.so.1", x86_64Flags, 0}});
+        truncated.resize(truncated.size() - 30);
+        EXPECT_FALSE(LdSoCache(writeCacheFile(tempDir, truncated)).isValid());
+    }
+
+    TEST_F(LdSoCacheTest, checkNewFormat) {
+        LdSoCache cache(writeCacheFile(tempDir, buildNewFormat({
+            {"libfoo.so.1", "/lib/x86_64-linux-gnu/libfoo.so.1", x86_64Flags, 0},
+            {"libfoo.so.1", "/lib/i386-linux-gnu/libfoo.so.1", i386Flags, 0},
+            {"libbar.so.2", "/lib/x86_64-linux-gnu/libbar.so.2", x86_64Flags, 0},
+        })));
+
+        ASSERT_TRUE(cache.isValid());
+        EXPECT_EQ(cache.size(), 3);
+
+        // entries for other ABIs are skipped
+        EXPECT_EQ(lookupX86_64(cache, "libfoo.so.1"), std::vector<fs::path>{"/lib/x86_64-linux-gnu/libfoo.so.1"});
+        EXPECT_EQ(cache.lookup("libfoo.so.1", ELFCLASS32, EM_386), std::vector<fs::path>{"/lib/i386-linux-gnu/libfoo.so.1"});
+        EXPECT_EQ(lookupX86_64(cache, "libbar.so.2"), std::vector<fs::path>{"/lib/x86_64-linux-gnu/libbar.so.2"});
+        EXPECT_TRUE(lookupX86_64(cache, "libdoesnotexist.so.42").empty());
+    }
+
+    TEST_F(LdSoCacheTest, checkHwcapEntriesAreReturnedLast) {
+        // ldconfig puts the hardware specific entries first, as the dynamic linker prefers them
+        LdSoCache cache(writeCacheFile(tempDir, buildNewFormat({
+            {"libfoo.so.1", "/lib/glibc-hwcaps/x86-64-v3/libfoo.so.1", x86_64Flags, 1ull << 62},
+            {"libfoo.so.1", "/lib/haswell/libfoo.so.1", x86_64Flags, 0x2},
+            {"libfoo.so.1", "/lib/libfoo.so.1", x86_64Flags, 0},
+        })));
+
+        const std::vector<fs::path> expected{
+            "/lib/libfoo.so.1",
+            "/lib/glibc-hwcaps/x86-64-v3/libfoo.so.1",
+            "/lib/haswell/libfoo.so.1",
+        };
+
+        EXPECT_EQ(lookupX86_64(cache, "libfoo.so.1"), expected);
+    }
+
+    TEST_F(LdSoCacheTest, checkOldFormat) {
+        // the old format has no ABI specific flags for x86_64, only the library type
+        LdSoCache cache(writeCacheFile(tempDir, buildOldFormat({
+            {"libfoo.so.1", "/lib/libfoo.so.1", i386Flags, 0},
+        })));
+
+        ASSERT_TRUE(cache.isValid());
+        EXPECT_EQ(cache.lookup("libfoo.so.1", ELFCLASS32, EM_386), std::vector<fs::path>{"/lib/libfoo.so.1"});
+    }
+
+    TEST_F(LdSoCacheTest, checkCombinedFormatPrefersNewFormat) {
+        const auto newFormat = buildNewFormat({
+            {"libfoo.so.1", "/new/libfoo.so.1", x86_64Flags, 0},
+        });
+
+        LdSoCache cache(writeCacheFile(tempDir, buildOldFormat({
+            {"libfoo.so.1", "/old/libfoo.so.1", i386Flags, 0},
+            {"libbar.so.1", "/old/libbar.so.1", i386Flags, 0},
+        }, newFormat)));
+
+        ASSERT_TRUE(cache.isValid());
+        EXPECT_EQ(cache.size(), 1);
+        EXPECT_EQ(lookupX86_64(cache, "libfoo.so.1"), std::vector<fs::path>{"/new/libfoo.so.1"});
+        EXPECT_TRUE(cache.lookup("libbar.so.1", ELFCLASS32, EM_386).empty());
+    }
+
+    TEST_F(LdSoCacheTest, checkSystemCache) {
+        LdSoCache systemCache;
+        if (!systemCache.isValid())
+            GTEST_SKIP() << "system has no usable ld.so.cache";
+
+        // every system using glibc has libc.so.6 in its cache
+        ElfFile executableFile(SIMPLE_EXECUTABLE_PATH);
+        const auto paths = systemCache.lookup("libc.so.6", executableFile.getElfClass(), executableFile.getElfMachine());
+        ASSERT_FALSE(paths.empty());
+        EXPECT_TRUE(fs::exists(paths.front()));
+
+        EXPECT_TRUE(systemCache.lookup("libdoesnotexist.so.42", executableFile.getElfClass(), executableFile.getElfMachine()).empty());
+    }
+}
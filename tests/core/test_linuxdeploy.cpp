@@ -1,3 +1,8 @@
+#include <cctype>
+#include <set>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "core.h"
@@ -8,6 +13,38 @@ using namespace linuxdeploy::core;
 
 namespace fs = std::filesystem;
 
+namespace {
+    // plugin which is never run, only its capabilities are used
+    class FakePlugin : public linuxdeploy::plugin::IPlugin {
+        private:
+            const std::set<std::string> pluginCapabilities;
+
+        public:
+            explicit FakePlugin(std::set<std::string> capabilities) : IPlugin(""), pluginCapabilities(std::move(capabilities)) {}
+
+            fs::path path() const override { return {}; }
+            int apiLevel() const override { return 0; }
+            linuxdeploy::plugin::PLUGIN_TYPE pluginType() const override { return linuxdeploy::plugin::INPUT_TYPE; }
+            std::string pluginTypeString() const override { return "input"; }
+            std::set<std::string> capabilities() const override { return pluginCapabilities; }
+            int run(const fs::path&) override { return 1; }
+    };
+
+    // the names of the plugins in each batch
+    std::vector<std::vector<std::string>> getBatchNames(const std::vector<linuxdeploy::NamedPlugin>& plugins, size_t maxParallelPlugins) {
+        std::vector<std::vector<std::string>> rv;
+
+        for (const auto& batch : linuxdeploy::batchPlugins(plugins, maxParallelPlugins)) {
+            rv.emplace_back();
+
+            for (const auto& plugin : batch)
+                rv.back().emplace_back(plugin.first);
+        }
+
+        return rv;
+    }
+}
+
 namespace LinuxDeployTest {
     class IntegrationTests : public ::testing::Test {
     public:
@@ -106,4 +143,42 @@ namespace LinuxDeployTest {
 
         ASSERT_TRUE(exists(target_apprun_path));
     }
+
+    class PluginBatchesTest : public ::testing::Test {
+    public:
+        FakePlugin parallelSafePlugin{{linuxdeploy::plugin::PARALLEL_SAFE_CAPABILITY}};
+        FakePlugin regularPlugin{{}};
+
+        std::vector<linuxdeploy::NamedPlugin> makePlugins(const std::string& names) {
+            // upper case names are parallel safe
+            std::vector<linuxdeploy::NamedPlugin> plugins;
+
+            for (const auto name : names) {
+                plugins.emplace_back(std::string(1, name), isupper(name) ? &parallelSafePlugin : &regularPlugin);
+            }
+
+            return plugins;
+        }
+    };
+
+    TEST_F(PluginBatchesTest, checkConsecutiveParallelSafePluginsAreBatched) {
+        const std::vector<std::vector<std::string>> expected{{"A", "B"}, {"c"}, {"D", "E", "F"}, {"g"}, {"h"}, {"I"}};
+        EXPECT_EQ(getBatchNames(makePlugins("ABcDEFghI"), 9), expected);
+
+        // the number of plugins which run at once is limited when they're run, not by the batches
+        EXPECT_EQ(getBatchNames(makePlugins("ABcDEFghI"), 2), expected);
+
+        EXPECT_TRUE(linuxdeploy::batchPlugins({}, 4).empty());
+    }
+
+    TEST_F(PluginBatchesTest, checkRegularPluginsRunOnTheirOwn) {
+        const std::vector<std::vector<std::string>> expected{{"a"}, {"b"}, {"c"}};
+        EXPECT_EQ(getBatchNames(makePlugins("abc"), 3), expected);
+    }
+
+    TEST_F(PluginBatchesTest, checkSingleJobSerializesPlugins) {
+        const std::vector<std::vector<std::string>> expected{{"A"}, {"B"}, {"c"}, {"D"}};
+        EXPECT_EQ(getBatchNames(makePlugins("ABcD"), 1), expected);
+        EXPECT_EQ(getBatchNames(makePlugins("ABcD"), 0), expected);
+    }
 }
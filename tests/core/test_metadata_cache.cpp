@@ -0,0 +1,165 @@
+// system headers
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "core/metadata_cache.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core;
+
+namespace fs = std::filesystem;
+
+namespace LinuxDeployTest {
+    class MetadataCacheTest : public ::testing::Test {
+        public:
+            fs::path tempDir;
+            fs::path cacheFilePath;
+            fs::path filePath;
+
+            const std::vector<std::string> value{"a", "", "libc.so.6"};
+
+        public:
+            void SetUp() override {
+                tempDir = make_temporary_directory();
+                cacheFilePath = tempDir / "cache" / "metadata.cache";
+
+                filePath = tempDir / "file.txt";
+                fs::copy_file(SIMPLE_FILE_PATH, filePath);
+            }
+
+            void TearDown() override {
+                fs::remove_all(tempDir);
+            }
+
+            // stores an entry for the test file in a new cache file
+            void writeCacheFile() {
+                MetadataCache cache(cacheFilePath);
+                cache.put("test", filePath, value);
+                ASSERT_TRUE(cache.save());
+                ASSERT_EQ(MetadataCache(cacheFilePath).get("test", filePath), value);
+            }
+
+            void overwriteCacheFile(size_t offset, const std::string& data) {
+                std::fstream fs(cacheFilePath, std::ios::in | std::ios::out | std::ios::binary);
+                fs.seekp(static_cast<std::streamoff>(offset));
+                fs.write(data.data(), static_cast<std::streamsize>(data.size()));
+            }
+    };
+
+    TEST_F(MetadataCacheTest, checkPutGetAndSave) {
+        {
+            MetadataCache cache(cacheFilePath);
+            EXPECT_FALSE(cache.get("test", filePath).has_value());
+
+            cache.put("test", filePath, value);
+            EXPECT_EQ(cache.get("test", filePath), value);
+            EXPECT_FALSE(cache.get("other", filePath).has_value());
+
+            // entries for missing files are not stored
+            cache.put("test", tempDir / "missing", value);
+            EXPECT_FALSE(cache.get("test", tempDir / "missing").has_value());
+
+            EXPECT_TRUE(cache.save());
+        }
+
+        // the entries must be loaded from the file
+        EXPECT_EQ(MetadataCache(cacheFilePath).get("test", filePath), value);
+    }
+
+    TEST_F(MetadataCacheTest, checkChangedFilesInvalidateEntries) {
+        writeCacheFile();
+
+        // a new modification time invalidates the entry, even if the size is the same
+        const auto sizeBefore = fs::file_size(filePath);
+        fs::last_write_time(filePath, fs::last_write_time(filePath) + std::chrono::seconds(10));
+        ASSERT_EQ(fs::file_size(filePath), sizeBefore);
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+
+        writeCacheFile();
+
+        // so does new content
+        {
+            std::ofstream ofs(filePath, std::ios::app);
+            ofs << "changed";
+        }
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+    }
+
+    TEST_F(MetadataCacheTest, checkInvalidCacheFilesAreIgnored) {
+        // not a cache file at all
+        fs::create_directories(cacheFilePath.parent_path());
+        fs::copy_file(SIMPLE_FILE_PATH, cacheFilePath);
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+
+        // truncated file
+        writeCacheFile();
+        fs::resize_file(cacheFilePath, fs::file_size(cacheFilePath) - 5);
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+
+        // entry pointing outside of the data, the first entry's key offset follows the header and the file identity
+        writeCacheFile();
+        overwriteCacheFile(24 + 32, std::string(4, '\xff'));
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+
+        // unsupported version
+        writeCacheFile();
+        overwriteCacheFile(8, std::string(4, '\x7f'));
+        EXPECT_FALSE(MetadataCache(cacheFilePath).get("test", filePath).has_value());
+
+        // an invalid file is replaced once the cache is saved
+        {
+            MetadataCache cache(cacheFilePath);
+            cache.put("test", filePath, value);
+            EXPECT_TRUE(cache.save());
+        }
+        EXPECT_EQ(MetadataCache(cacheFilePath).get("test", filePath), value);
+    }
+
+    TEST_F(MetadataCacheTest, checkConcurrentPut) {
+        constexpr size_t threadsCount = 8;
+        constexpr size_t entriesPerThread = 200;
+
+        auto makeKind = [](size_t thread, size_t entry) {
+            return "kind-" + std::to_string(thread) + "-" + std::to_string(entry);
+        };
+
+        {
+            MetadataCache cache(cacheFilePath);
+
+            std::vector<std::thread> threads;
+
+            for (size_t i = 0; i < threadsCount; ++i) {
+                threads.emplace_back([&cache, &makeKind, this, i]() {
+                    for (size_t j = 0; j < entriesPerThread; ++j) {
+                        cache.put(makeKind(i, j), filePath, {std::to_string(i), std::to_string(j)});
+
+                        // entries from other threads are read at the same time
+                        (void) cache.get(makeKind((i + 1) % threadsCount, j), filePath);
+                    }
+                });
+            }
+
+            for (auto& thread : threads) {
+                thread.join();
+            }
+
+            EXPECT_TRUE(cache.save());
+        }
+
+        MetadataCache cache(cacheFilePath);
+
+        for (size_t i = 0; i < threadsCount; ++i) {
+            for (size_t j = 0; j < entriesPerThread; ++j) {
+                const std::vector<std::string> expected{std::to_string(i), std::to_string(j)};
+                EXPECT_EQ(cache.get(makeKind(i, j), filePath), expected);
+            }
+        }
+    }
+}
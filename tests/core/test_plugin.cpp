@@ -0,0 +1,262 @@
+// system headers
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/plugin/plugin.h"
+#include "core/metadata_cache.h"
+#include "plugin/plugin_shared_library.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core;
+using namespace linuxdeploy::core::appdir;
+using namespace linuxdeploy::plugin;
+
+namespace fs = std::filesystem;
+
+namespace LinuxDeployTest {
+    class Type0PluginCacheTest : public ::testing::Test {
+        public:
+            // the metadata cache is configured once per process, so all tests share it
+            static fs::path cacheDir;
+
+            fs::path pluginsDir;
+            std::string originalPath;
+
+        public:
+            static void SetUpTestSuite() {
+                cacheDir = make_temporary_directory();
+                setenv("LINUXDEPLOY_CACHE_DIR", cacheDir.c_str(), true);
+                ASSERT_NE(MetadataCache::fromEnvironment(), nullptr);
+            }
+
+            static void TearDownTestSuite() {
+                fs::remove_all(cacheDir);
+            }
+
+            void SetUp() override {
+                // every test uses its own plugins, so the cache entries of other tests don't interfere
+                pluginsDir = make_temporary_directory();
+
+                originalPath = getenv("PATH");
+                setenv("PATH", pluginsDir.c_str(), true);
+            }
+
+            void TearDown() override {
+                setenv("PATH", originalPath.c_str(), true);
+                fs::remove_all(pluginsDir);
+            }
+
+            // writes an input plugin which records each of its invocations in a log file
+            fs::path writePlugin(const std::string& name, const std::string& capabilities) {
+                const auto path = pluginsDir / ("linuxdeploy-plugin-" + name + ".sh");
+
+                std::ofstream ofs(path);
+                ofs << "#!/bin/sh" << std::endl
+                    << "echo \"$1\" >> \"" << getLogPath(name).string() << "\"" << std::endl
+                    << "case \"$1\" in" << std::endl
+                    << "    --plugin-api-version) echo 0 ;;" << std::endl
+                    << "    --plugin-type) echo input ;;" << std::endl
+                    << "    --plugin-capabilities) echo \"" << capabilities << "\" ;;" << std::endl
+                    << "    --appdir) echo \"$TEST_PLUGIN_VARIABLE\" > \"" << getLogPath(name).string() << ".env\" ;;" << std::endl
+                    << "esac" << std::endl;
+                ofs.close();
+
+                fs::permissions(path, fs::perms::owner_all);
+
+                return path;
+            }
+
+            fs::path getLogPath(const std::string& name) const {
+                return pluginsDir / (name + ".log");
+            }
+
+            // number of times the plugin has been run
+            size_t countInvocations(const std::string& name) const {
+                std::ifstream ifs(getLogPath(name));
+
+                size_t count = 0;
+
+                for (std::string line; std::getline(ifs, line);)
+                    ++count;
+
+                return count;
+            }
+    };
+
+    fs::path Type0PluginCacheTest::cacheDir;
+
+    TEST_F(Type0PluginCacheTest, checkOnlyRequestedPluginsAreProbed) {
+        writePlugin("foo", "");
+        writePlugin("bar", "");
+
+        EXPECT_TRUE(findPlugins({}).empty());
+
+        const auto plugins = findPlugins({"foo"});
+        ASSERT_EQ(plugins.size(), 1);
+        ASSERT_NE(plugins.find("foo"), plugins.end());
+
+        // --plugin-api-version, --plugin-type and --plugin-capabilities
+        EXPECT_EQ(countInvocations("foo"), 3);
+        EXPECT_EQ(countInvocations("bar"), 0);
+    }
+
+    TEST_F(Type0PluginCacheTest, checkProbeResultsAreCached) {
+        const auto pluginPath = writePlugin("foo", PARALLEL_SAFE_CAPABILITY);
+
+        const auto plugins = findPlugins({"foo"});
+        ASSERT_EQ(plugins.size(), 1);
+        EXPECT_TRUE(plugins.at("foo")->hasCapability(PARALLEL_SAFE_CAPABILITY));
+
+        const auto invocations = countInvocations("foo");
+        ASSERT_GT(invocations, 0);
+
+        // the results are saved with the API level, the type and the capabilities
+        const std::vector<std::string> expected{"0", "input", PARALLEL_SAFE_CAPABILITY};
+        EXPECT_EQ(MetadataCache(cacheDir / "metadata.cache").get("plugin", pluginPath), expected);
+
+        const auto cachedPlugins = findPlugins({"foo"});
+        ASSERT_EQ(cachedPlugins.size(), 1);
+
+        const auto* plugin = cachedPlugins.at("foo");
+        EXPECT_EQ(plugin->path(), pluginPath);
+        EXPECT_EQ(plugin->apiLevel(), 0);
+        EXPECT_EQ(plugin->pluginType(), INPUT_TYPE);
+        EXPECT_TRUE(plugin->hasCapability(PARALLEL_SAFE_CAPABILITY));
+
+        EXPECT_EQ(countInvocations("foo"), invocations);
+    }
+
+    TEST_F(Type0PluginCacheTest, checkModifiedPluginsAreProbedAgain) {
+        const auto pluginPath = writePlugin("foo", PARALLEL_SAFE_CAPABILITY);
+
+        ASSERT_EQ(findPlugins({"foo"}).size(), 1);
+        const auto invocations = countInvocations("foo");
+
+        // an update of the plugin may change its capabilities
+        ASSERT_EQ(writePlugin("foo", ""), pluginPath);
+
+        const auto plugins = findPlugins({"foo"});
+        ASSERT_EQ(plugins.size(), 1);
+        EXPECT_FALSE(plugins.at("foo")->hasCapability(PARALLEL_SAFE_CAPABILITY));
+
+        EXPECT_GT(countInvocations("foo"), invocations);
+    }
+
+    TEST_F(Type0PluginCacheTest, checkOutdatedCacheEntriesAreProbedAgain) {
+        const auto pluginPath = writePlugin("foo", PARALLEL_SAFE_CAPABILITY);
+
+        // previous versions stored the API level and the type only, the capabilities would be missing
+        MetadataCache::fromEnvironment()->put("plugin", pluginPath, {"0", "input"});
+
+        const auto plugins = findPlugins({"foo"});
+        ASSERT_EQ(plugins.size(), 1);
+        EXPECT_TRUE(plugins.at("foo")->hasCapability(PARALLEL_SAFE_CAPABILITY));
+        EXPECT_GT(countInvocations("foo"), 0);
+
+        const std::vector<std::string> expected{"0", "input", PARALLEL_SAFE_CAPABILITY};
+        EXPECT_EQ(MetadataCache::fromEnvironment()->get("plugin", pluginPath), expected);
+    }
+
+    TEST_F(Type0PluginCacheTest, checkUnsupportedPluginsAreCached) {
+        const auto pluginPath = writePlugin("foo", "");
+
+        // an empty entry means that the plugin doesn't implement a supported API level
+        MetadataCache::fromEnvironment()->put("plugin", pluginPath, {});
+
+        EXPECT_TRUE(findPlugins({"foo"}).empty());
+        EXPECT_EQ(countInvocations("foo"), 0);
+    }
+
+    TEST_F(Type0PluginCacheTest, checkRunPassesEnvironment) {
+        writePlugin("foo", "");
+
+        const auto plugins = findPlugins({"foo"});
+        ASSERT_EQ(plugins.size(), 1);
+
+        // the variables are passed to the plugin only, the environment of this process is left alone
+        EXPECT_EQ(plugins.at("foo")->run(pluginsDir, {{"TEST_PLUGIN_VARIABLE", "test value"}}), 0);
+        EXPECT_EQ(getenv("TEST_PLUGIN_VARIABLE"), nullptr);
+
+        std::ifstream ifs(getLogPath("foo").string() + ".env");
+        std::string value;
+        std::getline(ifs, value);
+
+        EXPECT_EQ(value, "test value");
+    }
+
+    class SharedLibraryPluginTest : public ::testing::Test {
+        public:
+            const fs::path pluginsDir = TEST_PLUGINS_DIR;
+            fs::path tmpAppDir;
+
+        public:
+            void SetUp() override {
+                tmpAppDir = make_temporary_directory();
+            }
+
+            void TearDown() override {
+                fs::remove_all(tmpAppDir);
+            }
+
+            fs::path getPluginPath(const std::string& name) const {
+                return pluginsDir / ("linuxdeploy-plugin-" + name + ".so");
+            }
+    };
+
+    TEST_F(SharedLibraryPluginTest, checkLoadPlugin) {
+        const auto pluginPath = getPluginPath("test");
+        ASSERT_TRUE(SharedLibraryPlugin::isSharedLibraryPlugin(pluginPath));
+
+        const SharedLibraryPlugin plugin(pluginPath);
+        EXPECT_EQ(plugin.path(), pluginPath);
+        EXPECT_EQ(plugin.apiLevel(), 1);
+        EXPECT_EQ(plugin.pluginType(), INPUT_TYPE);
+        EXPECT_EQ(plugin.pluginTypeString(), "input");
+
+        // the plugin uses the AppDir instance, so it must not run concurrently with other plugins
+        EXPECT_FALSE(plugin.hasCapability(PARALLEL_SAFE_CAPABILITY));
+
+        const SharedLibraryPlugin outputPlugin(getPluginPath("test-output"));
+        EXPECT_EQ(outputPlugin.pluginType(), OUTPUT_TYPE);
+        EXPECT_EQ(outputPlugin.pluginTypeString(), "output");
+
+        // the factory function loads shared libraries rather than running them
+        auto* instance = createPluginInstance(pluginPath);
+        ASSERT_NE(dynamic_cast<SharedLibraryPlugin*>(instance), nullptr);
+        delete dynamic_cast<SharedLibraryPlugin*>(instance);
+    }
+
+    TEST_F(SharedLibraryPluginTest, checkRunQueuesOperationsInAppDir) {
+        AppDir appDir(tmpAppDir);
+
+        SharedLibraryPlugin plugin(getPluginPath("test"));
+        ASSERT_EQ(plugin.run(appDir), 0);
+
+        // the plugin checks that its operations are queued, they are executed once it has returned
+        // it uses the default destination for one library, and one relative to the AppDir for the other one
+        EXPECT_TRUE(fs::is_regular_file(tmpAppDir / "usr/lib" / fs::path(SIMPLE_LIBRARY_PATH).filename()));
+        EXPECT_TRUE(fs::is_regular_file(tmpAppDir / "usr/lib/relative" / fs::path(SIMPLE_LIBRARY_STRIPPED_PATH).filename()));
+    }
+
+    TEST_F(SharedLibraryPluginTest, checkInvalidPluginsAreRejected) {
+        // libraries which don't implement the API at all, or another API level, may be loaded with other plugin types
+        EXPECT_THROW(SharedLibraryPlugin(SIMPLE_LIBRARY_PATH), WrongApiLevelError);
+        EXPECT_THROW(SharedLibraryPlugin(getPluginPath("test-wrongapi")), WrongApiLevelError);
+        EXPECT_EQ(createPluginInstance(getPluginPath("test-wrongapi")), nullptr);
+
+        EXPECT_THROW(SharedLibraryPlugin(getPluginPath("test-incomplete")), PluginError);
+        EXPECT_THROW(SharedLibraryPlugin(getPluginPath("test-invalidtype")), PluginError);
+        EXPECT_THROW(SharedLibraryPlugin(getPluginPath("doesnotexist")), PluginError);
+
+        // these errors are not caused by the API level, so the factory function must not ignore them
+        EXPECT_THROW(createPluginInstance(getPluginPath("test-incomplete")), PluginError);
+        EXPECT_THROW(createPluginInstance(getPluginPath("test-invalidtype")), PluginError);
+    }
+}
@@ -0,0 +1,174 @@
+// system headers
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/core/appdir.h"
+#include "linuxdeploy/core/elf_file.h"
+#include "server.h"
+#include "test_util.h"
+
+using namespace linuxdeploy::core;
+using namespace linuxdeploy::core::appdir;
+using namespace linuxdeploy::server;
+
+namespace fs = std::filesystem;
+
+namespace LinuxDeployTest {
+    class ServerTest : public ::testing::Test {
+        public:
+            fs::path tmpAppDir;
+            AppDir appDir;
+
+        public:
+            ServerTest() : tmpAppDir(make_temporary_directory()), appDir(tmpAppDir) {}
+
+            void TearDown() override {
+                fs::remove_all(tmpAppDir);
+            }
+
+            // copies the test executable into the AppDir, like a plugin would do
+            fs::path addExistingExecutable() {
+                const auto path = tmpAppDir / "usr/bin" / fs::path(SIMPLE_EXECUTABLE_PATH).filename();
+                fs::create_directories(path.parent_path());
+                fs::copy_file(SIMPLE_EXECUTABLE_PATH, path);
+                return path;
+            }
+    };
+
+    TEST_F(ServerTest, checkEnvironmentIsNotModified) {
+        fs::path socketPath;
+
+        {
+            Server server(appDir);
+            socketPath = server.socketPath();
+            EXPECT_TRUE(fs::exists(socketPath));
+
+            // the path is passed to the plugins instead
+            EXPECT_EQ(getenv(SOCKET_ENV_VAR), nullptr);
+        }
+
+        EXPECT_FALSE(fs::exists(socketPath));
+    }
+
+    TEST_F(ServerTest, checkRequestForAnotherAppDirIsUnsupported) {
+        const auto otherAppDir = make_temporary_directory();
+
+        Server server(appDir);
+
+        Request request;
+        request.appDirPath = otherAppDir;
+        request.commands.emplace_back(DEPLOY_LIBRARY_COMMAND, SIMPLE_LIBRARY_PATH);
+
+        // the nested process has to do the work on its own then
+        EXPECT_FALSE(sendRequest(server.socketPath(), request).has_value());
+        EXPECT_FALSE(fs::exists(otherAppDir / "usr/lib" / fs::path(SIMPLE_LIBRARY_PATH).filename()));
+
+        // so does it if there is no server at all
+        EXPECT_FALSE(sendRequest(otherAppDir / "socket", request).has_value());
+
+        fs::remove_all(otherAppDir);
+    }
+
+    TEST_F(ServerTest, checkDeployLibraryRequest) {
+        Server server(appDir);
+
+        Request request;
+        request.appDirPath = tmpAppDir;
+        request.commands.emplace_back(DEPLOY_LIBRARY_COMMAND, SIMPLE_LIBRARY_PATH);
+
+        EXPECT_EQ(sendRequest(server.socketPath(), request), 0);
+
+        // the deferred operations have been executed before the response was sent
+        const auto libraryPath = tmpAppDir / "usr/lib" / fs::path(SIMPLE_LIBRARY_PATH).filename();
+        ASSERT_TRUE(fs::is_regular_file(libraryPath));
+        EXPECT_EQ(elf_file::ElfFile(libraryPath).getRPath(), "$ORIGIN");
+
+        // unknown commands fail the request
+        request.commands = {{"unknown", ""}};
+        EXPECT_EQ(sendRequest(server.socketPath(), request), 1);
+    }
+
+    TEST_F(ServerTest, checkExistingFilesAreProcessedOnce) {
+        const auto executablePath = addExistingExecutable();
+
+        Server server(appDir);
+
+        Request request;
+        request.appDirPath = tmpAppDir;
+
+        // the dependencies of the existing executable are deployed, and its rpath is set
+        ASSERT_EQ(sendRequest(server.socketPath(), request), 0);
+        EXPECT_TRUE(fs::is_regular_file(tmpAppDir / "usr/lib" / fs::path(SIMPLE_LIBRARY_PATH).filename()));
+        EXPECT_EQ(elf_file::ElfFile(executablePath).getRPath(), "$ORIGIN/../lib");
+
+        // setting the rpath changed the file, which must not be mistaken for a change made by a plugin
+        ::testing::internal::CaptureStdout();
+        const auto exitCode = sendRequest(server.socketPath(), request);
+        const auto output = ::testing::internal::GetCapturedStdout();
+
+        EXPECT_EQ(exitCode, 0);
+        EXPECT_EQ(output.find("Setting rpath"), std::string::npos) << output;
+    }
+
+    TEST_F(ServerTest, checkFailedExistingFilesAreProcessedAgain) {
+        // the library can't be found with this rpath
+        const auto executablePath = addExistingExecutable();
+        ASSERT_TRUE(elf_file::ElfFile(executablePath).setRPath("/nonexistent"));
+
+        Server server(appDir);
+
+        Request request;
+        request.appDirPath = tmpAppDir;
+
+        EXPECT_EQ(sendRequest(server.socketPath(), request), 1);
+        EXPECT_EQ(sendRequest(server.socketPath(), request), 1);
+    }
+
+    TEST_F(ServerTest, checkExistingFilesWithoutRPathAreProcessedAgain) {
+        const auto executablePath = addExistingExecutable();
+
+        // patchelf finds the library in the build directory, but fails to set the rpath
+        const auto patchelfPath = tmpAppDir / "patchelf";
+
+        std::ofstream ofs(patchelfPath);
+        ofs << "#!/bin/sh" << std::endl
+            << "[ \"$1\" = --print-rpath ] || exit 1" << std::endl
+            << "echo \"" << fs::path(SIMPLE_LIBRARY_PATH).parent_path().string() << "\"" << std::endl;
+        ofs.close();
+
+        fs::permissions(patchelfPath, fs::perms::owner_all);
+
+        setenv("LINUXDEPLOY_USE_PATCHELF", "1", true);
+        setenv("PATCHELF", patchelfPath.c_str(), true);
+
+        Request request;
+        request.appDirPath = tmpAppDir;
+
+        {
+            Server server(appDir);
+
+            // failing to set the rpath is not fatal
+            ASSERT_EQ(sendRequest(server.socketPath(), request), 0);
+
+            ::testing::internal::CaptureStdout();
+            const auto exitCode = sendRequest(server.socketPath(), request);
+            const auto output = ::testing::internal::GetCapturedStdout();
+
+            EXPECT_EQ(exitCode, 0);
+            EXPECT_NE(output.find("Setting rpath"), std::string::npos) << output;
+        }
+
+        unsetenv("LINUXDEPLOY_USE_PATCHELF");
+        unsetenv("PATCHELF");
+
+        // the state is kept in the AppDir, so the next server tries again, too
+        Server server(appDir);
+        EXPECT_EQ(sendRequest(server.socketPath(), request), 0);
+        EXPECT_EQ(elf_file::ElfFile(executablePath).getRPath(), "$ORIGIN/../lib");
+    }
+}
@@ -0,0 +1,53 @@
+/*
+ * Minimal shared library plugin, which deploys the test library using the default and a relative destination.
+ * Variants which violate the plugin API are built from the same source by defining the macros below.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include "linuxdeploy/plugin/shared_library_api.h"
+
+#ifndef TEST_PLUGIN_API_LEVEL
+#define TEST_PLUGIN_API_LEVEL LINUXDEPLOY_SHARED_LIBRARY_PLUGIN_API_LEVEL
+#endif
+
+#ifndef TEST_PLUGIN_TYPE
+#define TEST_PLUGIN_TYPE "input"
+#endif
+
+int linuxdeploy_plugin_api_level(void) {
+    return TEST_PLUGIN_API_LEVEL;
+}
+
+const char* linuxdeploy_plugin_type(void) {
+    return TEST_PLUGIN_TYPE;
+}
+
+#ifndef TEST_PLUGIN_WITHOUT_RUN
+/* operations are queued, so the files must not have been deployed when the operations return */
+static int isDeployed(const linuxdeploy_plugin_host* host, const char* relativePath) {
+    char path[4096];
+
+    if (snprintf(path, sizeof(path), "%s/%s", host->appdir_path, relativePath) >= (int) sizeof(path))
+        return 0;
+
+    return access(path, F_OK) == 0;
+}
+
+int linuxdeploy_plugin_run(const linuxdeploy_plugin_host* host) {
+    if (host == NULL || host->size < sizeof(*host) || host->appdir_path == NULL || host->appdir_path[0] != '/')
+        return 2;
+
+    if (!host->deploy_library(host->appdir, SIMPLE_LIBRARY_PATH, NULL))
+        return 3;
+
+    if (!host->deploy_library(host->appdir, SIMPLE_LIBRARY_STRIPPED_PATH, "usr/lib/relative/"))
+        return 4;
+
+    if (isDeployed(host, "usr/lib/libsimple_library.so") || isDeployed(host, "usr/lib/relative/libsimple_library.so.stripped"))
+        return 5;
+
+    return 0;
+}
+#endif
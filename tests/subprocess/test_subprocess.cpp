@@ -0,0 +1,160 @@
+// system headers
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/subprocess/subprocess.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace fs = std::filesystem;
+
+namespace LinuxDeployTest {
+    namespace {
+        // output is read in chunks of this size
+        constexpr size_t chunkSize = 64 * 1024;
+
+        subprocess makeShellSubprocess(const std::string& script) {
+            return subprocess({"sh", "-c", script});
+        }
+
+        // shell command which writes the given number of "a"s without a newline
+        std::string writeCharacters(size_t count) {
+            return "head -c " + std::to_string(count) + " /dev/zero | tr '\\0' a";
+        }
+    }
+
+    TEST(SubprocessTest, checkRunPassesChunks) {
+        const size_t size = 3 * chunkSize + 17;
+
+        std::string stdoutData, stderrData;
+        size_t stdoutChunks = 0;
+
+        const auto exitCode = makeShellSubprocess(writeCharacters(size) + "; echo error >&2; exit 3").run(
+            [&](std::string_view data) {
+                EXPECT_FALSE(data.empty());
+                EXPECT_LE(data.size(), chunkSize);
+
+                stdoutData.append(data);
+                ++stdoutChunks;
+            },
+            [&](std::string_view data) { stderrData.append(data); }
+        );
+
+        EXPECT_EQ(exitCode, 3);
+        EXPECT_EQ(stdoutData, std::string(size, 'a'));
+        EXPECT_GT(stdoutChunks, 1);
+        EXPECT_EQ(stderrData, "error\n");
+    }
+
+    TEST(SubprocessTest, checkRunWithoutCallbacks) {
+        // the output is discarded, but must still be read, otherwise the child would block
+        const auto exitCode = makeShellSubprocess(writeCharacters(4 * chunkSize) + "; exit 2").run({}, {});
+        EXPECT_EQ(exitCode, 2);
+    }
+
+    TEST(SubprocessTest, checkRunLines) {
+        std::vector<std::string> stdoutLines, stderrLines;
+
+        const auto exitCode = makeShellSubprocess("printf 'first\\n\\nthird\\n'; printf 'error\\n' >&2").run_lines(
+            [&stdoutLines](std::string_view line) { stdoutLines.emplace_back(line); },
+            [&stderrLines](std::string_view line) { stderrLines.emplace_back(line); }
+        );
+
+        EXPECT_EQ(exitCode, 0);
+        EXPECT_EQ(stdoutLines, (std::vector<std::string>{"first", "", "third"}));
+        EXPECT_EQ(stderrLines, (std::vector<std::string>{"error"}));
+    }
+
+    TEST(SubprocessTest, checkRunLinesSpanningChunks) {
+        // the first line is longer than a chunk, so it spans at least two of them, and the last line is not terminated
+        const size_t longLineSize = chunkSize + chunkSize / 2;
+
+        std::vector<std::string> lines;
+
+        const auto exitCode = makeShellSubprocess(writeCharacters(longLineSize) + "; printf '\\nsecond\\nlast'").run_lines(
+            [&lines](std::string_view line) { lines.emplace_back(line); },
+            {}
+        );
+
+        EXPECT_EQ(exitCode, 0);
+        ASSERT_EQ(lines.size(), 3);
+        EXPECT_EQ(lines[0], std::string(longLineSize, 'a'));
+        EXPECT_EQ(lines[1], "second");
+        EXPECT_EQ(lines[2], "last");
+    }
+
+    TEST(SubprocessTest, checkRunLinesWithoutNewline) {
+        std::vector<std::string> lines;
+
+        // a single line without a newline, which is longer than a chunk
+        const auto exitCode = makeShellSubprocess(writeCharacters(2 * chunkSize + 1)).run_lines(
+            [&lines](std::string_view line) { lines.emplace_back(line); },
+            {}
+        );
+
+        EXPECT_EQ(exitCode, 0);
+        ASSERT_EQ(lines.size(), 1);
+        EXPECT_EQ(lines[0], std::string(2 * chunkSize + 1, 'a'));
+    }
+
+    class SubprocessCallbackErrorTest : public ::testing::Test {
+        public:
+            // created by the child once it has written all of its output
+            const fs::path markerPath = "/tmp/linuxdeploy-test-subprocess-" + std::to_string(getpid());
+
+            // writes more than fits into the pipe, so the child blocks unless the pipe is drained
+            const std::string script = "printf 'first\\nsecond\\n'; " + writeCharacters(16 * chunkSize) +
+                "; touch \"" + markerPath.string() + "\"; exit 1";
+
+        public:
+            void TearDown() override {
+                fs::remove(markerPath);
+            }
+    };
+
+    TEST_F(SubprocessCallbackErrorTest, checkRunRethrowsAfterExit) {
+        size_t calls = 0;
+
+        auto run = [&]() {
+            makeShellSubprocess(script).run(
+                [&calls](std::string_view) {
+                    ++calls;
+                    throw std::runtime_error("callback failed");
+                },
+                {}
+            );
+        };
+
+        EXPECT_THROW(run(), std::runtime_error);
+
+        // no more data is passed once the callback has failed, but the output is read until the child has exited
+        EXPECT_EQ(calls, 1);
+        EXPECT_TRUE(fs::exists(markerPath));
+    }
+
+    TEST_F(SubprocessCallbackErrorTest, checkRunLinesRethrowsAfterExit) {
+        std::vector<std::string> lines;
+
+        auto run = [&]() {
+            makeShellSubprocess(script).run_lines(
+                [&lines](std::string_view line) {
+                    lines.emplace_back(line);
+                    throw std::runtime_error("callback failed");
+                },
+                {}
+            );
+        };
+
+        EXPECT_THROW(run(), std::runtime_error);
+
+        EXPECT_EQ(lines, std::vector<std::string>{"first"});
+        EXPECT_TRUE(fs::exists(markerPath));
+    }
+}
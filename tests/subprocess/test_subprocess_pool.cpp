@@ -0,0 +1,119 @@
+// system headers
+#include <chrono>
+#include <future>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// library headers
+#include "gtest/gtest.h"
+
+// local headers
+#include "linuxdeploy/subprocess/subprocess_pool.h"
+
+using namespace linuxdeploy::subprocess;
+
+namespace LinuxDeployTest {
+    namespace {
+        subprocess makeShellSubprocess(const std::string& script) {
+            return subprocess({"sh", "-c", script});
+        }
+
+        bool isReady(const std::future<subprocess_result>& future) {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+    }
+
+    TEST(SubprocessPoolTest, checkMoreJobsThanMaxRunning) {
+        const size_t maxRunning = 2;
+        const int jobsCount = 10;
+
+        subprocess_pool pool(maxRunning);
+
+        // every job counts the jobs which are running at the same time, using a file which only exists while it runs
+        const auto runningDir = "/tmp/linuxdeploy-test-subprocess-pool-" + std::to_string(getpid());
+        ASSERT_EQ(makeShellSubprocess("mkdir \"" + runningDir + "\"").run().exit_code(), 0);
+
+        std::vector<std::future<subprocess_result>> futures;
+
+        for (int i = 0; i < jobsCount; ++i) {
+            const auto file = runningDir + "/" + std::to_string(i);
+
+            futures.emplace_back(pool.submit(makeShellSubprocess(
+                "touch \"" + file + "\"; sleep 0.05; "
+                "ls \"" + runningDir + "\" | wc -l; rm \"" + file + "\"; "
+                "echo stderr " + std::to_string(i) + " >&2; exit " + std::to_string(i)
+            )));
+        }
+
+        for (int i = 0; i < jobsCount; ++i) {
+            const auto result = futures[i].get();
+
+            // every future has the result of its own job
+            EXPECT_EQ(result.exit_code(), i);
+            EXPECT_EQ(result.stderr_string(), "stderr " + std::to_string(i) + "\n");
+
+            const auto runningCount = std::stoul(result.stdout_string());
+            EXPECT_GE(runningCount, 1);
+            EXPECT_LE(runningCount, maxRunning);
+        }
+
+        makeShellSubprocess("rm -r \"" + runningDir + "\"").run();
+    }
+
+    TEST(SubprocessPoolTest, checkLargeOutput) {
+        subprocess_pool pool(2);
+
+        // more than the pool reads at once, on both streams
+        auto future = pool.submit(makeShellSubprocess("head -c 200000 /dev/zero; head -c 100000 /dev/zero >&2"));
+
+        const auto result = future.get();
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_view(), std::string(200000, '\0'));
+        EXPECT_EQ(result.stderr_view(), std::string(100000, '\0'));
+    }
+
+    TEST(SubprocessPoolTest, checkSpawnFailureIsStoredInFuture) {
+        subprocess_pool pool(1);
+
+        auto failingFuture = pool.submit(subprocess({"/nonexistent/program"}));
+        auto future = pool.submit(makeShellSubprocess("echo test"));
+
+        EXPECT_THROW(failingFuture.get(), std::runtime_error);
+
+        // the failed job doesn't block the pool
+        const auto result = future.get();
+        EXPECT_EQ(result.exit_code(), 0);
+        EXPECT_EQ(result.stdout_string(), "test\n");
+    }
+
+    TEST(SubprocessPoolTest, checkDestructionWaitsForQueuedJobs) {
+        const int jobsCount = 5;
+
+        std::vector<std::future<subprocess_result>> futures;
+
+        {
+            subprocess_pool pool(1);
+
+            for (int i = 0; i < jobsCount; ++i) {
+                futures.emplace_back(pool.submit(makeShellSubprocess("sleep 0.02; echo " + std::to_string(i))));
+            }
+
+            // most of the jobs are still queued when the pool is destroyed
+            EXPECT_FALSE(isReady(futures.back()));
+        }
+
+        for (int i = 0; i < jobsCount; ++i) {
+            ASSERT_TRUE(isReady(futures[i]));
+
+            const auto result = futures[i].get();
+            EXPECT_EQ(result.exit_code(), 0);
+            EXPECT_EQ(result.stdout_string(), std::to_string(i) + "\n");
+        }
+    }
+
+    TEST(SubprocessPoolTest, checkDestructionWithoutJobs) {
+        // the event loop must not wait for jobs which are never submitted
+        subprocess_pool pool;
+    }
+}